@@ -1,7 +1,11 @@
 // Copyright (c) 2026 - Tom Smeets <tom@tsmeets.nl>
-// hot.h - Generic application hot reloader
-#include "hot.h"
+// hot.c - Generic application hot reloader
 #include "fmt.h"
+#include "fs_watch.h"
+#include "hot.h"
+#include "os_main.h"
+#include "proc.h"
+#include "time.h"
 #include "type.h"
 
 // Permanent memory
@@ -17,40 +21,54 @@ static char *build_command;
 static char *output_path;
 static char *entry_name;
 
+// Arguments passed to the application
+static u32 child_argc;
+static char **child_argv;
+
 static void (*entry_method)(u32, char **);
 
+static void hot_usage(void) {
+    char *name = os_argv[0];
+    print("Usage: ", name, " <COMMAND> <OUTPUT> <ENTRY> [WATCH...] -- [ARG...]");
+    print("");
+    print("  <COMMAND>  - The (build) command to execute on a file change.");
+    print("               The changed files are passed in $HOT_CHANGED, separated by spaces.");
+    print("  <OUTPUT>   - The output library created by the build command.");
+    print("  <ENTRY>    - Entry point symbol name, this function is just called in an infinite loop.");
+    print("  [WATCH...] - Directories to watch recursively for changed '*.c' and '*.h' files.");
+    print("  [ARG...]   - Arguments to be passed to the application.");
+    print("");
+    print("Example:");
+    print("  ", name, " 'clang -o out/main.so -shared src/main.c' out/main.so main_update src app");
+    print("  ", name, " make build/application.so main_update src -- test");
+}
+
 static void os_main(void) {
     bool init = !hot;
     if (init) {
         // Check arguments
-        if (argc < 4) {
-            fmt_s(ferr, "Usage: ");
-            fmt_s(ferr, argv[0]);
-            fmt_s(ferr, " <COMMAND> <OUTPUT> <ENTRY> [WATCH...] -- [ARG...]\n");
-            fmt_s(ferr, "\n");
-            fmt_s(ferr, "  <COMMAND>  - The (build) command to execute on a file change.\n");
-            fmt_s(ferr, "  <OUTPUT>   - The output executable created by the build command.\n");
-            fmt_s(ferr, "  <ENTRY>    - Entry point symbol name, this function is just called in an infinite loop.\n");
-            fmt_s(ferr, "  [WATCH...] - A list of files to watch for changes.\n");
-            fmt_s(ferr, "  [ARG...]   - Arguments to be passed to the application.\n");
-            fmt_s(ferr, "\n");
-            fmt_s(ferr, "Example:\n");
-            fmt_ss(ferr, "  ", argv[0], " 'clang -o out/main.so -shared src/main.c' out/main.so src app\n");
-            fmt_ss(ferr, "  ", argv[0], " make build/application.so src -- test\n");
-            os_exit(1);
+        if (os_argc < 4) {
+            hot_usage();
+            os_exit();
         }
 
-        build_command = argv[1];
-        output_path = argv[2];
-        entry_name = argv[3];
-
-        u32 watch_count = 0;
-        char **watch_paths = &argv[4];
+        build_command = os_argv[1];
+        output_path = os_argv[2];
+        entry_name = os_argv[3];
 
         // Find '--' separating our from the child arguments
-        for (u32 i = 4; i < argc; ++i) {
-            if (str_eq(argv[i], "--")) break;
-            watch_count++;
+        u32 watch_count = 0;
+        char **watch_paths = os_argv + 4;
+        while (4 + watch_count < os_argc && !str_eq(watch_paths[watch_count], "--")) watch_count++;
+
+        // The application gets its own name followed by the arguments after '--'
+        child_argv = watch_paths + watch_count;
+        child_argc = os_argc - 4 - watch_count;
+        if (child_argc == 0) {
+            child_argv = os_argv;
+            child_argc = 1;
+        } else {
+            child_argv[0] = os_argv[0];
         }
 
         // Create a memory arena for all future allocations
@@ -59,17 +77,30 @@ static void os_main(void) {
         // Create a Hot-Reload helper (see hot.h)
         hot = hot_new(mem);
 
-        // Create a file watcher that watches 'src' and 'app' for file changes
-        // os_watch_check will return true each time one or more files are changed
-        watch = os_watch_new();
+        // Watch the source directories recursively, see fs_watch.h
+        watch = fs_watch_new(mem);
+        if (!watch) {
+            print("Failed to create a file watcher");
+            os_exit();
+        }
         for (u32 i = 0; i < watch_count; ++i) {
-            fmt_ss(ferr, "Watching: ", watch_paths[i], "\n");
-            os_watch_add(watch, watch_paths[i]);
+            print("Watching: ", watch_paths[i]);
+            fs_watch_add(watch, watch_paths[i]);
         }
     }
 
-    // Reload application when a file was changed
-    if (os_watch_check(watch) || init) {
+    // Reload application when a source file was changed
+    // Changes are debounced, so a burst of writes results in a single rebuild
+    if (fs_watch_check(watch) || init) {
+        Memory *tmp = mem_new();
+        Fmt *changed = fmt_new(tmp);
+        for (u32 i = 0; i < watch->change_count; ++i) {
+            print("Changed: ", watch->changes[i]);
+            fmt_g(changed, i ? " " : "", watch->changes[i]);
+        }
+        proc_env_set("HOT_CHANGED", (char *)fmt_end(changed).data);
+        mem_free(tmp);
+
         // Forget old entry point
         entry_method = 0;
 
@@ -77,17 +108,15 @@ static void os_main(void) {
         proc_shell(build_command);
 
         // Load the new application
-        if (!error) {
-            entry_method = hot_load(hot, output_path, entry_name);
-        }
+        if (!error) entry_method = hot_load(hot, output_path, entry_name);
         error = 0;
     }
 
     if (entry_method) {
         // Run application update method
-        entry_method(argc - 1, argv + 1);
+        entry_method(child_argc, child_argv);
     } else {
         // If no application was loaded, poll slowly
-        os_sleep(100 * 1000);
+        os_sleep(100 * TIME_MS);
     }
 }
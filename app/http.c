@@ -1,7 +1,13 @@
+#include "cli.h"
 #include "fmt.h"
+#include "fs.h"
+#include "gzip.h"
 #include "io.h"
+#include "list.h"
 #include "os_headers.h"
 #include "os_main.h"
+#include "read.h"
+#include "thread.h"
 
 #if OS_LINUX
 
@@ -13,6 +19,7 @@ typedef enum {
 typedef enum {
     SOCK_STREAM = 1,
     SOCK_DGRAM = 2,
+    SOCK_NONBLOCK = O_NONBLOCK,
 } sock_type;
 
 static i64 linux_socket(sock_family family, sock_type type, int protocol) {
@@ -41,11 +48,40 @@ static i64 linux_accept(int fd, sockaddr_in *addr, int flags) {
 
 #define SOL_SOCKET 1
 #define SO_REUSEADDR 2
+#define SO_REUSEPORT 15
 
 static i64 linux_setsockopt(int fd, int level, int optname, char *optval, int optlen) {
     return linux_syscall5(0x36, fd, level, optname, (intptr_t)optval, optlen);
 }
 
+// ==== Epoll ====
+#define EPOLLIN 0x001
+#define EPOLLOUT 0x004
+#define EPOLL_CTL_ADD 1
+#define EPOLL_CTL_MOD 3
+
+struct linux_epoll_event {
+    u32 events;
+    u64 data;
+} __attribute__((packed));
+
+static i64 linux_epoll_create1(int flags) {
+    return linux_syscall1(0x123, flags);
+}
+
+static i64 linux_epoll_ctl(int epfd, int op, int fd, struct linux_epoll_event *event) {
+    return linux_syscall4(0xe9, epfd, op, fd, (intptr_t)event);
+}
+
+static i64 linux_epoll_wait(int epfd, struct linux_epoll_event *events, int max_events, int timeout) {
+    return linux_syscall4(0xe8, epfd, (intptr_t)events, max_events, timeout);
+}
+
+// ==== Zero copy file transfer ====
+static i64 linux_sendfile(int out_fd, int in_fd, i64 *offset, u64 count) {
+    return linux_syscall4(0x28, out_fd, in_fd, (intptr_t)offset, count);
+}
+
 static u32 net_ip4(u8 a, u8 b, u8 c, u8 d) {
     u32 res = 0;
     res |= (u32)a << 0;
@@ -61,13 +97,20 @@ static u16 net_port(u16 port) {
 
 #endif
 
+#define HTTP_PORT 4444
+
 static u16 u16_swap(u16 x) {
     return (x >> 8) | (x << 8);
 }
 
-static void os_main(void) {
-    int fd = linux_socket(AF_INET, SOCK_STREAM, 0);
-    check(fd >= 0);
+// Create a socket listening on localhost
+// - With 'reuse_port' multiple sockets can bind the same port, the kernel balances connections between them
+static i32 http_listen(u16 port, bool reuse_port) {
+    sock_type type = SOCK_STREAM;
+    if (reuse_port) type |= SOCK_NONBLOCK;
+
+    i32 fd = linux_socket(AF_INET, type, 0);
+    check_or(fd >= 0) return -1;
 
     // Initialize the details of the server socket
     sockaddr_in addr = {};
@@ -76,12 +119,415 @@ static void os_main(void) {
     addr.sin_addr[1] = 0;
     addr.sin_addr[2] = 0;
     addr.sin_addr[3] = 1;
-    addr.sin_port = u16_swap(4444);
+    addr.sin_port = u16_swap(port);
 
     int one = 1;
-    debug(linux_setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (void *)&one, sizeof(one)));
-    debug(linux_bind(fd, &addr));
-    debug(linux_listen(fd, 1));
+    check(linux_setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (void *)&one, sizeof(one)) == 0);
+    if (reuse_port) check(linux_setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, (void *)&one, sizeof(one)) == 0);
+    check(linux_bind(fd, &addr) == 0);
+    check(linux_listen(fd, 128) == 0);
+    return fd;
+}
+
+// Files larger than this are always sent uncompressed
+#define HTTP_GZIP_MAX_SIZE (4 * SIZE_MB)
+
+// A file that was compressed ahead of time
+typedef struct Http_File Http_File;
+struct Http_File {
+    char *path;
+    time_t mtime;
+    size_t size;
+    Buffer gzip;
+    Http_File *next;
+};
+
+// Shared server state, read only after startup
+typedef struct {
+    Memory *mem;
+
+    // Directory containing the files to serve
+    char *root;
+
+    // Precompressed files
+    Http_File *files;
+} Http_Server;
+
+// Parsed request line and the headers we care about
+typedef struct {
+    Buffer method;
+    Buffer path;
+    Buffer if_none_match;
+    bool accept_gzip;
+} Http_Request;
+
+// Check if 'buf' contains 'needle'
+static bool http_contains(Buffer buf, char *needle) {
+    Buffer key = str_buf(needle);
+    for (size_t i = 0; i + key.size <= buf.size; ++i) {
+        if (buf_starts_with(buf_drop(buf, i), key)) return true;
+    }
+    return false;
+}
+
+// Match a header line case insensitive and return its value
+static bool http_header(Buffer line, char *name, Buffer *value) {
+    size_t len = str_len(name);
+    if (line.size < len + 1 || line.data[len] != ':') return false;
+    for (size_t i = 0; i < len; ++i) {
+        u8 chr = line.data[i];
+        if (chr_is_upper(chr)) chr += 'a' - 'A';
+        if (chr != name[i]) return false;
+    }
+    *value = buf_trim(buf_drop(line, len + 1));
+    return true;
+}
+
+static Http_Request http_parse_request(Buffer data) {
+    Http_Request req = {};
+    Read read = read_from(data);
+
+    // GET /path HTTP/1.1
+    Buffer line = buf_trim(read_line(&read));
+    size_t split = 0;
+    while (split < line.size && line.data[split] != ' ') split++;
+    req.method = buf_take(line, split);
+    line = buf_drop(line, split + 1);
+
+    split = 0;
+    while (split < line.size && line.data[split] != ' ' && line.data[split] != '?') split++;
+    req.path = buf_take(line, split);
+
+    while (!read_eof(&read)) {
+        line = buf_trim(read_line(&read));
+        if (line.size == 0) break;
+
+        Buffer value;
+        if (http_header(line, "if-none-match", &value)) req.if_none_match = value;
+        if (http_header(line, "accept-encoding", &value)) req.accept_gzip = http_contains(value, "gzip");
+    }
+    return req;
+}
+
+static char *http_content_type(char *path) {
+    Buffer ext = path_split(str_buf(path)).ext;
+    if (buf_eq(ext, str_buf("html"))) return "text/html; charset=UTF-8";
+    if (buf_eq(ext, str_buf("js"))) return "text/javascript; charset=UTF-8";
+    if (buf_eq(ext, str_buf("css"))) return "text/css; charset=UTF-8";
+    if (buf_eq(ext, str_buf("wasm"))) return "application/wasm";
+    if (buf_eq(ext, str_buf("json"))) return "application/json";
+    if (buf_eq(ext, str_buf("txt"))) return "text/plain; charset=UTF-8";
+    if (buf_eq(ext, str_buf("svg"))) return "image/svg+xml";
+    if (buf_eq(ext, str_buf("png"))) return "image/png";
+    return "application/octet-stream";
+}
+
+// Only text based formats benefit from compression
+static bool http_compressible(char *path) {
+    char *type = http_content_type(path);
+    return str_eq(type, "application/wasm") || str_eq(type, "application/json") || str_eq(type, "image/svg+xml") ||
+           buf_starts_with(str_buf(type), str_buf("text/"));
+}
+
+// Find a precompressed file that is still up to date
+static Http_File *http_find_file(Http_Server *server, char *path, FileInfo *info) {
+    for (Http_File *file = server->files; file; file = file->next) {
+        if (!str_eq(file->path, path)) continue;
+        if (file->mtime != info->mtime || file->size != info->size) return 0;
+        return file;
+    }
+    return 0;
+}
+
+// Recursively compress all files in a directory
+typedef struct {
+    Http_Server *server;
+    char *dir;
+} Http_Scan;
+
+static void http_scan_cb(void *user, char *name, FileType type) {
+    Http_Scan *scan = user;
+    Http_Server *server = scan->server;
+    char *path = fstr(server->mem, scan->dir, "/", name);
+
+    // A file that can't be read is skipped, the error would stop 'fs_list'
+    if (type == FileType_Directory) {
+        Http_Scan child = {server, path};
+        fs_list(path, http_scan_cb, &child);
+        if (error) print("Warning: ", error_pop());
+        return;
+    }
+
+    if (type != FileType_File || !http_compressible(path)) return;
+    FileInfo info = fs_stat(path);
+    if (error) {
+        print("Warning: ", error_pop());
+        return;
+    }
+    if (info.size > HTTP_GZIP_MAX_SIZE) return;
+
+    Memory *tmp = mem_new();
+    Buffer data = fs_read(tmp, path);
+    Buffer gzip = gzip_write(tmp, data);
+    if (error) {
+        print("Warning: ", error_pop());
+    } else if (gzip.size < data.size) {
+        Http_File *file = mem_struct(server->mem, Http_File);
+        file->path = path;
+        file->mtime = info.mtime;
+        file->size = info.size;
+        file->gzip = buf_from(mem_clone(server->mem, gzip.data, gzip.size), gzip.size);
+        LIST_PUSH(server->files, file);
+        print("Compressed: ", path, " ", (u64)data.size, " -> ", (u64)gzip.size);
+    }
+    mem_free(tmp);
+}
+
+static Http_Server *http_server_new(Memory *mem, char *root) {
+    Http_Server *server = mem_struct(mem, Http_Server);
+    server->mem = mem;
+    server->root = root;
+
+    Http_Scan scan = {server, root};
+    fs_list(root, http_scan_cb, &scan);
+
+    // A missing or unreadable file should not prevent serving
+    if (error) print("Warning: ", error_pop());
+    return server;
+}
+
+// A client connection and the response that is being sent to it
+// - The response is built at once, then sent in as many steps as the socket needs
+typedef struct Http_Conn Http_Conn;
+struct Http_Conn {
+    i32 fd;
+
+    // Response headers, or a complete status response
+    u32 head_size;
+    u32 head_sent;
+    char head[1024];
+
+    // Precompressed body, or a file sent with sendfile
+    Buffer body;
+    File *file;
+    i64 file_offset;
+    u64 file_size;
+
+    // Free list
+    Http_Conn *next;
+};
+
+static void http_conn_head(Http_Conn *conn, char *head) {
+    size_t size = str_len(head);
+    check_or(size <= sizeof(conn->head)) size = 0;
+    ptr_copy(conn->head, head, size);
+    conn->head_size = size;
+    conn->head_sent = 0;
+}
+
+static void http_send_status(Http_Conn *conn, char *status) {
+    http_conn_head(conn, fstr(mem_tmp(), "HTTP/1.1 ", status, "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n"));
+}
+
+// Prepare the response for a single file
+// - The ETag is derived from the modification time and size
+// - Precompressed data is used when the client accepts gzip
+// - Otherwise the file is sent with sendfile, without copying it to userspace
+static void http_send_file(Http_Server *server, Http_Conn *conn, Http_Request *req) {
+    // Don't allow escaping the root directory
+    if (req->path.size == 0 || req->path.data[0] != '/' || http_contains(req->path, "..")) {
+        http_send_status(conn, "400 Bad Request");
+        return;
+    }
+
+    Memory *tmp = mem_tmp();
+    char *path = fstr(tmp, server->root, req->path);
+    if (req->path.data[req->path.size - 1] == '/') path = fstr(tmp, path, "index.html");
+
+    FileInfo info = fs_stat(path);
+    if (error || info.type != FileType_File) {
+        error_clear();
+        http_send_status(conn, "404 Not Found");
+        return;
+    }
+
+    Http_File *gzip = req->accept_gzip ? http_find_file(server, path, &info) : 0;
+    char *etag = fstr(tmp, "\"", F_Hex, (u64)info.mtime, "-", (u64)info.size, gzip ? "-gz" : "", "\"");
+    if (req->if_none_match.size && http_contains(req->if_none_match, etag)) {
+        http_send_status(conn, "304 Not Modified");
+        return;
+    }
+
+    // Open the file before the headers, so a failure can still be reported
+    File *file = 0;
+    if (!gzip) {
+        file = fs_open(path, FileMode_Read);
+        if (error) {
+            error_clear();
+            http_send_status(conn, "500 Internal Server Error");
+            return;
+        }
+    }
+
+    u64 size = gzip ? gzip->gzip.size : info.size;
+    char *type = http_content_type(path);
+    char *header = fstr(tmp, "HTTP/1.1 200 OK\r\nContent-Type: ", type, "\r\nContent-Length: ", size, "\r\n");
+    header = fstr(tmp, header, "ETag: ", etag, "\r\nVary: Accept-Encoding\r\n");
+    if (gzip) header = fstr(tmp, header, "Content-Encoding: gzip\r\n");
+    header = fstr(tmp, header, "Connection: close\r\n\r\n");
+    http_conn_head(conn, header);
+    if (buf_eq(req->method, str_buf("HEAD"))) {
+        if (file) io_close(file);
+        return;
+    }
+
+    if (gzip) {
+        conn->body = gzip->gzip;
+        return;
+    }
+
+    conn->file = file;
+    conn->file_offset = 0;
+    conn->file_size = size;
+}
+
+// Read the request and prepare the response
+// - Returns false when the request did not arrive yet
+static bool http_respond(Http_Server *server, Http_Conn *conn) {
+    char buffer[1024 * 4];
+    i64 n = sys_read(conn->fd, buffer, sizeof(buffer));
+    if (n == -EAGAIN) return false;
+    if (n > 0) {
+        Http_Request req = http_parse_request(buf_from(buffer, n));
+        if (buf_eq(req.method, str_buf("GET")) || buf_eq(req.method, str_buf("HEAD"))) {
+            http_send_file(server, conn, &req);
+        } else {
+            http_send_status(conn, "405 Method Not Allowed");
+        }
+    }
+    return true;
+}
+
+// Send as much of the response as the socket accepts
+// - Returns false when the socket is full and the rest has to be sent later
+// - Returns true when the response is sent, or the client is gone
+static bool http_flush(Http_Conn *conn) {
+    while (conn->head_sent < conn->head_size) {
+        i64 ret = sys_write(conn->fd, conn->head + conn->head_sent, conn->head_size - conn->head_sent);
+        if (ret == -EAGAIN) return false;
+        if (ret <= 0) return true;
+        conn->head_sent += ret;
+    }
+
+    while (conn->body.size) {
+        i64 ret = sys_write(conn->fd, (char *)conn->body.data, conn->body.size);
+        if (ret == -EAGAIN) return false;
+        if (ret <= 0) return true;
+        conn->body = buf_drop(conn->body, ret);
+    }
+
+    while (conn->file && (u64)conn->file_offset < conn->file_size) {
+        i64 ret = linux_sendfile(conn->fd, fd_from_handle(conn->file), &conn->file_offset, conn->file_size - conn->file_offset);
+        if (ret == -EAGAIN) return false;
+        if (ret <= 0) return true;
+    }
+    return true;
+}
+
+static void http_close(Http_Conn *conn) {
+    if (conn->file) io_close(conn->file);
+    sys_close(conn->fd);
+}
+
+// Worker thread state
+typedef struct {
+    u32 cpu;
+    bool pin;
+    Http_Server *server;
+} Http_Worker;
+
+// Worker thread, with its own listening socket and event loop
+// - Temporary memory and chunk caches are thread local, so workers share nothing
+// - Client sockets are non-blocking, a slow client only waits for its own EPOLLOUT
+static void http_worker(void *user) {
+    Http_Worker *worker = user;
+    if (worker->pin) os_thread_pin(worker->cpu);
+
+    i32 fd = http_listen(HTTP_PORT, true);
+    i32 epoll = linux_epoll_create1(O_CLOEXEC);
+    check(epoll >= 0);
+
+    // The listening socket has no connection, so its event data is 0
+    struct linux_epoll_event listen_event = {.events = EPOLLIN, .data = 0};
+    check(linux_epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &listen_event) == 0);
+    if (error) {
+        print("Worker ", worker->cpu, " failed: ", error);
+        return;
+    }
+
+    // Connections are reused, so this only grows to the peak number of open connections
+    Memory *mem = mem_new();
+    Http_Conn *free_list = 0;
+
+    for (;;) {
+        struct linux_epoll_event events[64];
+        i64 count = linux_epoll_wait(epoll, events, array_count(events), -1);
+        for (i64 i = 0; i < count; ++i) {
+            Http_Conn *conn = (Http_Conn *)events[i].data;
+
+            if (conn) {
+                // The request did not arrive yet
+                bool had_response = conn->head_size > 0;
+                if (!had_response && !http_respond(worker->server, conn)) continue;
+
+                // Continue when the socket has room again
+                if (!http_flush(conn)) {
+                    struct linux_epoll_event out_event = {.events = EPOLLOUT, .data = (u64)conn};
+                    if (had_response || linux_epoll_ctl(epoll, EPOLL_CTL_MOD, conn->fd, &out_event) == 0) continue;
+                }
+
+                // Closing the socket also removes it from the epoll set
+                http_close(conn);
+                LIST_PUSH(free_list, conn);
+                continue;
+            }
+
+            // Accept all pending connections
+            for (;;) {
+                sockaddr_in client_addr = {};
+                i32 client_fd = linux_accept(fd, &client_addr, O_CLOEXEC | SOCK_NONBLOCK);
+                if (client_fd < 0) break;
+
+                Http_Conn *client = free_list;
+                if (client) {
+                    free_list = client->next;
+                } else {
+                    client = mem_struct(mem, Http_Conn);
+                }
+                *client = (Http_Conn){.fd = client_fd};
+
+                struct linux_epoll_event client_event = {.events = EPOLLIN, .data = (u64)client};
+                if (linux_epoll_ctl(epoll, EPOLL_CTL_ADD, client_fd, &client_event) != 0) {
+                    sys_close(client_fd);
+                    LIST_PUSH(free_list, client);
+                }
+            }
+        }
+
+        // Reset per request memory and errors
+        mem_tmp_free();
+        if (error) print("Worker ", worker->cpu, ": ", error_pop());
+    }
+}
+
+static void http_cmd_serve(Cli *cli, Memory *mem) {
+    cli_command(cli, "serve", "Serve on a single thread");
+    char *root = cli_value(cli, "[DIR]", "Directory to serve (default: out)");
+    if (!cli_check(cli)) return;
+
+    Http_Server *server = http_server_new(mem, root ?: "out");
+    i32 fd = http_listen(HTTP_PORT, false);
+    if (error) return;
 
     for (;;) {
         sockaddr_in client_addr = {};
@@ -89,18 +535,48 @@ static void os_main(void) {
         print("Accept: ", client_fd);
         print("Port: ", u16_swap(client_addr.sin_port));
         print("Host: ", client_addr.sin_addr[0], ".", client_addr.sin_addr[1], ".", client_addr.sin_addr[2], ".", client_addr.sin_addr[3]);
-        char buffer[1024 * 4];
-        size_t n = sys_read(client_fd, buffer, sizeof(buffer));
-        debug(buf_from(buffer, n));
+        if (client_fd < 0) continue;
 
-        char *out = "HTTP/1.1 200 OK\r\n"
-                    "Content-Type: text/html; charset=UTF-8\r\n"
-                    "\r\n"
-                    "Hello World!\r\n";
-        debug(sys_write(client_fd, out, str_len(out)));
-        debug(sys_close(client_fd));
+        // The socket is blocking, so everything is sent at once
+        Http_Conn conn = {.fd = client_fd};
+        http_respond(server, &conn);
+        http_flush(&conn);
+        http_close(&conn);
+        mem_tmp_free();
     }
-
     sys_close(fd);
+}
+
+static void http_cmd_workers(Cli *cli, Memory *mem) {
+    cli_command(cli, "workers", "Serve using one thread per core");
+    bool no_pin = cli_flag(cli, "-n", "--no-pin", "Don't pin worker threads to a core");
+    char *root = cli_value(cli, "[DIR]", "Directory to serve (default: out)");
+    if (!cli_check(cli)) return;
+
+    // Compress everything up front, workers only read the shared state
+    Http_Server *server = http_server_new(mem, root ?: "out");
+
+    u32 count = os_cpu_count();
+    print("Starting ", count, " workers on port ", (u32)HTTP_PORT);
+
+    Thread **threads = mem_array(mem, Thread *, count);
+    for (u32 i = 0; i < count; ++i) {
+        Http_Worker *worker = mem_struct(mem, Http_Worker);
+        worker->cpu = i;
+        worker->pin = !no_pin;
+        worker->server = server;
+        threads[i] = os_thread_start(mem, http_worker, worker);
+    }
+
+    // Workers run forever
+    for (u32 i = 0; i < count; ++i) os_thread_join(threads[i]);
+}
+
+static void os_main(void) {
+    Memory *mem = mem_perm();
+    Cli *cli = cli_new(mem, os_argv);
+    http_cmd_serve(cli, mem);
+    http_cmd_workers(cli, mem);
+    cli_help(cli);
     os_exit();
 }
@@ -27,6 +27,9 @@ typedef struct {
     int (*snd_pcm_open)(snd_pcm_t **pcm, const char *name, snd_pcm_stream_t stream, int mode);
     int (*snd_pcm_drain)(snd_pcm_t *pcm);
     int (*snd_pcm_close)(snd_pcm_t *pcm);
+
+    // Recover from an underrun or suspend, 'err' is the negative error code from read or write
+    int (*snd_pcm_recover)(snd_pcm_t *pcm, int err, int silent);
     int (*snd_pcm_set_params)(
         snd_pcm_t *pcm, snd_pcm_format_t format, snd_pcm_access_t access, uint channels, uint rate, int soft_resample, uint latency
     );
@@ -36,6 +39,9 @@ typedef struct {
 
     // Returns a positive number of frames actually read otherwise a negative error code
     long (*snd_pcm_readi)(snd_pcm_t *pcm, void *buffer, ulong size);
+
+    // Frames written to the device that are not played yet, returns a negative error code on failure
+    int (*snd_pcm_delay)(snd_pcm_t *pcm, long *delay);
 } Alsa_API;
 
 static void alsa_load(Alsa_API *api) {
@@ -43,7 +49,9 @@ static void alsa_load(Alsa_API *api) {
     api->snd_pcm_open = dl_sym(handle, "snd_pcm_open");
     api->snd_pcm_drain = dl_sym(handle, "snd_pcm_drain");
     api->snd_pcm_close = dl_sym(handle, "snd_pcm_close");
+    api->snd_pcm_recover = dl_sym(handle, "snd_pcm_recover");
     api->snd_pcm_set_params = dl_sym(handle, "snd_pcm_set_params");
     api->snd_pcm_writei = dl_sym(handle, "snd_pcm_writei");
     api->snd_pcm_readi = dl_sym(handle, "snd_pcm_readi");
+    api->snd_pcm_delay = dl_sym(handle, "snd_pcm_delay");
 }
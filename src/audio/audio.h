@@ -1,12 +1,32 @@
 // Copyright (c) 2026 - Tom Smeets <tom@tsmeets.nl>
-// alsa.h - Simple audio audio api wrapper
+// audio.h - Simple audio api with a real-time output thread
 #pragma once
+#include "atomic.h"
+#include "fs.h"
+#include "math.h"
 #include "os_detection.h"
+#include "thread.h"
+#include "time.h"
+#include "write.h"
 
 #if OS_LINUX
 #include "alsa.h"
 #endif
 
+// Usage:
+//   Audio audio = audio_open();        // Or 'audio_open_wav("out.wav")' without hardware
+//   for (;;) audio_play(&audio, samples, count);
+//   audio_close(&audio);
+//
+// audio_play only queues the samples, a separate thread writes them to the
+// device. audio_play waits while more than 'latency' frames are queued, so
+// the caller renders just in time.
+//
+// Whatever is queued is written to the device, even less than a period. When
+// the queue runs dry while the device is almost out of samples too, or the
+// device itself runs out of samples, the latency is doubled. After a long time
+// without problems it is slowly decreased again.
+
 // Samples per second
 #define AUDIO_RATE 48000
 
@@ -16,7 +36,42 @@
 // Number of samples to buffer (suggestion)
 #define AUDIO_BUFFER_SIZE (AUDIO_RATE / 100)
 
+// Frames written to the device at once
+#define AUDIO_PERIOD 256
+
+// Maximum number of queued frames (left, right)
+#define AUDIO_QUEUE_SIZE (AUDIO_RATE / 2)
+
+// Bounds for the adaptive latency in frames
+#define AUDIO_LATENCY_MIN (2 * AUDIO_PERIOD)
+#define AUDIO_LATENCY_MAX (AUDIO_QUEUE_SIZE / 2)
+
 typedef struct {
+    // Lock-free queue of stereo frames
+    // - Cursors count frames since the start, the index is 'cursor % AUDIO_QUEUE_SIZE'
+    // - 'queue_read' is only written by the audio thread, 'queue_write' only by audio_play
+    u64 queue_read;
+    u64 queue_write;
+    i16 queue[AUDIO_QUEUE_SIZE * 2];
+
+    // Frames audio_play keeps queued, adjusted by the audio thread
+    u32 latency;
+
+    // The queue was empty when the device needed more samples
+    u32 underrun_count;
+
+    // The device ran out of samples and had to be recovered
+    u32 xrun_count;
+
+    // The audio thread stops after playing everything when this is cleared
+    bool running;
+    Thread *thread;
+
+    // Null device, everything is written to a WAV file on close
+    char *wav_path;
+    Memory *wav_mem;
+    Write *wav;
+
 #if OS_LINUX
     u32 latency_ms;
     u32 channels;
@@ -26,29 +81,170 @@ typedef struct {
 #endif
 } Audio;
 
+// Open the default output device
+// - Only ALSA on Linux is supported, other platforms can only use 'audio_open_wav'
 static Audio audio_open(void) {
     Audio audio = {};
-    audio.latency_ms = 50;
+    audio.latency = AUDIO_LATENCY_MIN;
+#if OS_LINUX
+    audio.latency_ms = 20;
     audio.channels = 2;
     alsa_load(&audio.api);
+#endif
     return audio;
 }
 
-static void audio_play(Audio *audio, i16 *samples, u32 count) {
-    if (!audio->pcm) {
-        check(audio->api.snd_pcm_open(&audio->pcm, "default", SND_PCM_STREAM_PLAYBACK, 0) == 0);
-        if (error) return;
-        check(
+// Open a null device that writes everything to a WAV file instead of the speakers
+static Audio audio_open_wav(char *path) {
+    Audio audio = {};
+    audio.latency = AUDIO_LATENCY_MIN;
+    audio.wav_path = path;
+    audio.wav_mem = mem_new();
+    audio.wav = write_new(audio.wav_mem);
+    return audio;
+}
+
+// Take up to 'count' frames from the queue
+static u32 audio_queue_pop(Audio *audio, i16 *samples, u32 count) {
+    u64 read = audio->queue_read;
+    u64 write = atomic_load(&audio->queue_write);
+    if (count > write - read) count = write - read;
+
+    u32 ix = read % AUDIO_QUEUE_SIZE;
+    for (u32 i = 0; i < count; ++i) {
+        samples[i * 2 + 0] = audio->queue[ix * 2 + 0];
+        samples[i * 2 + 1] = audio->queue[ix * 2 + 1];
+        if (++ix == AUDIO_QUEUE_SIZE) ix = 0;
+    }
+
+    // Give the space back to audio_play
+    atomic_store(&audio->queue_read, read + count);
+    return count;
+}
+
+// Something went wrong, buffer more to prevent it from happening again
+static void audio_latency_grow(Audio *audio) {
+    atomic_store(&audio->latency, u_min(audio->latency * 2, AUDIO_LATENCY_MAX));
+}
+
+// Write queued frames to the device until the audio is closed
+static void audio_thread(void *user) {
+    Audio *audio = user;
+    os_thread_realtime();
+
+    // Shrink the latency again after this many frames without problems
+    u32 stable_limit = 10 * AUDIO_RATE;
+    u32 stable_count = 0;
+
+    // Nothing was played yet, so an empty queue is not an underrun
+    bool started = false;
+
+    i16 period[AUDIO_PERIOD * 2];
+    for (;;) {
+        bool running = atomic_load(&audio->running);
+        u32 count = audio_queue_pop(audio, period, AUDIO_PERIOD);
+        if (!running && count == 0) break;
+        if (count > 0) started = true;
+
+        // The null device just collects everything as fast as possible
+        if (audio->wav) {
+            if (count == 0) os_sleep(TIME_MS);
+            write_buffer(audio->wav, (Buffer){(u8 *)period, count * sizeof(i16) * 2});
+            continue;
+        }
+
+        bool late = false;
+#if OS_LINUX
+        // A short queue is only a problem when the device is about to run out as well
+        long delay = 0;
+        bool starving = audio->api.snd_pcm_delay(audio->pcm, &delay) < 0 || delay < AUDIO_PERIOD;
+        if (count < AUDIO_PERIOD && starving && started && running) {
+            atomic_add(&audio->underrun_count, 1);
+            late = true;
+        }
+
+        if (count == 0) {
+            // Wait for audio_play while the device still has enough to play
+            if (!late) {
+                os_sleep(TIME_MS);
+                continue;
+            }
+
+            // Keep the device playing with silence
+            for (u32 i = 0; i < array_count(period); ++i) period[i] = 0;
+            count = AUDIO_PERIOD;
+        }
+
+        // Blocks until the device has room
+        long ret = audio->api.snd_pcm_writei(audio->pcm, period, count);
+        if (ret < 0) {
+            atomic_add(&audio->xrun_count, 1);
+            audio->api.snd_pcm_recover(audio->pcm, ret, 1);
+            late = true;
+        }
+#endif
+
+        if (late) {
+            audio_latency_grow(audio);
+            stable_count = 0;
+        } else if ((stable_count += count) >= stable_limit) {
+            atomic_store(&audio->latency, u_max(audio->latency - AUDIO_PERIOD, AUDIO_LATENCY_MIN));
+            stable_count = 0;
+        }
+    }
+}
+
+// Open the device and start the audio thread
+static void audio_start(Audio *audio) {
+    if (!audio->wav) {
+#if OS_LINUX
+        check_or(audio->api.snd_pcm_open(&audio->pcm, "default", SND_PCM_STREAM_PLAYBACK, 0) == 0) return;
+        check_or(
             audio->api.snd_pcm_set_params(
                 audio->pcm, SND_PCM_FORMAT_S16_LE, SND_PCM_ACCESS_RW_INTERLEAVED, audio->channels, AUDIO_RATE, 1, audio->latency_ms * 1000
             ) == 0
-        );
+        ) return;
+#else
+        check_or(!"No audio device on this platform") return;
+#endif
     }
 
-    check(audio->api.snd_pcm_writei(audio->pcm, samples, count) == count);
+    audio->running = true;
+    audio->thread = os_thread_start(mem_perm(), audio_thread, audio);
+}
+
+// Queue 'count' stereo frames for playback
+// - Waits while more than 'latency' frames are queued
+static void audio_play(Audio *audio, i16 *samples, u32 count) {
+    if (!audio->thread) audio_start(audio);
+    if (!audio->thread) return;
+
+    while (count > 0) {
+        u64 read = atomic_load(&audio->queue_read);
+        u64 write = audio->queue_write;
+        u32 queued = write - read;
+        if (queued > atomic_load(&audio->latency) || queued == AUDIO_QUEUE_SIZE) {
+            os_sleep(TIME_MS);
+            continue;
+        }
+
+        u32 push = u_min(count, AUDIO_QUEUE_SIZE - queued);
+        u32 ix = write % AUDIO_QUEUE_SIZE;
+        for (u32 i = 0; i < push; ++i) {
+            audio->queue[ix * 2 + 0] = samples[i * 2 + 0];
+            audio->queue[ix * 2 + 1] = samples[i * 2 + 1];
+            if (++ix == AUDIO_QUEUE_SIZE) ix = 0;
+        }
+
+        // Publish the new frames to the audio thread
+        atomic_store(&audio->queue_write, write + push);
+        samples += push * 2;
+        count -= push;
+    }
 }
 
 static void audio_record(Audio *audio, i16 *samples, u32 count) {
+#if OS_LINUX
     if (!audio->mic) {
         check_or(audio->api.snd_pcm_open(&audio->mic, "default", SND_PCM_STREAM_CAPTURE, 0) == 0) return;
         check(
@@ -58,10 +254,72 @@ static void audio_record(Audio *audio, i16 *samples, u32 count) {
         );
     }
 
-    check(audio->api.snd_pcm_readi(audio->pcm, samples, count) == count);
+    check(audio->api.snd_pcm_readi(audio->mic, samples, count) == count);
+#else
+    check_or(!"No audio device on this platform") return;
+#endif
 }
 
+// Write collected samples as a 16 bit stereo WAV file
+static void audio_write_wav(char *path, Buffer data) {
+    Memory *mem = mem_new();
+    Write *header = write_new(mem);
+    u32 block_align = 2 * sizeof(i16);
+
+    // RIFF header
+    write_buffer(header, str_buf("RIFF"));
+    write_u32(header, 36 + data.size);
+    write_buffer(header, str_buf("WAVE"));
+
+    // Format, PCM
+    write_buffer(header, str_buf("fmt "));
+    write_u32(header, 16);
+    write_u16(header, 1);
+    write_u16(header, 2);
+    write_u32(header, AUDIO_RATE);
+    write_u32(header, AUDIO_RATE * block_align);
+    write_u16(header, block_align);
+    write_u16(header, 16);
+
+    // Samples
+    write_buffer(header, str_buf("data"));
+    write_u32(header, data.size);
+
+    File *file = fs_open(path, FileMode_Write);
+    check_or(file) {
+        mem_free(mem);
+        return;
+    }
+    io_write(file, write_get_written(header));
+    io_write(file, data);
+    io_close(file);
+    mem_free(mem);
+}
+
+// Play everything that is still queued and close the device
 static void audio_close(Audio *audio) {
-    check(audio->api.snd_pcm_drain(audio->pcm) == 0);
-    check(audio->api.snd_pcm_close(audio->pcm) == 0);
+    if (audio->thread) {
+        atomic_store(&audio->running, false);
+        os_thread_join(audio->thread);
+        audio->thread = 0;
+    }
+
+    if (audio->wav) {
+        audio_write_wav(audio->wav_path, write_get_written(audio->wav));
+        mem_free(audio->wav_mem);
+        audio->wav = 0;
+    }
+
+#if OS_LINUX
+    if (audio->pcm) {
+        check(audio->api.snd_pcm_drain(audio->pcm) == 0);
+        check(audio->api.snd_pcm_close(audio->pcm) == 0);
+        audio->pcm = 0;
+    }
+
+    if (audio->mic) {
+        check(audio->api.snd_pcm_close(audio->mic) == 0);
+        audio->mic = 0;
+    }
+#endif
 }
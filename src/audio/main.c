@@ -1,58 +1,127 @@
 // Copyright (c) 2026 - Tom Smeets <tom@tsmeets.nl>
 // main.c - Game entrypoint
 #include "alsa.h"
+#include "assert.h"
 #include "audio.h"
 #include "fmt.h"
 #include "macro.h"
 #include "math.h"
 #include "os_main.h"
 #include "sound.h"
+#include "str.h"
+#include "time.h"
 #include "type.h"
 #include "vec.h"
 
-// Generate audio sample
-static v2f sample(Sound *snd) {
-    f32 p = sound_sin(snd, .5, 0);
-    f32 v1 = sound_sin(snd, 400 + 10 * p, 0);
-    f32 v2 = sound_sin(snd, 200, v1);
-    f32 v3 = sound_noise_white(snd);
+// Generate a block of audio samples
+static Sound_Block2 sample(Sound *snd) {
+    Sound_Block sweep = sound_sin_block(snd, sound_block(0.02), sound_block(0));
+    Sound_Block noise = sound_noise_white_block(snd);
 
-    f32 p1 = f_clamp(p, 0, 1);
-    f32 p2 = f_clamp(-p, 0, 1);
-
-    Freeverb_Config cfg = {
-        .room = 0.8f,
-        .damp = 0.2f,
-        .wet = 0.5f,
-        .dry = 1.0f,
-    };
-    v2f out = {};
+    Sound_Block cutoff;
+    for (u32 i = 0; i < SOUND_BLOCK; ++i) cutoff.value[i] = 400 + sweep.value[i] * 100;
 
     // snowstorm
-    out += ((v2f){1, 1}) * sound_filter(snd, 400 + sound_sin(snd, 0.02, 0) * 100, v3).band_pass;
-    // out += sound_sin(snd, NOTE_C * OCT_4, sound_sin(snd, NOTE_A * OCT_0, 0));
+    Sound_Block out = sound_filter_block(snd, cutoff, noise).band_pass;
+    return (Sound_Block2){out, out};
+}
+
+// A single voice, a sine with vibrato through a filter
+static f32 bench_voice(Sound *snd, f32 freq) {
+    f32 vibrato = sound_sin(snd, 5, 0);
+    f32 v = sound_sin(snd, freq + vibrato * 4, 0);
+    return sound_filter(snd, 1000, v).low_pass;
+}
+
+// Block version of 'bench_voice'
+static Sound_Block bench_voice_block(Sound *snd, f32 freq) {
+    Sound_Block vibrato = sound_sin_block(snd, sound_block(5), sound_block(0));
+    for (u32 i = 0; i < SOUND_BLOCK; ++i) vibrato.value[i] = freq + vibrato.value[i] * 4;
+    Sound_Block v = sound_sin_block(snd, vibrato, sound_block(0));
+    return sound_filter_block(snd, sound_block(1000), v).low_pass;
+}
+
+// Measure how much of a single core is needed to synthesize many voices
+static void bench(void) {
+    Sound *snd = mem_struct(mem_perm(), Sound);
+    u32 voice_count = 256;
+    u32 sample_count = AUDIO_RATE;
+    f32 sum = 0;
 
-    // out += sound_filter(snd, 800, sound_noise_white(snd) * f_max(sound_sin(snd, 1, 0) * 4 - 3, 0) * 2).band_pass;
-    return out;
+    time_t start = time_now();
+    for (u32 i = 0; i < sample_count; ++i) {
+        sound_start(snd);
+        for (u32 v = 0; v < voice_count; ++v) sum += bench_voice(snd, 100 + v);
+    }
+    time_t duration_sample = time_now() - start;
+
+    start = time_now();
+    for (u32 i = 0; i < sample_count; i += SOUND_BLOCK) {
+        sound_start(snd);
+        for (u32 v = 0; v < voice_count; ++v) sum += bench_voice_block(snd, 100 + v).value[0];
+    }
+    time_t duration_block = time_now() - start;
+
+    print("Voices: ", voice_count, ", checksum ", (i32)sum);
+    print("Per sample: ", duration_sample / TIME_MS, " ms per second of audio (", duration_sample * 100 / TIME_SEC, "% cpu)");
+    print("Per block:  ", duration_block / TIME_MS, " ms per second of audio (", duration_block * 100 / TIME_SEC, "% cpu)");
 }
 
 static bool init;
 static Audio audio;
 static Sound snd = {};
 
+// Current block and how many of its samples were played
+static Sound_Block2 block;
+static u32 block_index = SOUND_BLOCK;
+
+// Synthesize and queue 'count' frames
+static void render(u32 count) {
+    i16 samples[AUDIO_BUFFER_SIZE * 2];
+    f32 volume = 0.1;
+    assert(count <= AUDIO_BUFFER_SIZE);
+    for (u32 i = 0; i < count * 2;) {
+        if (block_index == SOUND_BLOCK) {
+            sound_start(&snd);
+            block = sample(&snd);
+            block_index = 0;
+        }
+
+        v2f out = {block.left.value[block_index], block.right.value[block_index]};
+        out = v2f_clamp(out * volume, -1, 1) * 0x7fff;
+        samples[i++] = (i16)out.x;
+        samples[i++] = (i16)out.y;
+        block_index++;
+    }
+    audio_play(&audio, samples, count);
+}
+
 static void os_main(void) {
     if (!init) {
+        if (os_argc == 2 && str_eq(os_argv[1], "--bench")) {
+            bench();
+            os_exit();
+        }
+
+        // Render 10 seconds without audio hardware
+        if (os_argc == 3 && str_eq(os_argv[1], "--wav")) {
+            audio = audio_open_wav(os_argv[2]);
+            for (u32 i = 0; i < 10 * AUDIO_RATE / AUDIO_BUFFER_SIZE; ++i) render(AUDIO_BUFFER_SIZE);
+            audio_close(&audio);
+            os_exit();
+        }
+
         audio = audio_open();
         init = 1;
     }
 
-    i16 samples[AUDIO_BUFFER_SIZE * 2];
-    f32 volume = 0.1;
-    for (u32 i = 0; i < array_count(samples);) {
-        sound_start(&snd);
-        v2f out = v2f_clamp(sample(&snd) * volume, -1, 1) * 0x7fff;
-        samples[i++] = (i16)out.x;
-        samples[i++] = (i16)out.y;
+    render(AUDIO_BUFFER_SIZE);
+
+    // Report audio problems
+    static u32 underrun_count, xrun_count;
+    if (audio.underrun_count != underrun_count || audio.xrun_count != xrun_count) {
+        underrun_count = audio.underrun_count;
+        xrun_count = audio.xrun_count;
+        print("Underruns: ", underrun_count, " xruns: ", xrun_count, " latency: ", audio.latency * 1000 / AUDIO_RATE, " ms");
     }
-    audio_play(&audio, samples, array_count(samples) / 2);
 }
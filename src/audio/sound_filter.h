@@ -4,6 +4,7 @@
 #include "audio.h"
 #include "macro.h"
 #include "math.h"
+#include "mem.h"
 #include "sound_note.h"
 #include "sound_var.h"
 #include "type.h"
@@ -15,6 +16,12 @@ typedef struct {
     f32 high_pass;
 } Sound_Filter_Result;
 
+typedef struct {
+    Sound_Block low_pass;
+    Sound_Block band_pass;
+    Sound_Block high_pass;
+} Sound_Filter_Block;
+
 // Filter the incoming samples at a given cutoff frequency.
 static Sound_Filter_Result sound_filter(Sound *sound, f32 cutoff_freq, f32 sample) {
     f32 *var0 = sound_var(sound);
@@ -44,6 +51,54 @@ static Sound_Filter_Result sound_filter(Sound *sound, f32 cutoff_freq, f32 sampl
     return (Sound_Filter_Result){lp, bp, hp};
 }
 
+// Block version of 'sound_filter'
+static Sound_Filter_Block sound_filter_block(Sound *sound, Sound_Block cutoff_freq, Sound_Block sample) {
+    f32 *var0 = sound_var(sound);
+    f32 *var1 = sound_var(sound);
+
+    // The filter is linear, so the update can be written as
+    //   v0' = a * v0 - b * v1 + c
+    //   v1' = d * v1 + e * v0 + g
+    // The coefficients do not depend on the previous sample and are computed for the whole block.
+    // This leaves a much shorter dependency chain from one sample to the next.
+    Sound_Block a, b, c, d, e, g;
+    f32 q = 0.9f;
+    for (u32 i = 0; i < SOUND_BLOCK; ++i) {
+        f32 rc = 1.0f / (cutoff_freq.value[i] * 2 * PI);
+        f32 f = AUDIO_DT / (rc + AUDIO_DT);
+        f32 fb = q + q / (1.0f - f);
+        a.value[i] = 1.0f - f + f * fb;
+        b.value[i] = f * fb;
+        c.value[i] = f * sample.value[i];
+        d.value[i] = 1.0f - f - f * b.value[i];
+        e.value[i] = f * a.value[i];
+        g.value[i] = f * c.value[i];
+    }
+
+    // State before each sample
+    Sound_Block s0, s1;
+    f32 v0 = *var0;
+    f32 v1 = *var1;
+    for (u32 i = 0; i < SOUND_BLOCK; ++i) {
+        s0.value[i] = v0;
+        s1.value[i] = v1;
+        f32 n0 = a.value[i] * v0 - b.value[i] * v1 + c.value[i];
+        f32 n1 = d.value[i] * v1 + e.value[i] * v0 + g.value[i];
+        v0 = n0;
+        v1 = n1;
+    }
+    *var0 = v0;
+    *var1 = v1;
+
+    Sound_Filter_Block ret;
+    for (u32 i = 0; i < SOUND_BLOCK; ++i) {
+        ret.high_pass.value[i] = sample.value[i] - s0.value[i];
+        ret.band_pass.value[i] = s0.value[i] - s1.value[i];
+        ret.low_pass.value[i] = i + 1 < SOUND_BLOCK ? s1.value[i + 1] : v1;
+    }
+    return ret;
+}
+
 // Simple low-pass filter
 static f32 sound_lowpass(Sound *sound, f32 cutoff_freq, f32 sample) {
     f32 *value = sound_var(sound);
@@ -53,6 +108,27 @@ static f32 sound_lowpass(Sound *sound, f32 cutoff_freq, f32 sample) {
     return ret;
 }
 
+// Block version of 'sound_lowpass'
+static Sound_Block sound_lowpass_block(Sound *sound, Sound_Block cutoff_freq, Sound_Block sample) {
+    f32 *value = sound_var(sound);
+
+    // v' = v * b + x * a
+    Sound_Block a, b;
+    for (u32 i = 0; i < SOUND_BLOCK; ++i) {
+        b.value[i] = f_exp(-AUDIO_DT * PI * 2 * cutoff_freq.value[i]);
+        a.value[i] = (1.0f - b.value[i]) * sample.value[i];
+    }
+
+    Sound_Block ret;
+    f32 v = *value;
+    for (u32 i = 0; i < SOUND_BLOCK; ++i) {
+        ret.value[i] = v;
+        v = v * b.value[i] + a.value[i];
+    }
+    *value = v;
+    return ret;
+}
+
 // https://github.com/sinshu/freeverb/blob/main/Components/comb.hpp
 static f32 sound_comb(Sound *sound, u32 size, f32 damp, f32 feedback, f32 input) {
     f32 *buf = sound_vars(sound, size);
@@ -71,6 +147,33 @@ static f32 sound_comb(Sound *sound, u32 size, f32 damp, f32 feedback, f32 input)
     return output;
 }
 
+// Block version of 'sound_comb'
+// The delay line is processed in contiguous runs between the wrap arounds.
+static Sound_Block sound_comb_block(Sound *sound, u32 size, f32 damp, f32 feedback, Sound_Block input) {
+    f32 *buf = sound_vars(sound, size);
+    f32 *filter = sound_var(sound);
+    u32 *ix = sound_u32(sound);
+
+    Sound_Block ret;
+    f32 lp = *filter;
+    f32 undamped = 1.0f - damp;
+    for (u32 i = 0; i < SOUND_BLOCK;) {
+        if (*ix >= size) *ix = 0;
+        u32 count = u_min(SOUND_BLOCK - i, size - *ix);
+        f32 *line = buf + *ix;
+        for (u32 j = 0; j < count; ++j) {
+            f32 output = line[j];
+            lp = lp * damp + output * undamped;
+            line[j] = input.value[i + j] + feedback * lp;
+            ret.value[i + j] = output;
+        }
+        *ix += count;
+        i += count;
+    }
+    *filter = lp;
+    return ret;
+}
+
 // https://github.com/sinshu/freeverb/blob/main/Components/allpass.hpp
 static f32 sound_allpass(Sound *sound, u32 size, f32 feedback, f32 input) {
     f32 *buf = sound_vars(sound, size);
@@ -83,6 +186,28 @@ static f32 sound_allpass(Sound *sound, u32 size, f32 feedback, f32 input) {
     return output - input;
 }
 
+// Block version of 'sound_allpass'
+// Samples within a run of the delay line are independent.
+static Sound_Block sound_allpass_block(Sound *sound, u32 size, f32 feedback, Sound_Block input) {
+    f32 *buf = sound_vars(sound, size);
+    u32 *ix = sound_u32(sound);
+
+    Sound_Block ret;
+    for (u32 i = 0; i < SOUND_BLOCK;) {
+        if (*ix >= size) *ix = 0;
+        u32 count = u_min(SOUND_BLOCK - i, size - *ix);
+        f32 *line = buf + *ix;
+        for (u32 j = 0; j < count; ++j) {
+            f32 output = line[j];
+            line[j] = input.value[i + j] + feedback * output;
+            ret.value[i + j] = output - input.value[i + j];
+        }
+        *ix += count;
+        i += count;
+    }
+    return ret;
+}
+
 static f32 sound_freeverb(Sound *sound, u32 spread, f32 feedback, f32 damp, f32 input) {
     // Rescale factor for 44.1 KHz to 48 KHz
     f32 a = (f32)AUDIO_RATE / 44100.0f;
@@ -104,6 +229,24 @@ static f32 sound_freeverb(Sound *sound, u32 spread, f32 feedback, f32 damp, f32
     return out;
 }
 
+// Block version of 'sound_freeverb'
+static Sound_Block sound_freeverb_block(Sound *sound, u32 spread, f32 feedback, f32 damp, Sound_Block input) {
+    f32 a = (f32)AUDIO_RATE / 44100.0f;
+    u32 comb_size[] = {1116, 1188, 1277, 1356, 1422, 1491, 1557, 1617};
+    u32 allpass_size[] = {556, 441, 341, 225};
+
+    Sound_Block out = sound_block(0);
+    for (u32 c = 0; c < array_count(comb_size); ++c) {
+        Sound_Block comb = sound_comb_block(sound, (comb_size[c] + spread) * a, damp, feedback, input);
+        for (u32 i = 0; i < SOUND_BLOCK; ++i) out.value[i] += comb.value[i];
+    }
+
+    for (u32 c = 0; c < array_count(allpass_size); ++c) {
+        out = sound_allpass_block(sound, (allpass_size[c] + spread) * a, 0.5, out);
+    }
+    return out;
+}
+
 typedef struct {
     // Room size
     f32 room;
@@ -142,6 +285,110 @@ static v2f sound_freeverb2(Sound *sound, Freeverb_Config cfg, v2f input) {
     return (v2f){out_l, out_r};
 }
 
+// Comb filters per channel
+#define FREEVERB_COMBS 8
+
+// Comb filters of both channels, processed together as vector lanes
+#define FREEVERB_LANES (2 * FREEVERB_COMBS)
+
+// Block version of 'sound_freeverb2'
+//
+// The 16 comb filters (8 per channel) are lanes of a single vector. Their
+// delay lines are stored together with one row of 16 lanes per sample.
+// Every lane reads at its own delay behind the shared write position. All
+// delays are longer than a block, so the reads for a block are gathered
+// first. After that each sample updates every lane at once and stores a
+// whole row.
+//
+// The allpass filters are processed one block at a time, for the same reason.
+//
+// The state layout is different from 'sound_freeverb2'.
+static Sound_Block2 sound_freeverb2_block(Sound *sound, Freeverb_Config cfg, Sound_Block2 input) {
+    u32 stero_spread = 23;
+    f32 width = 1.0f;
+    f32 gain = 0.015f;
+
+    f32 room = cfg.room * 0.28f + 0.7f;
+    f32 damp = cfg.damp * 0.40f;
+    f32 wet = cfg.wet * 3.0f;
+    f32 dry = cfg.dry * 2.0f;
+
+    f32 wet_1 = wet * 0.5f * (width + 1);
+    f32 wet_2 = wet * 0.5f * (1 - width);
+
+    // Rescale factor for 44.1 KHz to 48 KHz
+    f32 a = (f32)AUDIO_RATE / 44100.0f;
+    u32 comb_size[FREEVERB_COMBS] = {1116, 1188, 1277, 1356, 1422, 1491, 1557, 1617};
+    u32 allpass_size[] = {556, 441, 341, 225};
+
+    // Lanes '0 .. 8' are the left channel, the right channel is spread a bit further
+    u32 delay[FREEVERB_LANES];
+    u32 length = 0;
+    for (u32 c = 0; c < FREEVERB_LANES; ++c) {
+        u32 spread = c < FREEVERB_COMBS ? 0 : stero_spread;
+        delay[c] = (comb_size[c % FREEVERB_COMBS] + spread) * a;
+        length = u_max(length, delay[c]);
+    }
+
+    f32 *lines = sound_vars(sound, length * FREEVERB_LANES);
+    f32 *filter = sound_vars(sound, FREEVERB_LANES);
+    u32 *pos = sound_u32(sound);
+    if (*pos >= length) *pos = 0;
+
+    Sound_Block real_input;
+    for (u32 i = 0; i < SOUND_BLOCK; ++i) real_input.value[i] = (input.left.value[i] + input.right.value[i]) * gain;
+
+    // Gather the comb outputs, these were written before this block
+    Sound_Block l = sound_block(0);
+    Sound_Block r = sound_block(0);
+    f32 comb[SOUND_BLOCK][FREEVERB_LANES];
+    for (u32 c = 0; c < FREEVERB_LANES; ++c) {
+        Sound_Block *sum = c < FREEVERB_COMBS ? &l : &r;
+        u32 row = *pos + length - delay[c];
+        if (row >= length) row -= length;
+        for (u32 i = 0; i < SOUND_BLOCK;) {
+            u32 count = u_min(SOUND_BLOCK - i, length - row);
+            f32 *line = lines + row * FREEVERB_LANES + c;
+            for (u32 j = 0; j < count; ++j) {
+                f32 output = line[j * FREEVERB_LANES];
+                comb[i + j][c] = output;
+                sum->value[i + j] += output;
+            }
+            row = 0;
+            i += count;
+        }
+    }
+
+    // Low pass filter + Feedback, for all lanes at once
+    f32 lp[FREEVERB_LANES];
+    for (u32 c = 0; c < FREEVERB_LANES; ++c) lp[c] = filter[c];
+
+    f32 undamped = 1.0f - damp;
+    u32 row = *pos;
+    for (u32 i = 0; i < SOUND_BLOCK; ++i) {
+        f32 *line = lines + row * FREEVERB_LANES;
+        for (u32 c = 0; c < FREEVERB_LANES; ++c) {
+            lp[c] += (comb[i][c] - lp[c]) * undamped;
+            line[c] = real_input.value[i] + room * lp[c];
+        }
+        if (++row == length) row = 0;
+    }
+    *pos = row;
+    for (u32 c = 0; c < FREEVERB_LANES; ++c) filter[c] = lp[c];
+
+    for (u32 k = 0; k < array_count(allpass_size); ++k) {
+        l = sound_allpass_block(sound, allpass_size[k] * a, 0.5, l);
+        r = sound_allpass_block(sound, (allpass_size[k] + stero_spread) * a, 0.5, r);
+    }
+
+    Sound_Block2 out;
+    for (u32 i = 0; i < SOUND_BLOCK; ++i) {
+        out.left.value[i] = l.value[i] * wet_1 + r.value[i] * wet_2 + input.left.value[i] * dry;
+        out.right.value[i] = r.value[i] * wet_1 + l.value[i] * wet_2 + input.right.value[i] * dry;
+    }
+    return out;
+}
+
 static f32 sound_delay(Sound *sound, f32 sample, f32 time, f32 max) {
     if (time > max) time = max;
     if (time < 0) time = 0;
@@ -165,6 +412,31 @@ static f32 sound_delay(Sound *sound, f32 sample, f32 time, f32 max) {
     return out;
 }
 
+// Block version of 'sound_delay'
+static Sound_Block sound_delay_block(Sound *sound, Sound_Block sample, Sound_Block time, f32 max) {
+    u32 count = max * AUDIO_RATE + 1;
+    f32 *samples = sound_vars(sound, count);
+    u32 *ix = sound_u32(sound);
+
+    Sound_Block ret;
+    u32 j = *ix;
+    for (u32 i = 0; i < SOUND_BLOCK; ++i) {
+        f32 t = f_clamp(time.value[i], 0, max);
+        u32 offset = t * AUDIO_RATE;
+        if (offset >= count) offset = count - 1;
+
+        if (j >= count) j = 0;
+        samples[j] = sample.value[i];
+
+        u32 j2 = j + count - offset;
+        if (j2 >= count) j2 -= count;
+        ret.value[i] = samples[j2];
+        j++;
+    }
+    *ix = j;
+    return ret;
+}
+
 static v2f sound_pan(Sound *sound, f32 sample, v3f dir) {
     f32 distance_sq = v3f_length_sq(dir);
     f32 inv_distance = f_rsqrt(distance_sq);
@@ -188,11 +460,48 @@ static v2f sound_pan(Sound *sound, f32 sample, v3f dir) {
     return out;
 }
 
+// Block version of 'sound_pan', the direction is constant for the whole block
+static Sound_Block2 sound_pan_block(Sound *sound, Sound_Block sample, v3f dir) {
+    f32 distance_sq = v3f_length_sq(dir);
+    f32 inv_distance = f_rsqrt(distance_sq);
+    dir *= inv_distance;
+
+    f32 scale = 0.6f / 1000 * 1;
+
+    f32 ang_right = f_max(-dir.x, 0);
+    f32 ang_left = f_max(dir.x, 0);
+
+    Sound_Block2 out;
+    out.left = sound_delay_block(sound, sample, sound_block(ang_right * scale), scale);
+    out.right = sound_delay_block(sound, sample, sound_block(ang_left * scale), scale);
+
+    Sound_Block left_lp = sound_filter_block(sound, sound_block(2000), out.left).low_pass;
+    Sound_Block right_lp = sound_filter_block(sound, sound_block(2000), out.right).low_pass;
+    f32 left_mix = ang_right - (dir.z + 1) / 2 * 0.5;
+    f32 right_mix = ang_left - (dir.z + 1) / 2 * 0.5;
+
+    f32 gain = distance_sq == 0 ? 1 : inv_distance;
+    if (gain > 1) gain = 1;
+    for (u32 i = 0; i < SOUND_BLOCK; ++i) {
+        out.left.value[i] = (out.left.value[i] + (left_lp.value[i] - out.left.value[i]) * left_mix) * gain;
+        out.right.value[i] = (out.right.value[i] + (right_lp.value[i] - out.right.value[i]) * right_mix) * gain;
+    }
+    return out;
+}
+
 // Calculate rms volume
 static f32 sound_volume(Sound *snd, f32 input) {
     return f_sqrt(sound_lowpass(snd, 1, input * input));
 }
 
+// Block version of 'sound_volume'
+static Sound_Block sound_volume_block(Sound *snd, Sound_Block input) {
+    for (u32 i = 0; i < SOUND_BLOCK; ++i) input.value[i] *= input.value[i];
+    Sound_Block ret = sound_lowpass_block(snd, sound_block(1), input);
+    for (u32 i = 0; i < SOUND_BLOCK; ++i) ret.value[i] = f_sqrt(ret.value[i]);
+    return ret;
+}
+
 // Get frequency by zero counting
 static f32 sound_freq(Sound *snd, f32 in) {
     f32 vol = sound_volume(snd, in);
@@ -216,3 +525,68 @@ static f32 sound_freq(Sound *snd, f32 in) {
     // return *freq;
     return sound_lowpass(snd, 1, *freq);
 }
+
+static void test_sound_filter(void) {
+    Memory *mem = mem_new();
+    Sound *snd = mem_struct(mem, Sound);
+    Sound *snd_block = mem_struct(mem, Sound);
+    Rand rng = rand_from(1);
+
+    // The block versions compute the same recurrences in a different order,
+    // so they stay within a small distance of the per sample version.
+    f32 eps = 1e-4f;
+    for (u32 b = 0; b < 256; ++b) {
+        Sound_Block input, cutoff, time;
+        for (u32 i = 0; i < SOUND_BLOCK; ++i) {
+            u32 t = b * SOUND_BLOCK + i;
+            input.value[i] = rand_f32(&rng, -1, 1);
+            cutoff.value[i] = 200 + t * 0.2f;
+            time.value[i] = t * 0.00001f;
+        }
+
+        sound_start(snd_block);
+        Sound_Filter_Block filter = sound_filter_block(snd_block, cutoff, input);
+        Sound_Block lowpass = sound_lowpass_block(snd_block, cutoff, input);
+        Sound_Block comb = sound_comb_block(snd_block, 100, 0.2f, 0.8f, input);
+        Sound_Block allpass = sound_allpass_block(snd_block, 50, 0.5f, input);
+        Sound_Block freeverb = sound_freeverb_block(snd_block, 0, 0.8f, 0.2f, input);
+        Sound_Block delay = sound_delay_block(snd_block, input, time, 0.01f);
+        Sound_Block volume = sound_volume_block(snd_block, input);
+        for (u32 i = 0; i < SOUND_BLOCK; ++i) {
+            f32 x = input.value[i];
+            sound_start(snd);
+            Sound_Filter_Result r = sound_filter(snd, cutoff.value[i], x);
+            check(f_abs(filter.low_pass.value[i] - r.low_pass) < eps);
+            check(f_abs(filter.band_pass.value[i] - r.band_pass) < eps);
+            check(f_abs(filter.high_pass.value[i] - r.high_pass) < eps);
+            check(f_abs(lowpass.value[i] - sound_lowpass(snd, cutoff.value[i], x)) < eps);
+            check(f_abs(comb.value[i] - sound_comb(snd, 100, 0.2f, 0.8f, x)) < eps);
+            check(allpass.value[i] == sound_allpass(snd, 50, 0.5f, x));
+            check(f_abs(freeverb.value[i] - sound_freeverb(snd, 0, 0.8f, 0.2f, x)) < eps);
+            check(delay.value[i] == sound_delay(snd, x, time.value[i], 0.01f));
+            check(f_abs(volume.value[i] - sound_volume(snd, x)) < eps);
+        }
+    }
+
+    // Long enough for every comb and allpass delay line to wrap a few times
+    snd = mem_struct(mem, Sound);
+    snd_block = mem_struct(mem, Sound);
+    Freeverb_Config cfg = {.room = 0.8f, .damp = 0.3f, .wet = 0.5f, .dry = 0.5f};
+    for (u32 b = 0; b < 256; ++b) {
+        Sound_Block2 input;
+        for (u32 i = 0; i < SOUND_BLOCK; ++i) {
+            input.left.value[i] = rand_f32(&rng, -1, 1);
+            input.right.value[i] = rand_f32(&rng, -1, 1);
+        }
+
+        sound_start(snd_block);
+        Sound_Block2 out = sound_freeverb2_block(snd_block, cfg, input);
+        for (u32 i = 0; i < SOUND_BLOCK; ++i) {
+            sound_start(snd);
+            v2f expected = sound_freeverb2(snd, cfg, (v2f){input.left.value[i], input.right.value[i]});
+            check(out.left.value[i] == expected.x);
+            check(out.right.value[i] == expected.y);
+        }
+    }
+    mem_free(mem);
+}
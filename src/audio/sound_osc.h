@@ -1,5 +1,6 @@
 #pragma once
 #include "math.h"
+#include "mem.h"
 #include "sound_var.h"
 
 // Create a 0-1 step at a given frequency
@@ -51,3 +52,150 @@ static f32 sound_noise_freq(Sound *sound, f32 freq, f32 duty) {
     if (trigger) *value = rand_f32(&sound->rng, -1, 1);
     return *value;
 }
+
+// Block version of 'sound_phase'
+static Sound_Block sound_phase_block(Sound *snd, Sound_Block freq, Sound_Block offset) {
+    f32 *phase = sound_var(snd);
+
+    // Running sum of the frequency, the only part that depends on the previous sample.
+    // The phase stays small enough within a block to wrap it only at the end.
+    Sound_Block ret;
+    f32 p = *phase;
+    for (u32 i = 0; i < SOUND_BLOCK; ++i) {
+        ret.value[i] = p;
+        p += AUDIO_DT * freq.value[i];
+    }
+    *phase = f_fract(p);
+
+    for (u32 i = 0; i < SOUND_BLOCK; ++i) ret.value[i] = f_fract(ret.value[i] + offset.value[i]);
+    return ret;
+}
+
+// Block version of 'sound_saw'
+static Sound_Block sound_saw_block(Sound *snd, Sound_Block freq, Sound_Block phase) {
+    for (u32 i = 0; i < SOUND_BLOCK; ++i) phase.value[i] += 0.5f;
+    Sound_Block ret = sound_phase_block(snd, freq, phase);
+    for (u32 i = 0; i < SOUND_BLOCK; ++i) ret.value[i] = ret.value[i] * 2.0f - 1.0f;
+    return ret;
+}
+
+// Block version of 'sound_pulse'
+static Sound_Block sound_pulse_block(Sound *sound, Sound_Block freq, Sound_Block offset, Sound_Block duty) {
+    Sound_Block ret = sound_phase_block(sound, freq, offset);
+    for (u32 i = 0; i < SOUND_BLOCK; ++i) ret.value[i] = ret.value[i] < duty.value[i] ? 1 : -1;
+    return ret;
+}
+
+// Block version of 'sound_sin'
+static Sound_Block sound_sin_block(Sound *s, Sound_Block freq, Sound_Block phase) {
+    Sound_Block ret = sound_phase_block(s, freq, phase);
+    for (u32 i = 0; i < SOUND_BLOCK; ++i) ret.value[i] = f_sin2pi(ret.value[i]);
+    return ret;
+}
+
+// Block version of 'sound_triangle'
+static Sound_Block sound_triangle_block(Sound *sound, Sound_Block freq, Sound_Block offset) {
+    Sound_Block ret = sound_phase_block(sound, freq, offset);
+    for (u32 i = 0; i < SOUND_BLOCK; ++i) ret.value[i] = f_min(ret.value[i] * 4 - 1, 3 - ret.value[i] * 4);
+    return ret;
+}
+
+// Block version of 'sound_noise_white'
+static Sound_Block sound_noise_white_block(Sound *sound) {
+    Sound_Block ret;
+    for (u32 i = 0; i < SOUND_BLOCK; ++i) ret.value[i] = rand_f32(&sound->rng, -1, 1);
+    return ret;
+}
+
+// Block version of 'sound_noise_freq'
+static Sound_Block sound_noise_freq_block(Sound *sound, Sound_Block freq) {
+    f32 *value = sound_var(sound);
+    f32 *time = sound_var(sound);
+    Sound_Block ret;
+    f32 v = *value;
+    f32 t = *time;
+    for (u32 i = 0; i < SOUND_BLOCK; ++i) {
+        t += AUDIO_DT * freq.value[i];
+        bool trigger = t > 1.0f;
+        t = f_fract(t);
+        if (trigger) v = rand_f32(&sound->rng, -1, 1);
+        ret.value[i] = v;
+    }
+    *value = v;
+    *time = t;
+    return ret;
+}
+
+// Distance between two samples of a wave that wraps around every 'period'
+static f32 sound_osc_diff(f32 a, f32 b, f32 period) {
+    f32 d = f_abs(a - b);
+    return f_min(d, f_abs(period - d));
+}
+
+static void test_sound_osc(void) {
+    Memory *mem = mem_new();
+
+    // The block versions wrap the phase once per block instead of every sample,
+    // so the rounding is slightly different.
+    f32 eps = 1e-3f;
+    Sound *snd = mem_struct(mem, Sound);
+    Sound *snd_block = mem_struct(mem, Sound);
+    for (u32 b = 0; b < 64; ++b) {
+        Sound_Block freq, offset, duty;
+        for (u32 i = 0; i < SOUND_BLOCK; ++i) {
+            u32 t = b * SOUND_BLOCK + i;
+            freq.value[i] = 220 + t * 0.25f;
+            offset.value[i] = t * 0.0001f;
+            duty.value[i] = 0.3f;
+        }
+
+        sound_start(snd_block);
+        Sound_Block phase = sound_phase_block(snd_block, freq, offset);
+        Sound_Block saw = sound_saw_block(snd_block, freq, offset);
+        Sound_Block pulse = sound_pulse_block(snd_block, freq, offset, duty);
+        Sound_Block sin = sound_sin_block(snd_block, freq, offset);
+        Sound_Block triangle = sound_triangle_block(snd_block, freq, offset);
+        for (u32 i = 0; i < SOUND_BLOCK; ++i) {
+            f32 f = freq.value[i];
+            f32 o = offset.value[i];
+            f32 d = duty.value[i];
+
+            sound_start(snd);
+            f32 p = sound_phase(snd, f, o);
+            check(sound_osc_diff(phase.value[i], p, 1) < eps);
+            check(sound_osc_diff(saw.value[i], sound_saw(snd, f, o), 2) < eps);
+
+            // The pulse can only differ where the phase is close to an edge
+            f32 edge = f_min(f_min(p, 1 - p), f_abs(p - d));
+            check(pulse.value[i] == sound_pulse(snd, f, o, d) || edge < eps);
+            check(f_abs(sin.value[i] - sound_sin(snd, f, o)) < eps);
+            check(f_abs(triangle.value[i] - sound_triangle(snd, f, o)) < eps);
+        }
+    }
+
+    // Noise uses the same random numbers in the same order
+    snd = mem_struct(mem, Sound);
+    snd_block = mem_struct(mem, Sound);
+    snd->rng = snd_block->rng = rand_from(1);
+    for (u32 b = 0; b < 64; ++b) {
+        sound_start(snd_block);
+        Sound_Block white = sound_noise_white_block(snd_block);
+        for (u32 i = 0; i < SOUND_BLOCK; ++i) {
+            sound_start(snd);
+            check(white.value[i] == sound_noise_white(snd));
+        }
+    }
+
+    for (u32 b = 0; b < 64; ++b) {
+        Sound_Block freq;
+        for (u32 i = 0; i < SOUND_BLOCK; ++i) freq.value[i] = 1000 + (b * SOUND_BLOCK + i) * 0.25f;
+
+        sound_start(snd_block);
+        Sound_Block noise = sound_noise_freq_block(snd_block, freq);
+        for (u32 i = 0; i < SOUND_BLOCK; ++i) {
+            sound_start(snd);
+            check(noise.value[i] == sound_noise_freq(snd, freq.value[i], 0));
+        }
+    }
+    mem_free(mem);
+}
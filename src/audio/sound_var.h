@@ -6,13 +6,45 @@
 #include "rand.h"
 #include "type.h"
 
+// Usage:
+//   for (;;) {
+//       sound_start(snd);
+//       f32 out = sound_sin(snd, 440, 0);
+//   }
+//
+// Every node gets its state from 'sound_var' in the order it is called, so the
+// graph has to call the same nodes in the same order every time.
+//
+// Block mode runs the same graph once per SOUND_BLOCK samples. Each '_block'
+// node processes the whole block at once with loops that the compiler can
+// vectorize, and uses the same variables as the per sample version.
+//
+//   for (;;) {
+//       sound_start(snd);
+//       Sound_Block out = sound_sin_block(snd, sound_block(440), sound_block(0));
+//   }
+
+// Number of samples processed by a single block
+#define SOUND_BLOCK 64
+
+// Consecutive samples of a single signal
+typedef struct {
+    _Alignas(32) f32 value[SOUND_BLOCK];
+} Sound_Block;
+
+// Left and right channel
+typedef struct {
+    Sound_Block left;
+    Sound_Block right;
+} Sound_Block2;
+
 typedef struct {
     Rand rng;
     u32 value_index;
     f32 value_list[1 * 1024 * 1024];
 } Sound;
 
-// Start next sample
+// Start next sample, or next block of samples
 static void sound_start(Sound *s) {
     s->value_index = 0;
 }
@@ -50,3 +82,24 @@ static f32 sound_hold(Sound *snd, bool set, f32 input) {
     if (set) *v = input;
     return *v;
 }
+
+// Block with the same value for every sample
+static Sound_Block sound_block(f32 value) {
+    Sound_Block ret;
+    for (u32 i = 0; i < SOUND_BLOCK; ++i) ret.value[i] = value;
+    return ret;
+}
+
+// Block version of 'sound_step'
+static Sound_Block sound_step_block(Sound *s, Sound_Block freq) {
+    f32 *t = sound_var(s);
+    f32 v = *t;
+    Sound_Block ret;
+    for (u32 i = 0; i < SOUND_BLOCK; ++i) {
+        ret.value[i] = v;
+        v += AUDIO_DT * freq.value[i];
+        v -= (i32)v;
+    }
+    *t = v;
+    return ret;
+}
@@ -0,0 +1,267 @@
+// Copyright (c) 2026 - Tom Smeets <tom@tsmeets.nl>
+// sound_voice.h - Polyphonic voices with sample accurate note on/off
+#pragma once
+#include "macro.h"
+#include "math.h"
+#include "mem.h"
+#include "sound_osc.h"
+#include "sound_var.h"
+
+// Usage:
+//   Sound_Voices *voices = sound_voices_new(mem);
+//   u32 id = sound_voice_on(voices, voices->time, (Sound_Voice_Config){.wave = Sound_Wave_Sin, .freq = 440, .gain = 0.5, .hold = true});
+//   sound_voice_off(voices, id, voices->time + AUDIO_RATE / 2);
+//   for (;;) {
+//       sound_start(snd);
+//       Sound_Block out = sound_voices_block(snd, voices);
+//   }
+//
+// Notes are scheduled on the sample clock 'voices->time', which advances by
+// SOUND_BLOCK every rendered block. The envelope is evaluated per sample, so
+// notes start and stop on the exact sample even in the middle of a block.
+//
+// There is a fixed number of voices, when all are in use the quietest voice is
+// replaced. Active voices are kept at the start of each array so rendering
+// only touches the voices that are playing. Each voice also owns a fixed range
+// of Sound variables ('slot'), which stays the same when voices are moved
+// around in the arrays.
+
+// Maximum number of voices playing at the same time
+#define SOUND_VOICE_COUNT 64
+
+// Sound variables reserved for each voice
+#define SOUND_VOICE_VARS 4
+
+// Note off time of a voice that is held until 'sound_voice_off'
+#define SOUND_VOICE_HELD U64_MAX
+
+typedef enum {
+    Sound_Wave_Sin,
+    Sound_Wave_Saw,
+    Sound_Wave_Pulse,
+    Sound_Wave_Triangle,
+    Sound_Wave_Noise,
+} Sound_Wave;
+
+typedef struct {
+    Sound_Wave wave;
+
+    // Frequency in Hz
+    f32 freq;
+
+    // Volume after the attack
+    f32 gain;
+
+    // Fade in and fade out time in seconds
+    f32 attack;
+    f32 release;
+
+    // Seconds between note on and note off
+    f32 duration;
+
+    // Ignore 'duration' and play until 'sound_voice_off'
+    bool hold;
+} Sound_Voice_Config;
+
+typedef struct {
+    // Sample time of the next block
+    u64 time;
+
+    // Voices '[0, count)' are active
+    u32 count;
+    u32 next_id;
+
+    u32 id[SOUND_VOICE_COUNT];
+    u32 slot[SOUND_VOICE_COUNT];
+    bool fresh[SOUND_VOICE_COUNT];
+    Sound_Wave wave[SOUND_VOICE_COUNT];
+    f32 freq[SOUND_VOICE_COUNT];
+    f32 gain[SOUND_VOICE_COUNT];
+
+    // Envelope, times are in samples
+    u64 on[SOUND_VOICE_COUNT];
+    u64 off[SOUND_VOICE_COUNT];
+    f32 attack[SOUND_VOICE_COUNT];
+    f32 release[SOUND_VOICE_COUNT];
+
+    // Volume at the end of the last block, used to pick a voice to replace
+    f32 level[SOUND_VOICE_COUNT];
+} Sound_Voices;
+
+static Sound_Voices *sound_voices_new(Memory *mem) {
+    Sound_Voices *voices = mem_struct(mem, Sound_Voices);
+    voices->next_id = 1;
+    for (u32 i = 0; i < SOUND_VOICE_COUNT; ++i) voices->slot[i] = i;
+    return voices;
+}
+
+// Start a note at sample 'time'
+// - Returns an id for 'sound_voice_off'
+static u32 sound_voice_on(Sound_Voices *voices, u64 time, Sound_Voice_Config cfg) {
+    u32 v = voices->count;
+    if (v < SOUND_VOICE_COUNT) {
+        voices->count++;
+    } else {
+        // Replace the quietest voice
+        v = 0;
+        for (u32 i = 1; i < SOUND_VOICE_COUNT; ++i) {
+            if (voices->level[i] < voices->level[v]) v = i;
+        }
+    }
+
+    u32 id = voices->next_id++;
+    if (voices->next_id == 0) voices->next_id = 1;
+
+    voices->id[v] = id;
+    voices->fresh[v] = true;
+    voices->wave[v] = cfg.wave;
+    voices->freq[v] = cfg.freq;
+    voices->gain[v] = cfg.gain;
+    voices->on[v] = time;
+    voices->off[v] = cfg.hold ? SOUND_VOICE_HELD : time + (u64)(cfg.duration * AUDIO_RATE);
+    voices->attack[v] = cfg.attack * AUDIO_RATE;
+    voices->release[v] = cfg.release * AUDIO_RATE;
+    voices->level[v] = cfg.gain;
+    return id;
+}
+
+// Release a note at sample 'time'
+// - Does nothing when the voice was already replaced or stopped
+static void sound_voice_off(Sound_Voices *voices, u32 id, u64 time) {
+    for (u32 v = 0; v < voices->count; ++v) {
+        if (voices->id[v] != id) continue;
+        if (voices->off[v] == SOUND_VOICE_HELD) voices->off[v] = MAX(time, voices->on[v]);
+        return;
+    }
+}
+
+// Oscillator of a single voice
+static Sound_Block sound_voice_wave(Sound *snd, Sound_Wave wave, f32 freq) {
+    Sound_Block zero = sound_block(0);
+    if (wave == Sound_Wave_Saw) return sound_saw_block(snd, sound_block(freq), zero);
+    if (wave == Sound_Wave_Pulse) return sound_pulse_block(snd, sound_block(freq), zero, sound_block(0.5f));
+    if (wave == Sound_Wave_Triangle) return sound_triangle_block(snd, sound_block(freq), zero);
+    if (wave == Sound_Wave_Noise) return sound_noise_white_block(snd);
+    return sound_sin_block(snd, sound_block(freq), zero);
+}
+
+// Render and mix the next block of all active voices
+static Sound_Block sound_voices_block(Sound *snd, Sound_Voices *voices) {
+    Sound_Block out = sound_block(0);
+
+    f32 *vars = sound_vars(snd, SOUND_VOICE_COUNT * SOUND_VOICE_VARS);
+    if (!vars) return out;
+    u32 value_index = snd->value_index;
+
+    u64 time = voices->time;
+    for (u32 v = 0; v < voices->count;) {
+        // Point the oscillator to the variables owned by this voice
+        u32 slot = voices->slot[v];
+        snd->value_index = vars - snd->value_list + slot * SOUND_VOICE_VARS;
+        if (voices->fresh[v]) {
+            for (u32 i = 0; i < SOUND_VOICE_VARS; ++i) vars[slot * SOUND_VOICE_VARS + i] = 0;
+            voices->fresh[v] = false;
+        }
+
+        Sound_Block wave = sound_voice_wave(snd, voices->wave[v], voices->freq[v]);
+
+        // Samples since note on and note off at the start of this block
+        u64 on = voices->on[v];
+        u64 off = voices->off[v];
+        f32 since_on = (f32)((i64)time - (i64)on);
+        f32 since_off = off == SOUND_VOICE_HELD ? -1e30f : (f32)((i64)time - (i64)off);
+        f32 held = off == SOUND_VOICE_HELD ? 1e30f : (f32)(off - on);
+        f32 attack = 1.0f / f_max(voices->attack[v], 1);
+        f32 release = 1.0f / f_max(voices->release[v], 1);
+        f32 gain = voices->gain[v];
+
+        // The attack stops rising at note off
+        Sound_Block env;
+        for (u32 i = 0; i < SOUND_BLOCK; ++i) {
+            f32 env_attack = f_clamp((f_min(since_on + i, held) + 1) * attack, 0, 1);
+            f32 env_release = f_clamp(1 - (since_off + i + 1) * release, 0, 1);
+            env.value[i] = env_attack * env_release * gain;
+        }
+
+        for (u32 i = 0; i < SOUND_BLOCK; ++i) out.value[i] += wave.value[i] * env.value[i];
+        // Notes that did not start yet count at full volume
+        voices->level[v] = time + SOUND_BLOCK > on ? env.value[SOUND_BLOCK - 1] : gain;
+
+        // Finished, move the last active voice into this place
+        bool done = off != SOUND_VOICE_HELD && time + SOUND_BLOCK >= off + (u64)voices->release[v];
+        if (!done) {
+            v++;
+            continue;
+        }
+
+        u32 last = --voices->count;
+        voices->id[v] = voices->id[last];
+        voices->slot[v] = voices->slot[last];
+        voices->fresh[v] = voices->fresh[last];
+        voices->wave[v] = voices->wave[last];
+        voices->freq[v] = voices->freq[last];
+        voices->gain[v] = voices->gain[last];
+        voices->on[v] = voices->on[last];
+        voices->off[v] = voices->off[last];
+        voices->attack[v] = voices->attack[last];
+        voices->release[v] = voices->release[last];
+        voices->level[v] = voices->level[last];
+        voices->slot[last] = slot;
+    }
+
+    snd->value_index = value_index;
+    voices->time += SOUND_BLOCK;
+    return out;
+}
+
+static void test_sound_voice(void) {
+    Memory *mem = mem_new();
+    Sound *snd = mem_struct(mem, Sound);
+    Sound_Voices *voices = sound_voices_new(mem);
+
+    // A note in the middle of a block starts and stops on the exact sample
+    u32 on = 100;
+    u32 off = 1100;
+    u32 id = sound_voice_on(voices, on, (Sound_Voice_Config){.wave = Sound_Wave_Pulse, .freq = 440, .gain = 0.5f, .hold = true});
+    sound_voice_off(voices, id, off);
+
+    u32 first = U32_MAX;
+    u32 last = 0;
+    for (u32 b = 0; b < 2048 / SOUND_BLOCK; ++b) {
+        sound_start(snd);
+        Sound_Block out = sound_voices_block(snd, voices);
+        for (u32 i = 0; i < SOUND_BLOCK; ++i) {
+            if (out.value[i] == 0) continue;
+            u32 sample = b * SOUND_BLOCK + i;
+            first = MIN(first, sample);
+            last = MAX(last, sample);
+        }
+    }
+    check(first == on);
+    check(last == off - 1);
+
+    // The voice is removed after the release
+    check(voices->count == 0);
+
+    // A full pool replaces the quietest voice
+    u32 quiet_id = 0;
+    for (u32 i = 0; i < SOUND_VOICE_COUNT; ++i) {
+        f32 gain = i == 10 ? 0.1f : 0.5f;
+        u32 v = sound_voice_on(voices, voices->time, (Sound_Voice_Config){.wave = Sound_Wave_Pulse, .freq = 440, .gain = gain, .hold = true});
+        if (i == 10) quiet_id = v;
+    }
+    sound_start(snd);
+    sound_voices_block(snd, voices);
+
+    u32 new_id = sound_voice_on(voices, voices->time, (Sound_Voice_Config){.wave = Sound_Wave_Pulse, .freq = 880, .gain = 0.5f, .hold = true});
+    check(voices->count == SOUND_VOICE_COUNT);
+    u32 quiet_count = 0;
+    u32 new_count = 0;
+    for (u32 v = 0; v < voices->count; ++v) {
+        quiet_count += voices->id[v] == quiet_id;
+        new_count += voices->id[v] == new_id;
+    }
+    check(quiet_count == 0);
+    check(new_count == 1);
+    mem_free(mem);
+}
@@ -2,10 +2,12 @@
 // build.h - Helpers for compiling and packaging tlib applications
 #pragma once
 #include "base64.h"
+#include "build_cache.h"
 #include "command.h"
 #include "fs.h"
 #include "io.h"
 #include "proc.h"
+#include "thread.h"
 
 #undef linux
 
@@ -55,6 +57,9 @@ static Command build_compile_command(Build_Platform platform, Build_Mode mode, c
 
     if (platform == Platform_Windows) {
         cmd_arg2(&cmd, "-target", "x86_64-unknown-windows-gnu");
+
+        // WaitOnAddress, used by the futex wrappers
+        cmd_arg(&cmd, "-lsynchronization");
     }
 
     if (platform == Platform_WASM) {
@@ -73,6 +78,7 @@ static Command build_compile_command(Build_Platform platform, Build_Mode mode, c
     cmd_arg2(&cmd, "-I", "src/deflate");
     cmd_arg2(&cmd, "-I", "src/dwarf");
     cmd_arg2(&cmd, "-I", "src/pix");
+    cmd_arg2(&cmd, "-I", "src/audio");
     cmd_arg(&cmd, input);
     return cmd;
 }
@@ -92,6 +98,73 @@ static void build_compile(Build_Platform platform, Build_Mode mode, char *input,
     check(ret == 0);
 }
 
+// A set of compile commands that can run in parallel
+typedef struct {
+    u32 count;
+    Command cmds[8];
+    char *logs[8];
+
+    // Set for every command that exited successfully
+    bool ok[8];
+} Build_Batch;
+
+// Add a command, its output is written to 'log'
+static u32 build_batch_add(Build_Batch *batch, Command cmd, char *log) {
+    assert(batch->count < array_count(batch->cmds));
+    batch->cmds[batch->count] = cmd;
+    batch->logs[batch->count] = log;
+    return batch->count++;
+}
+
+// Print a finished command together with its output
+static void build_batch_report(Command *cmd, char *log) {
+    Memory *mem = mem_new();
+    Fmt *ferr = fmt_new(mem);
+    fmt_cmd(ferr, cmd);
+    fmt_s(ferr, "\n");
+    fmt_buf(ferr, fs_read(mem, log));
+    io_write(io_stderr(), fmt_end(ferr));
+    fs_remove(log);
+    mem_free(mem);
+}
+
+// Run all commands, at most one per cpu core
+// - Each compiler writes to its own log, which is printed when it finishes so output doesn't interleave
+// - After a failure no new commands are started, but running commands are still collected
+static void build_batch_run(Build_Batch *batch) {
+    u32 max = os_cpu_count();
+    u32 next = 0;
+    u32 running = 0;
+    Process *procs[array_count(batch->cmds)];
+    u32 index[array_count(batch->cmds)];
+
+    for (;;) {
+        while (!error && running < max && next < batch->count) {
+            Process *proc = proc_exec_to(batch->cmds[next].argv, batch->logs[next]);
+            if (proc) {
+                procs[running] = proc;
+                index[running] = next;
+                running++;
+            }
+            next++;
+        }
+        if (running == 0) break;
+
+        i32 exit_code = 0;
+        i32 done = proc_wait_any(procs, running, &exit_code);
+        if (done < 0) break;
+
+        u32 i = index[done];
+        build_batch_report(&batch->cmds[i], batch->logs[i]);
+        batch->ok[i] = exit_code == 0;
+        check(exit_code == 0);
+
+        running--;
+        procs[done] = procs[running];
+        index[done] = index[running];
+    }
+}
+
 // static void build_lsp(Build_Platform platform, char *output) {
 //     Memory *mem = mem_new();
 //     Command cmd = build_compile_command(platform, Mode_Debug, "main.c", "out/main.elf");
@@ -191,6 +264,31 @@ static void build_html(Build *build, char *path) {
     build->html_files[build->html_count++] = path;
 }
 
+// A single platform compile in build_build
+typedef struct {
+    bool enabled;
+    Build_Platform platform;
+    char *output;
+    char *log;
+
+    Command cmd;
+    u64 hash;
+
+    // Index in the batch plus one, zero if not compiled
+    u32 batch_index;
+} Build_Compile;
+
+// Hash everything that ends up in the html output
+static u64 build_hash_html(Build *build, u64 wasm_hash) {
+    Memory *mem = mem_new();
+    u64 hash = build_hash(0, buf_from(&wasm_hash, sizeof(wasm_hash)));
+    for (u32 i = 0; i < build->css_count; ++i) hash = build_hash(hash, fs_read(mem, build->css_files[i]));
+    for (u32 i = 0; i < build->js_count; ++i) hash = build_hash(hash, fs_read(mem, build->js_files[i]));
+    for (u32 i = 0; i < build->html_count; ++i) hash = build_hash(hash, fs_read(mem, build->html_files[i]));
+    mem_free(mem);
+    return hash;
+}
+
 static void build_build(Build *build) {
     Build_Mode mode = build->release ? Mode_Release : Mode_Debug;
     Memory *mem = build->mem;
@@ -204,10 +302,51 @@ static void build_build(Build *build) {
     proc_shell(fstr(mem, "mkdir -p ", out_path));
     if (error) return;
 
-    if (build->windows) build_compile(Platform_Windows, mode, build->source_file, out_exe);
-    if (build->linux) build_compile(Platform_Linux, mode, build->source_file, out_elf);
-    if (build->wasm || build->html) build_compile(Platform_WASM, mode, build->source_file, out_wasm);
+    // Outputs are only rebuilt when the hash of their inputs changed
+    Build_Cache *cache = build_cache_load(mem, fstr(mem, out_path, "/build.cache"));
+    Build_Compile compiles[] = {
+        {build->windows, Platform_Windows, out_exe, "windows.log"},
+        {build->linux, Platform_Linux, out_elf, "linux.log"},
+        {build->wasm || build->html, Platform_WASM, out_wasm, "wasm.log"},
+    };
+
+    // Hash all inputs
+    for (u32 i = 0; i < array_count(compiles); ++i) {
+        Build_Compile *c = compiles + i;
+        if (!c->enabled) continue;
+        c->cmd = build_compile_command(c->platform, mode, build->source_file, c->output);
+        c->hash = build_hash_command(&c->cmd, build->source_file);
+    }
+
+    // The html embeds the wasm, which is removed afterwards when not requested
+    // So the wasm is only needed when the html is out of date
+    Build_Compile *wasm = compiles + 2;
+    u64 html_hash = build_hash_html(build, wasm->hash);
+    bool html_ok = !build->html || build_cache_check(cache, out_html, html_hash);
+    if (!build->wasm && html_ok) wasm->enabled = false;
+
+    // Compile all out of date platforms at the same time
+    Build_Batch batch = {};
+    for (u32 i = 0; i < array_count(compiles); ++i) {
+        Build_Compile *c = compiles + i;
+        if (!c->enabled) continue;
+        if (build_cache_check(cache, c->output, c->hash)) {
+            print("Up to date: ", c->output);
+            continue;
+        }
+        c->batch_index = build_batch_add(&batch, c->cmd, fstr(mem, out_path, "/", c->log)) + 1;
+    }
+    build_batch_run(&batch);
 
+    // Remember what succeeded, even if another platform failed
+    for (u32 i = 0; i < array_count(compiles); ++i) {
+        Build_Compile *c = compiles + i;
+        if (c->batch_index && batch.ok[c->batch_index - 1]) build_cache_set(cache, c->output, c->hash);
+    }
+    build_cache_save(cache);
+    if (error) return;
+
+    if (html_ok) return;
     if (build->html) {
         Fmt *f = fmt_new(mem);
         fmt_g(f, "<!DOCTYPE html>\n");
@@ -240,5 +379,9 @@ static void build_build(Build *build) {
         fmt_g(f, "</body>\n");
         fs_write(out_html, fmt_end(f));
         if (!build->wasm) fs_remove(out_wasm);
+        if (error) return;
+
+        build_cache_set(cache, out_html, html_hash);
+        build_cache_save(cache);
     }
 }
@@ -0,0 +1,172 @@
+// Copyright (c) 2026 - Tom Smeets <tom@tsmeets.nl>
+// build_cache.h - Skip compiling outputs whose inputs did not change
+#pragma once
+#include "command.h"
+#include "fmt.h"
+#include "fs.h"
+#include "list.h"
+#include "mem.h"
+#include "read.h"
+#include "str.h"
+
+// The manifest is a text file with one line per output
+//   <hash> <output path>
+// The hash covers the compile command and the contents of
+// every file reachable through '#include "..."'.
+
+typedef struct Build_Cache_Entry Build_Cache_Entry;
+struct Build_Cache_Entry {
+    char *output;
+    u64 hash;
+    Build_Cache_Entry *next;
+};
+
+typedef struct {
+    Memory *mem;
+    char *path;
+    Build_Cache_Entry *entries;
+} Build_Cache;
+
+// FNV-1a, fast and good enough to detect changes
+static u64 build_hash(u64 hash, Buffer data) {
+    if (hash == 0) hash = 0xcbf29ce484222325;
+    for (size_t i = 0; i < data.size; ++i) {
+        hash ^= data.data[i];
+        hash *= 0x100000001b3;
+    }
+    return hash;
+}
+
+// Hash a zero terminated string, including the terminator so "ab","c" != "a","bc"
+static u64 build_hash_str(u64 hash, char *str) {
+    return build_hash(hash, buf_from(str, str_len(str) + 1));
+}
+
+static Build_Cache_Entry *build_cache_find(Build_Cache *cache, char *output) {
+    for (Build_Cache_Entry *entry = cache->entries; entry; entry = entry->next) {
+        if (str_eq(entry->output, output)) return entry;
+    }
+    return 0;
+}
+
+// Load the manifest, a missing manifest is an empty cache
+static Build_Cache *build_cache_load(Memory *mem, char *path) {
+    Build_Cache *cache = mem_struct(mem, Build_Cache);
+    cache->mem = mem;
+    cache->path = path;
+    if (!fs_exists(path)) return cache;
+
+    Read read = read_from(fs_read(mem, path));
+    while (!read_eof(&read)) {
+        Buffer line = buf_trim(read_line(&read));
+
+        u64 hash = 0;
+        size_t i = 0;
+        for (; i < line.size && chr_is_hex(line.data[i]); ++i) hash = hash * 16 + chr_to_hex(line.data[i]);
+        if (i == 0 || i + 1 >= line.size) continue;
+
+        Build_Cache_Entry *entry = mem_struct(mem, Build_Cache_Entry);
+        Buffer output = buf_drop(line, i + 1);
+        entry->output = mem_clone(mem, output.data, output.size + 1);
+        entry->output[output.size] = 0;
+        entry->hash = hash;
+        LIST_PUSH(cache->entries, entry);
+    }
+    return cache;
+}
+
+static void build_cache_save(Build_Cache *cache) {
+    Memory *mem = mem_new();
+    Fmt *fmt = fmt_new(mem);
+    for (Build_Cache_Entry *entry = cache->entries; entry; entry = entry->next) {
+        fmt_g(fmt, F_Hex, entry->hash, " ", entry->output, "\n");
+    }
+    fs_write(cache->path, fmt_end(fmt));
+    mem_free(mem);
+}
+
+// Check if 'output' exists and was created from inputs with the same hash
+static bool build_cache_check(Build_Cache *cache, char *output, u64 hash) {
+    Build_Cache_Entry *entry = build_cache_find(cache, output);
+    return entry && entry->hash == hash && fs_exists(output);
+}
+
+// Remember the input hash of a successfully created output
+static void build_cache_set(Build_Cache *cache, char *output, u64 hash) {
+    Build_Cache_Entry *entry = build_cache_find(cache, output);
+    if (!entry) {
+        entry = mem_struct(cache->mem, Build_Cache_Entry);
+        entry->output = output;
+        LIST_PUSH(cache->entries, entry);
+    }
+    entry->hash = hash;
+}
+
+// Files already visited while walking the include graph
+typedef struct Build_Dep Build_Dep;
+struct Build_Dep {
+    char *path;
+    Build_Dep *next;
+};
+
+typedef struct {
+    Memory *mem;
+    Command *cmd;
+    Build_Dep *deps;
+    u64 hash;
+} Build_Dep_Scan;
+
+// Find an included file, first relative to the including file, then in the '-I' directories
+static char *build_dep_resolve(Build_Dep_Scan *scan, Buffer dir, Buffer name) {
+    char *path = fstr(scan->mem, dir, dir.size ? "/" : "", name);
+    if (fs_exists(path)) return path;
+
+    for (u32 i = 0; i + 1 < scan->cmd->argc; ++i) {
+        if (!str_eq(scan->cmd->argv[i], "-I")) continue;
+        path = fstr(scan->mem, scan->cmd->argv[i + 1], "/", name);
+        if (fs_exists(path)) return path;
+    }
+
+    // System headers, or not found. The compiler will report missing files.
+    return 0;
+}
+
+static void build_dep_scan(Build_Dep_Scan *scan, char *path) {
+    for (Build_Dep *dep = scan->deps; dep; dep = dep->next) {
+        if (str_eq(dep->path, path)) return;
+    }
+
+    Build_Dep *dep = mem_struct(scan->mem, Build_Dep);
+    dep->path = path;
+    LIST_PUSH(scan->deps, dep);
+
+    Memory *tmp = mem_new();
+    Buffer data = fs_read(tmp, path);
+    scan->hash = build_hash_str(scan->hash, path);
+    scan->hash = build_hash(scan->hash, data);
+
+    Buffer dir = path_split(str_buf(path)).parent;
+    Buffer include = str_buf("#include \"");
+    Read read = read_from(data);
+    while (!read_eof(&read)) {
+        Buffer line = buf_trim(read_line(&read));
+        if (!buf_starts_with(line, include)) continue;
+        line = buf_drop(line, include.size);
+
+        size_t len = 0;
+        while (len < line.size && line.data[len] != '"') len++;
+        char *dep_path = build_dep_resolve(scan, dir, buf_take(line, len));
+        if (dep_path) build_dep_scan(scan, dep_path);
+    }
+    mem_free(tmp);
+}
+
+// Hash a compile command together with all sources it depends on
+static u64 build_hash_command(Command *cmd, char *input) {
+    Memory *mem = mem_new();
+    Build_Dep_Scan scan = {mem, cmd};
+    for (u32 i = 0; i < cmd->argc; ++i) scan.hash = build_hash_str(scan.hash, cmd->argv[i]);
+    build_dep_scan(&scan, input);
+    mem_free(mem);
+    return scan.hash;
+}
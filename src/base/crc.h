@@ -34,7 +34,29 @@ static u32 crc_compute(Buffer buf) {
     return c ^ xor;
 }
 
+// Compute adler32 (for zlib)
+static u32 adler_compute(Buffer buf) {
+    u32 mod = 65521;
+    u32 a = 1;
+    u32 b = 0;
+
+    // The sums fit in 32 bits for at least 5552 bytes before they need to be reduced
+    for (size_t start = 0; start < buf.size; start += 5552) {
+        size_t end = MIN(start + 5552, buf.size);
+        for (size_t i = start; i < end; i++) {
+            a += buf.data[i];
+            b += a;
+        }
+        a %= mod;
+        b %= mod;
+    }
+    return b << 16 | a;
+}
+
 static void test_crc(void) {
     check(crc_compute(str_buf("Hello World!")) == 0x1c291ca3);
     check(crc_compute(str_buf("1234")) == 0x9be3e0a3);
+    check(adler_compute(str_buf("Wikipedia")) == 0x11e60398);
+    check(adler_compute(str_buf("1234")) == 0x01f800cb);
+    check(adler_compute(buf_null()) == 1);
 }
@@ -2,9 +2,12 @@
 // elf.h - Elf File parsing
 #pragma once
 #include "io.h"
+#include "job.h"
 #include "mem.h"
+#include "sort.h"
 #include "str.h"
 #include "type.h"
+#include "zlib.h"
 
 // API
 typedef struct {
@@ -12,13 +15,49 @@ typedef struct {
     u64 offset; // File address
     u64 addr;   // Virtual address
     u64 size;   // Size of section
+    u32 type;   // Section type, Elf_Section_Type
+    u32 link;   // Linked section, the string table for symbol tables
+    u64 flags;  // Section flags, Elf_Section_Flag
+
+    // Decompressed contents, see elf_section_data
+    Memory *mem;
+    Buffer data;
 } Elf_Section;
 
+typedef enum {
+    Elf_Section_Symtab = 2,
+    Elf_Section_Dynsym = 11,
+} Elf_Section_Type;
+
+typedef enum {
+    Elf_Section_Compressed = 0x800,
+} Elf_Section_Flag;
+
+typedef enum {
+    Elf_Symbol_Object = 1,
+    Elf_Symbol_Func = 2,
+} Elf_Symbol_Type;
+
+typedef struct {
+    char *name;
+    u64 addr;
+    u64 size;
+    u8 type; // Elf_Symbol_Type
+} Elf_Symbol;
+
 typedef struct {
     File *file;
+
+    // The whole file mapped in memory, empty if mapping is not supported
+    Buffer map;
+
     u64 entry;
     u32 section_count;
     Elf_Section *sections;
+
+    // Defined symbols from .symtab and .dynsym sorted by address, see elf_load_symbols
+    u32 symbol_count;
+    Elf_Symbol *symbols;
 } Elf;
 
 // Find section with name
@@ -62,6 +101,23 @@ typedef struct {
     u64 entsize;   // Entry size if section holds table
 } Elf64_Shdr;
 
+typedef struct {
+    u32 name;  // Symbol name (index into string table)
+    u8 info;   // Type and binding
+    u8 other;  // Visibility
+    u16 shndx; // Section index, zero if undefined
+    u64 value; // Symbol value
+    u64 size;  // Symbol size
+} Elf64_Sym;
+
+// Header of a section with the SHF_COMPRESSED flag
+typedef struct {
+    u32 type;      // Compression algorithm, 1 = zlib
+    u32 reserved;  // Padding
+    u64 size;      // Uncompressed size
+    u64 addralign; // Uncompressed alignment
+} Elf64_Chdr;
+
 static Elf *elf_load(Memory *mem, File *file) {
     Elf64_Ehdr header;
     io_read(file, buf_from_struct(&header));
@@ -78,7 +134,7 @@ static Elf *elf_load(Memory *mem, File *file) {
     elf->file = file;
     elf->entry = header.entry;
     elf->section_count = header.shnum;
-    elf->sections = mem_array(mem, Elf_Section, elf->section_count);
+    elf->sections = mem_array_zero(mem, Elf_Section, elf->section_count);
 
     // Read section headers
     io_seek(file, header.shoff);
@@ -96,7 +152,238 @@ static Elf *elf_load(Memory *mem, File *file) {
         elf->sections[i].offset = table[i].offset;
         elf->sections[i].addr = table[i].addr;
         elf->sections[i].size = table[i].size;
+        elf->sections[i].type = table[i].type;
+        elf->sections[i].link = table[i].link;
+        elf->sections[i].flags = table[i].flags;
     }
 
+    // Sections are read from the mapping when possible
+    elf->map = io_map(file);
     return elf;
 }
+
+// Unmap and close the file
+static void elf_close(Elf *elf) {
+    for (u32 i = 0; i < elf->section_count; ++i) {
+        if (elf->sections[i].mem) mem_free(elf->sections[i].mem);
+    }
+    io_unmap(elf->map);
+    io_close(elf->file);
+}
+
+// Legacy GNU compression, a '.zdebug_*' section starts with "ZLIB" and the big endian size
+static bool elf_section_is_zdebug(Elf_Section *sect) {
+    return buf_starts_with(str_buf(sect->name), str_buf(".zdebug_"));
+}
+
+// Get the section contents as stored in the file
+static Buffer elf_section_raw(Memory *mem, Elf *elf, Elf_Section *sect) {
+    if (elf->map.data) {
+        check_or(sect->offset + sect->size <= elf->map.size) return buf_null();
+        return buf_slice(elf->map, sect->offset, sect->size);
+    }
+
+    io_seek(elf->file, sect->offset);
+    u8 *data = io_read_alloc(elf->file, mem, sect->size);
+    if (error) return buf_null();
+    return (Buffer){data, sect->size};
+}
+
+// Inflate the stored contents of a compressed section, the section takes ownership of 'mem'
+// - Does not touch the file, so it can run in parallel for different sections
+static void elf_section_inflate(Elf_Section *sect, Memory *mem, Buffer raw) {
+    u64 size = 0;
+    if (elf_section_is_zdebug(sect)) {
+        check_or(raw.size >= 12 && buf_starts_with(raw, str_buf("ZLIB"))) raw = buf_null();
+        for (u32 i = 0; i < 8 && raw.size; ++i) size = size << 8 | raw.data[4 + i];
+        raw = buf_drop(raw, 12);
+    } else {
+        Elf64_Chdr header = {};
+        check_or(raw.size >= sizeof(header)) raw = buf_null();
+        if (raw.size) ptr_copy(&header, raw.data, sizeof(header));
+        if (raw.size && header.type != 1) error_set("Unsupported ELF section compression");
+        size = header.size;
+        raw = buf_drop(raw, sizeof(header));
+    }
+
+    Buffer data = error ? buf_null() : zlib_read(mem, raw);
+    check(data.size == size);
+    if (error) {
+        mem_free(mem);
+        return;
+    }
+
+    sect->mem = mem;
+    sect->data = data;
+}
+
+// Inflate a compressed section into its own memory
+static void elf_section_decompress(Elf *elf, Elf_Section *sect) {
+    Memory *mem = mem_new();
+    elf_section_inflate(sect, mem, elf_section_raw(mem, elf, sect));
+}
+
+// Get the contents of a section
+// - Mapped files return a view into the mapping, otherwise it is read into 'mem'
+// - Compressed sections are inflated once and owned by the section
+static Buffer elf_section_data(Memory *mem, Elf *elf, Elf_Section *sect) {
+    if (sect->data.data) return sect->data;
+
+    bool compressed = (sect->flags & Elf_Section_Compressed) || elf_section_is_zdebug(sect);
+    if (!compressed) return elf_section_raw(mem, elf, sect);
+
+    elf_section_decompress(elf, sect);
+    return sect->data;
+}
+
+// Get the contents of a section by name, missing sections are empty
+// - '.debug_*' sections are also found under the legacy '.zdebug_*' name
+static Buffer elf_read_section(Memory *mem, char *name, Elf *elf) {
+    Elf_Section *sect = elf_find_section(elf, name);
+    for (u32 i = 0; !sect && i < elf->section_count; i++) {
+        char *zname = elf->sections[i].name;
+        if (name[0] == '.' && zname[0] == '.' && zname[1] == 'z' && str_eq(zname + 2, name + 1)) sect = elf->sections + i;
+    }
+    if (!sect) return buf_null();
+    return elf_section_data(mem, elf, sect);
+}
+
+typedef struct {
+    Elf_Section *sect;
+    Memory *mem;
+    Buffer raw;
+    char *error;
+} Elf_Decompress_Job;
+
+static void elf_decompress_job(void *user) {
+    Elf_Decompress_Job *job = user;
+    elf_section_inflate(job->sect, job->mem, job->raw);
+    job->error = error_pop();
+}
+
+// Inflate all compressed sections in parallel
+// - Afterwards elf_section_data returns the cached result without any work
+// - The stored contents are read first, an unmapped file is shared and can't be read from multiple threads
+static void elf_decompress_sections(Elf *elf, Job_System *jobs) {
+    Memory *tmp = mem_new();
+    Elf_Decompress_Job *job_list = mem_array_zero(tmp, Elf_Decompress_Job, elf->section_count);
+    u32 counter = 0;
+    for (u32 i = 0; i < elf->section_count; ++i) {
+        Elf_Section *sect = elf->sections + i;
+        bool compressed = (sect->flags & Elf_Section_Compressed) || elf_section_is_zdebug(sect);
+        if (!compressed || sect->data.data) continue;
+
+        Elf_Decompress_Job *job = job_list + i;
+        job->sect = sect;
+        job->mem = mem_new();
+        job->raw = elf_section_raw(job->mem, elf, sect);
+        if (error) {
+            job->error = error_pop();
+            mem_free(job->mem);
+            continue;
+        }
+        job_push(jobs, &counter, elf_decompress_job, job);
+    }
+    job_wait(jobs, &counter);
+
+    for (u32 i = 0; i < elf->section_count; ++i) {
+        if (job_list[i].error) error_set(job_list[i].error);
+    }
+    mem_free(tmp);
+}
+
+// Get the GNU build id, a unique hash of the linked file, or empty if not present
+static Buffer elf_build_id(Memory *mem, Elf *elf) {
+    Buffer note = elf_read_section(mem, ".note.gnu.build-id", elf);
+
+    // Note header: name size, description size, type, then the padded name "GNU"
+    if (note.size < 16) return buf_null();
+    u32 name_size = *(u32 *)(note.data + 0);
+    u32 desc_size = *(u32 *)(note.data + 4);
+    u64 desc_offset = 12 + ((name_size + 3) & ~3u);
+    check_or(desc_offset + desc_size <= note.size) return buf_null();
+    return buf_slice(note, desc_offset, desc_size);
+}
+
+static i32 elf_symbol_cmp(void *a, void *b) {
+    Elf_Symbol *sym_a = a;
+    Elf_Symbol *sym_b = b;
+    if (sym_a->addr != sym_b->addr) return sym_a->addr < sym_b->addr ? -1 : 1;
+    return 0;
+}
+
+// Append the defined functions and objects of one symbol table
+static void elf_read_symbols(Memory *mem, Elf *elf, Elf_Section *sect, u32 *cap) {
+    check_or(sect->link < elf->section_count) return;
+    Elf_Section *strtab = elf->sections + sect->link;
+
+    Memory *tmp = mem_new();
+    Elf64_Sym *table = (Elf64_Sym *)elf_section_data(tmp, elf, sect).data;
+    char *str = (char *)elf_section_data(mem, elf, strtab).data;
+    if (error || !table || !str) {
+        mem_free(tmp);
+        return;
+    }
+
+    u64 count = sect->size / sizeof(Elf64_Sym);
+    for (u64 i = 0; i < count; ++i) {
+        Elf64_Sym *sym = table + i;
+        u8 type = sym->info & 0xf;
+        if (sym->shndx == 0 || sym->value == 0) continue;
+        if (type != Elf_Symbol_Func && type != Elf_Symbol_Object) continue;
+        if (sym->name >= strtab->size) continue;
+
+        if (elf->symbol_count == *cap) {
+            u32 new_cap = *cap ? *cap * 2 : 256;
+            size_t old_size = *cap * sizeof(Elf_Symbol);
+            elf->symbols = (Elf_Symbol *)mem_realloc(mem, (u8 *)elf->symbols, old_size, new_cap * sizeof(Elf_Symbol));
+            *cap = new_cap;
+        }
+        elf->symbols[elf->symbol_count++] = (Elf_Symbol){str + sym->name, sym->value, sym->size, type};
+    }
+    mem_free(tmp);
+}
+
+// Read .symtab and .dynsym, symbols that are in both are only kept once
+static void elf_load_symbols(Memory *mem, Elf *elf) {
+    if (elf->symbols) return;
+
+    u32 cap = 0;
+    for (u32 i = 0; i < elf->section_count; ++i) {
+        Elf_Section *sect = elf->sections + i;
+        if (sect->type == Elf_Section_Symtab || sect->type == Elf_Section_Dynsym) elf_read_symbols(mem, elf, sect, &cap);
+    }
+    sort_array(elf->symbols, elf->symbol_count, sizeof(Elf_Symbol), elf_symbol_cmp);
+
+    // Remove duplicates
+    u32 count = 0;
+    for (u32 i = 0; i < elf->symbol_count; ++i) {
+        Elf_Symbol *sym = elf->symbols + i;
+        Elf_Symbol *last = count ? elf->symbols + count - 1 : 0;
+        if (last && last->addr == sym->addr && str_eq(last->name, sym->name)) continue;
+        elf->symbols[count++] = *sym;
+    }
+    elf->symbol_count = count;
+}
+
+// Find the symbol containing an address, or null
+static Elf_Symbol *elf_find_symbol(Elf *elf, u64 addr) {
+    // Find the first symbol after 'addr'
+    u32 low = 0;
+    u32 high = elf->symbol_count;
+    while (low < high) {
+        u32 mid = low + (high - low) / 2;
+        if (elf->symbols[mid].addr <= addr) low = mid + 1;
+        else high = mid;
+    }
+
+    // Symbols can overlap, so check a few before it
+    for (u32 i = low; i > 0 && low - i < 8; --i) {
+        Elf_Symbol *sym = elf->symbols + i - 1;
+        if (addr < sym->addr + sym->size) return sym;
+    }
+
+    // Hand written assembly often has no size, assume it runs until the next symbol
+    if (low > 0 && elf->symbols[low - 1].size == 0) return elf->symbols + low - 1;
+    return 0;
+}
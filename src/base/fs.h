@@ -61,9 +61,6 @@ static Path_Components path_split(Buffer path) {
 
 #if OS_LINUX
 #define NAME_MAX 255
-static long sys_open(const char *filename, int flags, umode_t mode) {
-    return linux_syscall3(2, (i64)filename, flags, mode);
-}
 #endif
 
 // Open a file for reading or writing
@@ -134,6 +131,17 @@ static FileInfo fs_stat(char *path) {
     return info;
 }
 
+// Check if a file or directory exists, without setting an error
+static bool fs_exists(char *path) {
+    IF_LINUX({
+        struct linux_stat sb = {};
+        return linux_lstat(path, &sb) == 0;
+    })
+
+    IF_WINDOWS({ return GetFileAttributesA(path) != INVALID_FILE_ATTRIBUTES; })
+    IF_WASM({ return false; })
+}
+
 // Get current working directory
 static char *fs_cwd(Memory *mem) {
     char buf[PATH_MAX];
@@ -1,13 +1,37 @@
+// Copyright (c) 2026 - Tom Smeets <tom@tsmeets.nl>
+// fs_watch.h - Watch directories for changed source files
 #pragma once
 #include "error.h"
+#include "fmt.h"
 #include "fs.h"
 #include "io.h"
+#include "list.h"
+#include "mem.h"
 #include "os_headers.h"
+#include "time.h"
+
+// Usage:
+//   Watch *watch = fs_watch_new(mem);
+//   fs_watch_add(watch, "src");
+//   for (;;) {
+//       if (fs_watch_check(watch)) rebuild(watch->change_count, watch->changes);
+//   }
+//
+// Directories are watched recursively, new subdirectories are added automatically.
+// Only '*.c' and '*.h' files in watched directories are reported. A file that is
+// watched directly is always reported. Its parent directory is watched instead of
+// the file itself, so it is still seen after an editor replaces it with a rename.
+// Editors often write a file several times per save, so changes are collected
+// until nothing happened for 'debounce' time.
 
 #if OS_LINUX
-#define IN_MODIFY 0x00000002
+#define IN_CLOSE_WRITE 0x00000008
+#define IN_MOVED_FROM 0x00000040
+#define IN_MOVED_TO 0x00000080
 #define IN_CREATE 0x00000100
 #define IN_DELETE 0x00000200
+#define IN_Q_OVERFLOW 0x00004000
+#define IN_ISDIR 0x40000000
 
 struct inotify_event {
     i32 wd;
@@ -26,57 +50,195 @@ static long linux_inotify_add_watch(int fd, const char *path, u32 mask) {
 }
 #endif
 
-typedef struct Watch Watch;
+typedef struct Watch_Dir Watch_Dir;
+struct Watch_Dir {
+    i32 wd;
+    char *path;
+
+    // Only report this name, 'path' is then the watched file instead of the directory
+    char *file;
+    Watch_Dir *next;
+};
 
-// Create a new file watches
-static Watch *fs_watch_new(void) {
-    Watch *ret = 0;
+typedef struct {
+    Memory *mem;
+    File *fd;
+    Watch_Dir *dirs;
+
+    // Wait until no events arrived for this long
+    time_t debounce;
+
+    // Changes that are still settling
+    Memory *pending_mem;
+    u32 pending_count;
+    u32 pending_cap;
+    char **pending;
+    time_t last_event;
+
+    // Changed files reported by the last successful fs_watch_check
+    Memory *change_mem;
+    u32 change_count;
+    char **changes;
+} Watch;
+
+// Create a new file watcher
+// - Returns null if the watcher could not be created
+static Watch *fs_watch_new(Memory *mem) {
+    Watch *watch = mem_struct(mem, Watch);
+    watch->mem = mem;
+    watch->debounce = 50 * TIME_MS;
+    watch->pending_mem = mem_new();
+    watch->change_mem = mem_new();
 
     IF_LINUX({
         i32 fd = linux_inotify_init1(O_NONBLOCK);
-        check_or(fd >= 0) return 0;
-        ret = fd_to_handle(fd);
+        check_or(fd >= 0) {
+            mem_free(watch->pending_mem);
+            mem_free(watch->change_mem);
+            return 0;
+        }
+        watch->fd = fd_to_handle(fd);
     })
+    return watch;
+}
 
-    return ret;
+// Only source files trigger a rebuild
+static bool fs_watch_match(char *name) {
+    Buffer buf = str_buf(name);
+    return buf_ends_with(buf, str_buf(".c")) || buf_ends_with(buf, str_buf(".h"));
 }
 
-// Start watching a file or directory for changes
-static void os_watch_add(Watch *watch, char *path) {
-    IF_LINUX({
-        i32 fd = fd_from_handle(watch);
-        i32 wd = linux_inotify_add_watch(fd, path, IN_MODIFY | IN_CREATE | IN_DELETE);
-        check(wd >= 0);
-    })
+static void fs_watch_add(Watch *watch, char *path);
+
+typedef struct {
+    Watch *watch;
+    char *path;
+} Watch_Add;
+
+static void fs_watch_add_child(void *user, char *name, FileType type) {
+    Watch_Add *add = user;
+    if (type != FileType_Directory) return;
+    fs_watch_add(add->watch, fstr(add->watch->mem, add->path, "/", name));
 }
 
-// Return true if a watched file was changed
-static bool os_watch_check(Watch *watch) {
+// Start watching a file, or a directory and all its subdirectories
+static void fs_watch_add(Watch *watch, char *path) {
     IF_LINUX({
-        i32 fd = fd_from_handle(watch);
+        // Watch the directory containing a file
+        char *dir_path = path;
+        char *file = 0;
+        bool is_dir = fs_stat(path).type == FileType_Directory;
+        if (!is_dir) {
+            Path_Components parts = path_split(str_buf(path));
+            bool has_parent = parts.file.data != 0;
+            dir_path = !has_parent ? "." : parts.parent.size ? fstr(watch->mem, parts.parent) : "/";
+            file = has_parent ? fstr(watch->mem, parts.file) : path;
+        }
 
-        // Reserve enough space for a single event
-        char buffer[sizeof(struct inotify_event) + NAME_MAX + 1];
+        i32 fd = fd_from_handle(watch->fd);
+        u32 mask = IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_CREATE | IN_DELETE;
+        i32 wd = linux_inotify_add_watch(fd, dir_path, mask);
+        check_or(wd >= 0) return;
 
-        bool status = 0;
-        while (1) {
-            i64 ret = sys_read(fd, buffer, sizeof(buffer));
+        // Adding a path twice returns the same descriptor
+        for (Watch_Dir *dir = watch->dirs; dir; dir = dir->next) {
+            if (dir->wd == wd && (file ? dir->file && str_eq(dir->file, file) : !dir->file)) return;
+        }
 
-            // No more data
-            if (ret == -EAGAIN) return status;
+        Watch_Dir *dir = mem_struct(watch->mem, Watch_Dir);
+        dir->wd = wd;
+        dir->path = path;
+        dir->file = file;
+        LIST_PUSH(watch->dirs, dir);
+
+        if (!is_dir) return;
+        Watch_Add add = {.watch = watch};
+        add.path = path;
+        fs_list(path, fs_watch_add_child, &add);
+    })
+}
 
-            // Some other error, should not happen
-            assert(ret >= 0);
+// Remember a changed path, each path is reported once
+static void fs_watch_push(Watch *watch, char *path) {
+    for (u32 i = 0; i < watch->pending_count; ++i) {
+        if (str_eq(watch->pending[i], path)) return;
+    }
+
+    if (watch->pending_count == watch->pending_cap) {
+        u32 new_cap = watch->pending_cap ? watch->pending_cap * 2 : 16;
+        size_t old_size = watch->pending_cap * sizeof(char *);
+        watch->pending = (char **)mem_realloc(watch->pending_mem, (u8 *)watch->pending, old_size, new_cap * sizeof(char *));
+        watch->pending_cap = new_cap;
+    }
+    watch->pending[watch->pending_count++] = fstr(watch->pending_mem, path);
+}
 
-            // Something changed!
-            struct inotify_event *event = (struct inotify_event *)buffer;
+// Read all queued events at once
+static void fs_watch_read(Watch *watch) {
+    IF_LINUX({
+        i32 fd = fd_from_handle(watch->fd);
 
-            // Don't care about the event details
-            (void)event;
+        // Room for many events, names are at most NAME_MAX bytes
+        _Alignas(struct inotify_event) char buffer[64 * 1024];
+        for (;;) {
+            i64 len = sys_read(fd, buffer, sizeof(buffer));
 
-            // Keep reading, to clear the buffer
-            status = 1;
+            // No more data
+            if (len == -EAGAIN) return;
+            check_or(len > 0) return;
+            watch->last_event = time_now();
+
+            for (i64 offset = 0; offset < len;) {
+                struct inotify_event *event = (struct inotify_event *)(buffer + offset);
+                offset += sizeof(struct inotify_event) + event->len;
+
+                // Events were lost, report every watched directory
+                if (event->mask & IN_Q_OVERFLOW) {
+                    for (Watch_Dir *dir = watch->dirs; dir; dir = dir->next) fs_watch_push(watch, dir->path);
+                    continue;
+                }
+
+                // A directory can be watched both by itself and for files inside it
+                if (!event->len) continue;
+                for (Watch_Dir *dir = watch->dirs; dir; dir = dir->next) {
+                    if (dir->wd != event->wd) continue;
+
+                    if (dir->file) {
+                        if (str_eq(dir->file, event->name)) fs_watch_push(watch, dir->path);
+                        continue;
+                    }
+
+                    Memory *tmp = mem_new();
+                    char *path = fstr(tmp, dir->path, "/", event->name);
+                    if (event->mask & IN_ISDIR) {
+                        // Watch new directories, files created inside before the watch was added are missed
+                        if (event->mask & (IN_CREATE | IN_MOVED_TO)) fs_watch_add(watch, fstr(watch->mem, path));
+                    } else if (fs_watch_match(path)) {
+                        fs_watch_push(watch, path);
+                    }
+                    mem_free(tmp);
+                }
+            }
         }
     })
-    return false;
+}
+
+// Return true if source files were changed and no new events arrived for 'debounce' time
+// - The changed paths are in 'changes' until the next call
+static bool fs_watch_check(Watch *watch) {
+    fs_watch_read(watch);
+    if (watch->pending_count == 0) return false;
+    if (time_now() - watch->last_event < watch->debounce) return false;
+
+    // Hand over the pending list and start a new one
+    mem_free(watch->change_mem);
+    watch->change_mem = watch->pending_mem;
+    watch->change_count = watch->pending_count;
+    watch->changes = watch->pending;
+
+    watch->pending_mem = mem_new();
+    watch->pending_count = 0;
+    watch->pending_cap = 0;
+    watch->pending = 0;
+    return true;
 }
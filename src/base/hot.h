@@ -1,17 +1,52 @@
 // Copyright (c) 2026 - Tom Smeets <tom@tsmeets.nl>
 // hot.h - Hot-Reload compiled C programs
 #pragma once
+#include "dl.h"
+#include "dwarf.h"
 #include "elf.h"
 #include "fmt.h"
+#include "fs.h"
 #include "mem.h"
-#include "os2.h"
+#include "sort.h"
 #include "time.h"
 
+// Usage:
+//   Hot *hot = hot_new(mem);
+//   void (*update)(void) = hot_load(hot, "out/app.so", "app_update");
+//
+// Each reload copies the global variables of the old library into the new one.
+// With debug info the variables are matched by name and structs field by field,
+// so members can be added, removed or reordered. New members keep their initial
+// value. Without debug info, or when no variable location could be decoded,
+// .data and .bss are copied byte for byte.
+
+// Copy 'size' bytes from the old library to the new library
+typedef struct {
+    u64 dst; // Offset from the new library base
+    u64 src; // Offset from the old library base
+    u64 size;
+} Hot_Copy;
+
+typedef struct {
+    Memory *mem;
+    Dwarf_File *old;
+    Dwarf_File *new;
+
+    // Adjacent copies are merged
+    u32 count;
+    u32 cap;
+    Hot_Copy *copies;
+} Hot_Plan;
+
 typedef struct {
     Memory *mem;
     Library *lib;
-    Elf *elf;
     void *symbol;
+
+    // Debug info of the current library, freed on the next reload
+    Memory *lib_mem;
+    Elf *elf;
+    Dwarf_File *dwarf;
 } Hot;
 
 static Hot *hot_new(Memory *mem) {
@@ -20,52 +55,479 @@ static Hot *hot_new(Memory *mem) {
     return hot;
 }
 
+static void hot_plan_copy(Hot_Plan *plan, u64 dst, u64 src, u64 size) {
+    if (size == 0) return;
+    Hot_Copy *last = plan->count ? plan->copies + plan->count - 1 : 0;
+    if (last && last->dst + last->size == dst && last->src + last->size == src) {
+        last->size += size;
+        return;
+    }
+    *DWARF_PUSH(plan->mem, plan->copies, plan->count, plan->cap) = (Hot_Copy){dst, src, size};
+}
+
+// Get a constant attribute, references and expressions are not constant
+static bool hot_attr_const(Dwarf_File *dwarf, Dwarf_Die *die, Dwarf_Attribute_Type name, u64 *value) {
+    Dwarf_Attr *attr = dwarf_attr(dwarf, die, name);
+    if (!attr) return false;
+    Dwarf_Form form = attr->form;
+    bool is_const = form == DW_FORM_data1 || form == DW_FORM_data2 || form == DW_FORM_data4 || form == DW_FORM_data8 ||
+                    form == DW_FORM_sdata || form == DW_FORM_udata || form == DW_FORM_implicit_const;
+    if (!is_const) return false;
+    *value = attr->value;
+    return true;
+}
+
+// Skip typedefs and qualifiers, they don't change the layout
+static Dwarf_Die *hot_type(Dwarf_File *dwarf, Dwarf_Die *type) {
+    while (type) {
+        Dwarf_Tag tag = type->tag;
+        bool alias = tag == DW_TAG_typedef || tag == DW_TAG_const_type || tag == DW_TAG_volatile_type ||
+                     tag == DW_TAG_restrict_type || tag == DW_TAG_atomic_type;
+        if (!alias) break;
+        type = dwarf_attr_ref(dwarf, type, DW_AT_type);
+    }
+    return type;
+}
+
+// Number of elements in one dimension of an array, zero if unknown
+static u64 hot_subrange_count(Dwarf_File *dwarf, Dwarf_Die *subrange) {
+    u64 value = 0;
+    if (hot_attr_const(dwarf, subrange, DW_AT_count, &value)) return value;
+    if (hot_attr_const(dwarf, subrange, DW_AT_upper_bound, &value)) return value + 1;
+    return 0;
+}
+
+static Dwarf_Die *hot_next_subrange(Dwarf_File *dwarf, Dwarf_Die *die) {
+    while (die && die->tag != DW_TAG_subrange_type) die = dwarf_die_sibling(dwarf, die);
+    return die;
+}
+
+// Size of a type, or of the remaining dimensions of an array starting at 'subrange'
+static u64 hot_type_size(Dwarf_File *dwarf, Dwarf_Die *type, Dwarf_Die *subrange) {
+    type = hot_type(dwarf, type);
+    if (!type) return 0;
+
+    if (type->tag == DW_TAG_array_type) {
+        if (!subrange) subrange = hot_next_subrange(dwarf, dwarf_die_child(dwarf, type));
+        if (!subrange) return 0;
+        Dwarf_Die *next = hot_next_subrange(dwarf, dwarf_die_sibling(dwarf, subrange));
+        u64 inner = next ? hot_type_size(dwarf, type, next) : hot_type_size(dwarf, dwarf_attr_ref(dwarf, type, DW_AT_type), 0);
+        return hot_subrange_count(dwarf, subrange) * inner;
+    }
+
+    u64 size = dwarf_attr_u64(dwarf, type, DW_AT_byte_size);
+    if (!size && type->tag == DW_TAG_pointer_type) size = dwarf->units[type->unit].addr_size;
+    return size;
+}
+
+// Find a struct member by name
+static Dwarf_Die *hot_member(Dwarf_File *dwarf, Dwarf_Die *type, char *name) {
+    for (Dwarf_Die *member = dwarf_die_child(dwarf, type); member; member = dwarf_die_sibling(dwarf, member)) {
+        if (member->tag != DW_TAG_member) continue;
+        char *member_name = dwarf_attr_str(dwarf, member, DW_AT_name);
+        if (member_name && str_eq(member_name, name)) return member;
+    }
+    return 0;
+}
+
+static bool hot_layout_eq(Hot_Plan *plan, Dwarf_Die *old_type, Dwarf_Die *new_type, Dwarf_Die *old_sub, Dwarf_Die *new_sub);
+
+// Check if two struct members have the same name, position and layout
+static bool hot_member_eq(Hot_Plan *plan, Dwarf_Die *old_member, Dwarf_Die *new_member) {
+    char *old_name = dwarf_attr_str(plan->old, old_member, DW_AT_name);
+    char *new_name = dwarf_attr_str(plan->new, new_member, DW_AT_name);
+    if (!old_name != !new_name || (old_name && !str_eq(old_name, new_name))) return false;
+
+    Dwarf_Attribute_Type attr_list[] = {DW_AT_data_member_location, DW_AT_bit_size, DW_AT_data_bit_offset};
+    for (u32 i = 0; i < array_count(attr_list); ++i) {
+        u64 old_value = 0, new_value = 0;
+        bool old_has = hot_attr_const(plan->old, old_member, attr_list[i], &old_value);
+        bool new_has = hot_attr_const(plan->new, new_member, attr_list[i], &new_value);
+        if (old_has != new_has || old_value != new_value) return false;
+    }
+
+    Dwarf_Die *old_type = dwarf_attr_ref(plan->old, old_member, DW_AT_type);
+    Dwarf_Die *new_type = dwarf_attr_ref(plan->new, new_member, DW_AT_type);
+    return hot_layout_eq(plan, old_type, new_type, 0, 0);
+}
+
+// Check if two types have an identical memory layout, so they can be copied as a whole
+static bool hot_layout_eq(Hot_Plan *plan, Dwarf_Die *old_type, Dwarf_Die *new_type, Dwarf_Die *old_sub, Dwarf_Die *new_sub) {
+    old_type = hot_type(plan->old, old_type);
+    new_type = hot_type(plan->new, new_type);
+    if (!old_type || !new_type || old_type->tag != new_type->tag) return false;
+
+    u64 size = hot_type_size(plan->old, old_type, old_sub);
+    if (size == 0 || size != hot_type_size(plan->new, new_type, new_sub)) return false;
+
+    Dwarf_Tag tag = new_type->tag;
+    if (tag == DW_TAG_base_type) {
+        return dwarf_attr_u64(plan->old, old_type, DW_AT_encoding) == dwarf_attr_u64(plan->new, new_type, DW_AT_encoding);
+    }
+
+    if (tag == DW_TAG_structure_type || tag == DW_TAG_class_type) {
+        Dwarf_Die *old_member = dwarf_die_child(plan->old, old_type);
+        Dwarf_Die *new_member = dwarf_die_child(plan->new, new_type);
+        for (;;) {
+            while (old_member && old_member->tag != DW_TAG_member) old_member = dwarf_die_sibling(plan->old, old_member);
+            while (new_member && new_member->tag != DW_TAG_member) new_member = dwarf_die_sibling(plan->new, new_member);
+            if (!old_member || !new_member) return old_member == new_member;
+            if (!hot_member_eq(plan, old_member, new_member)) return false;
+            old_member = dwarf_die_sibling(plan->old, old_member);
+            new_member = dwarf_die_sibling(plan->new, new_member);
+        }
+    }
+
+    if (tag == DW_TAG_array_type) {
+        if (!old_sub) old_sub = hot_next_subrange(plan->old, dwarf_die_child(plan->old, old_type));
+        if (!new_sub) new_sub = hot_next_subrange(plan->new, dwarf_die_child(plan->new, new_type));
+        while (old_sub || new_sub) {
+            if (!old_sub || !new_sub) return false;
+            if (hot_subrange_count(plan->old, old_sub) != hot_subrange_count(plan->new, new_sub)) return false;
+            old_sub = hot_next_subrange(plan->old, dwarf_die_sibling(plan->old, old_sub));
+            new_sub = hot_next_subrange(plan->new, dwarf_die_sibling(plan->new, new_sub));
+        }
+
+        Dwarf_Die *old_elem = dwarf_attr_ref(plan->old, old_type, DW_AT_type);
+        Dwarf_Die *new_elem = dwarf_attr_ref(plan->new, new_type, DW_AT_type);
+        return hot_layout_eq(plan, old_elem, new_elem, 0, 0);
+    }
+
+    // Pointers, enums and unions are plain bytes of the same size
+    return true;
+}
+
+// Add the copies needed to move a value of 'old_type' at 'src' to a value of 'new_type' at 'dst'
+// - Struct members are matched by name, new members are not copied
+// - Arrays copy the elements both versions have
+// - Scalars are only copied when size and encoding match
+static void hot_plan_type(Hot_Plan *plan, Dwarf_Die *old_type, Dwarf_Die *new_type, Dwarf_Die *old_sub, Dwarf_Die *new_sub, u64 dst, u64 src) {
+    old_type = hot_type(plan->old, old_type);
+    new_type = hot_type(plan->new, new_type);
+    if (!old_type || !new_type || old_type->tag != new_type->tag) return;
+
+    // Unchanged types are copied at once
+    if (hot_layout_eq(plan, old_type, new_type, old_sub, new_sub)) {
+        hot_plan_copy(plan, dst, src, hot_type_size(plan->new, new_type, new_sub));
+        return;
+    }
+
+    Dwarf_Tag tag = new_type->tag;
+    if (tag == DW_TAG_structure_type || tag == DW_TAG_class_type) {
+        for (Dwarf_Die *new_member = dwarf_die_child(plan->new, new_type); new_member; new_member = dwarf_die_sibling(plan->new, new_member)) {
+            if (new_member->tag != DW_TAG_member) continue;
+            char *name = dwarf_attr_str(plan->new, new_member, DW_AT_name);
+            Dwarf_Die *old_member = name ? hot_member(plan->old, old_type, name) : 0;
+            if (!old_member) continue;
+
+            // Bit fields share bytes with their neighbours, only copy them when nothing moved
+            bool bits = dwarf_attr(plan->old, old_member, DW_AT_bit_size) || dwarf_attr(plan->new, new_member, DW_AT_bit_size);
+            if (bits) continue;
+
+            u64 old_offset = 0, new_offset = 0;
+            if (!hot_attr_const(plan->old, old_member, DW_AT_data_member_location, &old_offset)) continue;
+            if (!hot_attr_const(plan->new, new_member, DW_AT_data_member_location, &new_offset)) continue;
+
+            Dwarf_Die *old_member_type = dwarf_attr_ref(plan->old, old_member, DW_AT_type);
+            Dwarf_Die *new_member_type = dwarf_attr_ref(plan->new, new_member, DW_AT_type);
+            hot_plan_type(plan, old_member_type, new_member_type, 0, 0, dst + new_offset, src + old_offset);
+        }
+    }
+
+    if (tag == DW_TAG_array_type) {
+        if (!old_sub) old_sub = hot_next_subrange(plan->old, dwarf_die_child(plan->old, old_type));
+        if (!new_sub) new_sub = hot_next_subrange(plan->new, dwarf_die_child(plan->new, new_type));
+        if (!old_sub || !new_sub) return;
+
+        // Multi dimensional arrays have one subrange per dimension
+        Dwarf_Die *old_next = hot_next_subrange(plan->old, dwarf_die_sibling(plan->old, old_sub));
+        Dwarf_Die *new_next = hot_next_subrange(plan->new, dwarf_die_sibling(plan->new, new_sub));
+        if (!old_next != !new_next) return;
+
+        Dwarf_Die *old_elem = old_next ? old_type : dwarf_attr_ref(plan->old, old_type, DW_AT_type);
+        Dwarf_Die *new_elem = new_next ? new_type : dwarf_attr_ref(plan->new, new_type, DW_AT_type);
+        u64 old_stride = hot_type_size(plan->old, old_elem, old_next);
+        u64 new_stride = hot_type_size(plan->new, new_elem, new_next);
+        u64 count = MIN(hot_subrange_count(plan->old, old_sub), hot_subrange_count(plan->new, new_sub));
+        if (!old_stride || !new_stride) return;
+
+        for (u64 i = 0; i < count; ++i) {
+            hot_plan_type(plan, old_elem, new_elem, old_next, new_next, dst + i * new_stride, src + i * old_stride);
+        }
+    }
+}
+
+// A global variable with a fixed address
+typedef struct {
+    // "<unit>:<function>:<name>", the unit is empty for external variables
+    // and the function is empty for file scope variables
+    char *key;
+    u64 addr;
+    Dwarf_Die *type;
+} Hot_Var;
+
+static i32 hot_var_cmp(void *a, void *b) {
+    return str_compare(((Hot_Var *)a)->key, ((Hot_Var *)b)->key);
+}
+
+// Check if a variable is in .data or .bss, other sections can be read-only after relocation
+static bool hot_var_writable(Elf *elf, u64 addr, u64 size) {
+    char *sections[] = {".data", ".bss"};
+    for (u32 i = 0; i < array_count(sections); ++i) {
+        Elf_Section *sect = elf_find_section(elf, sections[i]);
+        if (sect && addr >= sect->addr && addr + size <= sect->addr + sect->size) return true;
+    }
+    return false;
+}
+
+// Address of a variable with a fixed location
+// - Only a single 'DW_OP_addr' or 'DW_OP_addrx' is accepted, thread locals and locals have a different location
+static bool hot_var_addr(Dwarf_File *dwarf, Dwarf_Unit *unit, Dwarf_Attr *location, u64 *addr) {
+    if (!location || location->form != DW_FORM_exprloc || !location->value) return false;
+
+    Parse expr = {.data = (u8 *)location->value, .size = location->size};
+    u8 op = parse_u8(&expr);
+    if (op == DW_OP_addr) {
+        *addr = dwarf_parse_addr(&expr, unit);
+    } else if (op == DW_OP_addrx || op == DW_OP_GNU_addr_index) {
+        *addr = dwarf_addr_index(dwarf, unit, parse_uleb128(&expr));
+    } else {
+        return false;
+    }
+    return !expr.overrun && parse_eof(&expr);
+}
+
+// Collect all writable variables with a fixed address, sorted by key
+static u32 hot_vars(Memory *mem, Dwarf_File *dwarf, Hot_Var **result) {
+    u32 count = 0;
+    u32 cap = 0;
+    Hot_Var *vars = 0;
+    for (u32 i = 1; i < dwarf->die_count; ++i) {
+        Dwarf_Die *die = dwarf->dies + i;
+        if (die->tag != DW_TAG_variable) continue;
+
+        Dwarf_Unit *unit = dwarf->units + die->unit;
+        u64 addr = 0;
+        if (!hot_var_addr(dwarf, unit, dwarf_attr(dwarf, die, DW_AT_location), &addr)) continue;
+
+        char *name = dwarf_attr_str(dwarf, die, DW_AT_name);
+        Dwarf_Die *type = dwarf_attr_ref(dwarf, die, DW_AT_type);
+        if (!name || !type) continue;
+
+        if (!hot_var_writable(dwarf->elf, addr, hot_type_size(dwarf, type, 0))) continue;
+
+        // Names of static variables are only unique within a unit
+        bool external = dwarf_attr(dwarf, die, DW_AT_external);
+        char *unit_name = external ? 0 : dwarf_attr_str(dwarf, dwarf->dies + unit->die_start, DW_AT_name);
+        Dwarf_Die *parent = dwarf_die_parent(dwarf, die);
+        char *scope = parent && parent->tag == DW_TAG_subprogram ? dwarf_die_name(dwarf, parent) : 0;
+
+        Hot_Var *var = DWARF_PUSH(mem, vars, count, cap);
+        var->key = fstr(mem, unit_name ?: "", ":", scope ?: "", ":", name);
+        var->addr = addr;
+        var->type = type;
+    }
+
+    sort_array(vars, count, sizeof(Hot_Var), hot_var_cmp);
+    *result = vars;
+    return count;
+}
+
+// Match the variables of both libraries and compute what to copy
+// - Returns null when either library has no variables with a known location
+static Hot_Plan *hot_plan(Memory *mem, Dwarf_File *old, Dwarf_File *new) {
+    Memory *tmp = mem_new();
+    Hot_Var *old_vars = 0;
+    Hot_Var *new_vars = 0;
+    u32 old_count = hot_vars(tmp, old, &old_vars);
+    u32 new_count = hot_vars(tmp, new, &new_vars);
+    if (!old_count || !new_count) {
+        mem_free(tmp);
+        return 0;
+    }
+
+    Hot_Plan *plan = mem_struct(mem, Hot_Plan);
+    plan->mem = mem;
+    plan->old = old;
+    plan->new = new;
+
+    // Both lists are sorted, so walk them together
+    u32 old_index = 0;
+    for (u32 i = 0; i < new_count; ++i) {
+        Hot_Var *new_var = new_vars + i;
+        while (old_index < old_count && str_compare(old_vars[old_index].key, new_var->key) < 0) old_index++;
+        if (old_index == old_count) break;
+
+        Hot_Var *old_var = old_vars + old_index;
+        if (!str_eq(old_var->key, new_var->key)) continue;
+        hot_plan_type(plan, old_var->type, new_var->type, 0, 0, new_var->addr, old_var->addr);
+    }
+
+    mem_free(tmp);
+    return plan;
+}
+
+// Copy .data and .bss byte for byte, used without debug info
+static Hot_Plan *hot_plan_raw(Memory *mem, Elf *old, Elf *new) {
+    Hot_Plan *plan = mem_struct(mem, Hot_Plan);
+    plan->mem = mem;
+
+    char *sections[] = {".data", ".bss"};
+    for (u32 i = 0; i < array_count(sections); ++i) {
+        Elf_Section *sect_old = elf_find_section(old, sections[i]);
+        Elf_Section *sect_new = elf_find_section(new, sections[i]);
+        if (!sect_old || !sect_new) continue;
+        hot_plan_copy(plan, sect_new->addr, sect_old->addr, MIN(sect_old->size, sect_new->size));
+    }
+    return plan;
+}
+
+// Execute all copies of a plan in a single pass
+static void hot_plan_apply(Hot_Plan *plan, u8 *base_old, u8 *base_new) {
+    for (u32 i = 0; i < plan->count; ++i) {
+        Hot_Copy *copy = plan->copies + i;
+        ptr_copy(base_new + copy->dst, base_old + copy->src, copy->size);
+    }
+}
+
 // Load a (new) version of the library
 static void *hot_load(Hot *hot, char *path, char *symbol) {
     // Path must be copied to a unique location
     time_t time = time_now();
-    char *unique_path = fstr(hot->mem, "/tmp/hot_", O(.base = 16), (u64)time, ".so");
-    os_file_copy(path, unique_path);
+    char *unique_path = fstr(hot->mem, "/tmp/hot_", F_Base(16), (u64)time, ".so");
+    fs_copy(path, unique_path);
+    if (error) return 0;
 
     // Load library
     Library *lib = dl_open(unique_path);
-    assert(lib);
-    assert(lib != hot->lib);
+    check_or(lib && lib != hot->lib) return 0;
 
-    // Read elf file info
-    File *file = os_open(unique_path, FileMode_Read);
-    Elf *elf = elf_load(hot->mem, file);
-    os_close(file);
+    // Read elf file and debug info
+    Memory *lib_mem = mem_new();
+    File *file = fs_open(unique_path, FileMode_Read);
+    Elf *elf = elf_load(lib_mem, file);
+    Dwarf_File *dwarf = elf && elf_find_section(elf, ".debug_info") ? dwarf_load(lib_mem, elf) : 0;
+    if (error) {
+        if (elf) elf_close(elf);
+        mem_free(lib_mem);
+        return 0;
+    }
 
-    void *symbol_new = os_dlsym(lib, symbol);
+    void *symbol_new = dl_sym(lib, symbol);
 
     // If application was already loaded
     if (hot->lib) {
-        void *base_old = os_dlbase(hot->symbol);
-        void *base_new = os_dlbase(symbol_new);
-
-        char *sections[] = {
-            ".data",
-            ".bss",
-        };
-
-        // Copy over global variable data form old to new
-        // Assuming same layout (works most of the time)
-        for (u32 i = 0; i < array_count(sections); ++i) {
-            Elf_Section *sect_old = elf_find_section(hot->elf, sections[i]);
-            Elf_Section *sect_new = elf_find_section(elf, sections[i]);
-
-            void *addr_old = base_old + sect_old->addr;
-            void *addr_new = base_new + sect_new->addr;
-            u32 size_old = sect_old->size;
-            u32 size_new = sect_new->size;
-            u32 size_min = MIN(size_old, size_new);
-            ptr_copy(addr_new, addr_old, size_min);
-        }
+        u8 *base_old = dl_base(hot->symbol);
+        u8 *base_new = dl_base(symbol_new);
+
+        Memory *tmp = mem_new();
+        Hot_Plan *plan = hot->dwarf && dwarf ? hot_plan(tmp, hot->dwarf, dwarf) : 0;
+        if (!plan) plan = hot_plan_raw(tmp, hot->elf, elf);
+        hot_plan_apply(plan, base_old, base_new);
+        mem_free(tmp);
+
+        elf_close(hot->elf);
+        mem_free(hot->lib_mem);
     }
 
     hot->lib = lib;
-    hot->elf = elf;
     hot->symbol = symbol_new;
+    hot->lib_mem = lib_mem;
+    hot->elf = elf;
+    hot->dwarf = dwarf;
     return symbol_new;
 }
+
+// Global found by test_hot
+static u32 hot_test_global = 7;
+
+// Two versions of the same struct, as they would appear in the old and new library
+typedef struct {
+    u32 a;
+    u16 resized;
+    u64 b;
+    u32 list[2];
+} Hot_Test_Old;
+
+typedef struct {
+    u64 b;
+    u32 resized;
+    u32 a;
+    u8 added;
+    u32 list[3];
+} Hot_Test_New;
+
+static void test_hot(void) {
+    if (!OS_LINUX) return;
+
+    Memory *mem = mem_new();
+    File *file = fs_open("/proc/self/exe", FileMode_Read);
+    Elf *elf = elf_load(mem, file);
+    if (!elf || !elf_find_section(elf, ".debug_info")) {
+        // Built without debug info
+        if (elf) elf_close(elf);
+        else if (file) io_close(file);
+        mem_free(mem);
+        return;
+    }
+
+    Dwarf_File *dwarf = dwarf_load(mem, elf);
+    Dwarf_Die *old_type = dwarf ? dwarf_find(dwarf, DW_TAG_typedef, "Hot_Test_Old") : 0;
+    Dwarf_Die *new_type = dwarf ? dwarf_find(dwarf, DW_TAG_typedef, "Hot_Test_New") : 0;
+    check_or(old_type && new_type) {
+        elf_close(elf);
+        mem_free(mem);
+        return;
+    }
+
+    // Both versions come from the same debug info here
+    Hot_Plan *plan = mem_struct(mem, Hot_Plan);
+    plan->mem = mem;
+    plan->old = dwarf;
+    plan->new = dwarf;
+    hot_plan_type(plan, old_type, new_type, 0, 0, 0, 0);
+
+    Hot_Test_Old old = {.a = 1, .resized = 2, .b = 3, .list = {4, 5}};
+    Hot_Test_New new = {.b = 10, .resized = 11, .a = 12, .added = 13, .list = {14, 15, 16}};
+    hot_plan_apply(plan, (u8 *)&old, (u8 *)&new);
+
+    // Reordered fields and the common array elements are copied
+    check(new.a == 1 && new.b == 3);
+    check(new.list[0] == 4 && new.list[1] == 5);
+
+    // Resized and added fields keep their new initial value
+    check(new.resized == 11 && new.added == 13 && new.list[2] == 16);
+
+    // Globals in our own binary are found, the load address only moves whole pages
+    hot_test_global++;
+    Hot_Var *vars = 0;
+    u32 var_count = hot_vars(mem, dwarf, &vars);
+    Hot_Var *global = 0;
+    for (u32 i = 0; i < var_count; ++i) {
+        if (buf_ends_with(str_buf(vars[i].key), str_buf("::hot_test_global"))) global = vars + i;
+    }
+    check(global && ((u64)&hot_test_global - global->addr) % 4096 == 0);
+    check(global && hot_type_size(dwarf, global->type, 0) == sizeof(hot_test_global));
+
+    // So the plan is not empty
+    Hot_Plan *self = hot_plan(mem, dwarf, dwarf);
+    check(self && self->count > 0);
+
+    // Both forms of a fixed address are decoded
+    u8 addr_buffer[16] = {};
+    u64 addr_value = 0x1234;
+    ptr_copy(addr_buffer + 8, &addr_value, sizeof(addr_value));
+    Dwarf_File addr_dwarf = {.sect_addr = {addr_buffer, sizeof(addr_buffer)}};
+    Dwarf_Unit addr_unit = {.addr_size = 8, .addr_base = 0};
+    u8 expr_addr[9] = {DW_OP_addr, 0x34, 0x12};
+    u8 expr_addrx[2] = {DW_OP_addrx, 1};
+    u8 expr_stack[3] = {DW_OP_addrx, 1, 0x06};
+    u64 addr = 0;
+    check(hot_var_addr(&addr_dwarf, &addr_unit, &(Dwarf_Attr){.form = DW_FORM_exprloc, .size = 9, .value = (u64)expr_addr}, &addr) && addr == 0x1234);
+    addr = 0;
+    check(hot_var_addr(&addr_dwarf, &addr_unit, &(Dwarf_Attr){.form = DW_FORM_exprloc, .size = 2, .value = (u64)expr_addrx}, &addr) && addr == 0x1234);
+    check(!hot_var_addr(&addr_dwarf, &addr_unit, &(Dwarf_Attr){.form = DW_FORM_exprloc, .size = 3, .value = (u64)expr_stack}, &addr));
+
+    elf_close(elf);
+    mem_free(mem);
+}
@@ -108,6 +108,40 @@ static void *io_read_alloc(File *file, Memory *mem, size_t size) {
     return ptr;
 }
 
+// Map the whole file read only into memory
+// - Pages are only read from disk when they are accessed
+// - Returns an empty buffer if the file can't be mapped
+static Buffer io_map(File *file) {
+#if OS_LINUX
+    struct linux_stat stat;
+    if (linux_fstat(fd_from_handle(file), &stat) != 0 || stat.st_size <= 0) return buf_null();
+    void *data = linux_mmap(0, stat.st_size, PROT_READ, MAP_PRIVATE, fd_from_handle(file), 0);
+    if (data == MAP_FAILED) return buf_null();
+    return (Buffer){data, stat.st_size};
+#elif OS_WINDOWS
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0) return buf_null();
+    HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+    if (!mapping) return buf_null();
+    void *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!data) return buf_null();
+    return (Buffer){data, size.QuadPart};
+#else
+    return buf_null();
+#endif
+}
+
+// Unmap a buffer returned by io_map
+static void io_unmap(Buffer map) {
+    if (!map.data) return;
+#if OS_LINUX
+    linux_munmap(map.data, map.size);
+#elif OS_WINDOWS
+    UnmapViewOfFile(map.data);
+#endif
+}
+
 static Buffer io_read_all_alloc(File *file, Memory *mem) {
     Write *write = write_new(mem);
     Buffer buffer = buf_stack(1024);
@@ -10,12 +10,14 @@ struct Parse {
     Memory *mem;
     u64 cursor;
     u64 size;
-
-    // TODO: don't read everything at once to support files > 4GB
     u8 *data;
+
+    // Set when a read went past the end, those reads return zero
+    // Check it once after parsing instead of after every read.
+    bool overrun;
 };
 
-static Parse *parse_new(Memory *mem, void *data, u32 size) {
+static Parse *parse_new(Memory *mem, void *data, u64 size) {
     Parse *parse = mem_struct(mem, Parse);
     parse->cursor = 0;
     parse->size = size;
@@ -41,29 +43,46 @@ static bool parse_next(Parse *parse) {
     return true;
 }
 
-static void *parse_data(Parse *parse, u32 size) {
-    if (parse->cursor + size > parse->size) {
+// Check if 'size' more bytes can be read, the cursor can be past the end
+static bool parse_fits(Parse *parse, u64 size) {
+    return parse->cursor <= parse->size && size <= parse->size - parse->cursor;
+}
+
+// Consume 'size' bytes, returns null and moves to the end on overrun
+static void *parse_data(Parse *parse, u64 size) {
+    if (!parse_fits(parse, size)) {
         parse->cursor = parse->size;
+        parse->overrun = true;
         return 0;
     }
     void *ret = parse->data + parse->cursor;
     parse->cursor += size;
     return ret;
 }
+
+// Read a little endian integer of 1, 2, 4 or 8 bytes, zero on overrun
+#define PARSE_INT(PARSE, TYPE)                                     \
+    ({                                                             \
+        TYPE _value = 0;                                           \
+        void *_data = parse_data((PARSE), sizeof(TYPE));           \
+        if (_data) __builtin_memcpy(&_value, _data, sizeof(TYPE)); \
+        _value;                                                    \
+    })
+
 static u64 parse_u64(Parse *parse) {
-    return *(u64 *)parse_data(parse, sizeof(u64));
+    return PARSE_INT(parse, u64);
 }
 
 static u32 parse_u32(Parse *parse) {
-    return *(u32 *)parse_data(parse, sizeof(u32));
+    return PARSE_INT(parse, u32);
 }
 
 static u16 parse_u16(Parse *parse) {
-    return *(u16 *)parse_data(parse, sizeof(u16));
+    return PARSE_INT(parse, u16);
 }
 
 static u8 parse_u8(Parse *parse) {
-    return *(u8 *)parse_data(parse, sizeof(u8));
+    return PARSE_INT(parse, u8);
 }
 
 static u32 parse_u24(Parse *parse) {
@@ -74,31 +93,47 @@ static u32 parse_u24(Parse *parse) {
     return data;
 }
 
-// Parse unsigned LEB128 integer
-static u64 parse_leb128(Parse *parse, bool is_signed) {
+// Sign extend the lowest 'bits' bits of a value
+static u64 parse_sign_extend(u64 value, u32 bits) {
+    if (bits >= 64) return value;
+    u32 move = 64 - bits;
+    return (u64)((i64)(value << move) >> move);
+}
+
+// Byte at a time LEB128 decoding, used near the end of the data and for very large values
+static u64 parse_leb128_slow(Parse *parse, bool is_signed) {
     u64 value = 0;
     u32 shift = 0;
     for (;;) {
         u8 byte = parse_u8(parse);
-        u8 byte_low = byte & 0x7f;
-        u8 byte_high = byte & 0x80;
-        value |= (u64)byte_low << shift;
-        if (byte_high == 0) break;
+        if (shift < 64) value |= (u64)(byte & 0x7f) << shift;
         shift += 7;
+        if ((byte & 0x80) == 0) break;
     }
+    return is_signed ? parse_sign_extend(value, shift) : value;
+}
 
-    if (is_signed) {
-        u32 move = 64 - shift;
+// Parse LEB128 integer
+// Values of at most 8 bytes (56 bits) are decoded from a single 64 bit load without branching on every byte.
+static u64 parse_leb128(Parse *parse, bool is_signed) {
+    if (!parse_fits(parse, 8)) return parse_leb128_slow(parse, is_signed);
 
-        // Sign extend
-        i64 s_value = value << move;
+    u64 word;
+    __builtin_memcpy(&word, parse->data + parse->cursor, 8);
 
-        // Shift back while sign extending
-        s_value >>= move;
+    // The high bit of every byte is clear only in the last byte
+    u64 stop = ~word & 0x8080808080808080;
+    if (stop == 0) return parse_leb128_slow(parse, is_signed);
 
-        value = s_value;
-    }
-    return value;
+    // Keep all bytes up to the last one, then pack the 7 bit groups together
+    u32 bits = __builtin_ctzll(stop) + 1;
+    word &= (stop ^ (stop - 1)) & 0x7f7f7f7f7f7f7f7f;
+    word = (word & 0x007f007f007f007f) | ((word & 0x7f007f007f007f00) >> 1);
+    word = (word & 0x00003fff00003fff) | ((word & 0x3fff00003fff0000) >> 2);
+    word = (word & 0x000000000fffffff) | ((word & 0x0fffffff00000000) >> 4);
+
+    parse->cursor += bits / 8;
+    return is_signed ? parse_sign_extend(word, bits / 8 * 7) : word;
 }
 
 // Parse unsigned LEB128 integer
@@ -140,3 +175,42 @@ static bool parse_symbol(Parse *parse, char *symbol) {
     parse->cursor += len;
     return true;
 }
+
+static void test_parse(void) {
+    // Examples from the DWARF specification, followed by padding for the fast path
+    u8 data[] = {
+        0x02, 0x7f, 0x80, 0x01, 0x81, 0x01, 0x82, 0x01, 0xb9, 0x64, // unsigned
+        0x02, 0x7e, 0xff, 0x00, 0x81, 0x7f, 0x80, 0x01, 0x80, 0x7f, // signed
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x01, // 2^64 - 1, 10 bytes
+        0, 0, 0, 0, 0, 0, 0, 0,
+    };
+
+    Parse parse = {.data = data, .size = sizeof(data)};
+    u64 unsigned_values[] = {2, 127, 128, 129, 130, 12857};
+    i64 signed_values[] = {2, -2, 127, -127, 128, -128};
+    for (u32 i = 0; i < array_count(unsigned_values); ++i) check(parse_uleb128(&parse) == unsigned_values[i]);
+    for (u32 i = 0; i < array_count(signed_values); ++i) check(parse_ileb128(&parse) == signed_values[i]);
+    check(parse_uleb128(&parse) == 0xffffffffffffffff);
+    check(parse.cursor == 30 && !parse.overrun);
+
+    // Same results without the fast path
+    Parse slow = {.data = data, .size = 10};
+    for (u32 i = 0; i < array_count(unsigned_values); ++i) check(parse_uleb128(&slow) == unsigned_values[i]);
+    check(parse_eof(&slow) && !slow.overrun);
+
+    // Reading past the end returns zero
+    Parse end = {.data = data, .size = 3};
+    check(parse_u16(&end) == 0x7f02);
+    check(parse_u32(&end) == 0);
+    check(end.overrun && parse_eof(&end));
+    check(parse_u8(&end) == 0);
+
+    // A value that is cut off
+    Parse cut = {.data = data + 2, .size = 1};
+    check(parse_uleb128(&cut) == 0);
+    check(cut.overrun);
+
+    // The cursor may start past the end
+    Parse past = {.data = data, .cursor = 100, .size = sizeof(data)};
+    check(parse_u64(&past) == 0 && past.overrun);
+}
@@ -3,6 +3,7 @@
 #pragma once
 #include "error.h"
 #include "os_headers.h"
+#include "time.h"
 
 typedef struct Process Process;
 
@@ -13,9 +14,17 @@ static void proc_shell(char *command) {
     IF_WASM({});
 }
 
+// Set an environment variable for child processes
+static void proc_env_set(char *name, char *value) {
+    IF_LINUX({ check(setenv(name, value, 1) == 0); });
+    IF_WINDOWS({ check(SetEnvironmentVariableA(name, value)); });
+    IF_WASM({});
+}
+
 // Execute a process without waiting for it to finish
 // - argv is a null terminated list of strings
-static Process *proc_exec(char **argv) {
+// - When 'output' is set, stdout and stderr are redirected to that file
+static Process *proc_exec_to(char **argv, char *output) {
     Process *ret = 0;
 
     IF_LINUX({
@@ -23,6 +32,13 @@ static Process *proc_exec(char **argv) {
 
         // pid == 0 -> We are the child process
         if (pid == 0) {
+            if (output) {
+                i32 fd = sys_open(output, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                if (fd < 0) linux_exit_group(127);
+                sys_dup2(fd, 1);
+                sys_dup2(fd, 2);
+                sys_close(fd);
+            }
             execvp(argv[0], argv);
             linux_exit_group(127);
         }
@@ -38,18 +54,54 @@ static Process *proc_exec(char **argv) {
     return ret;
 }
 
+// Execute a process without waiting for it to finish
+// - argv is a null terminated list of strings
+static Process *proc_exec(char **argv) {
+    return proc_exec_to(argv, 0);
+}
+
+// Convert a waitpid status to an exit code
+static i32 proc_exit_code(i32 status) {
+    u32 sig = status & 0x7f;
+    u32 exit_code = (status >> 8) & 0xff;
+    if (sig) return -1;
+    return exit_code;
+}
+
 // Wait for process to exit and return exit code
 static i32 proc_wait(Process *proc) {
     IF_LINUX({
         i32 pid = fd_from_handle(proc);
         i32 status = 0;
         if (waitpid(pid, &status, 0) < 0) return -1;
-        u32 sig = status & 0x7f;
-        u32 exit_code = (status >> 8) & 0xff;
-        if (sig) return -1;
-        return exit_code;
+        return proc_exit_code(status);
     })
 
     IF_WINDOWS({ return 0; })
     IF_WASM({ return 0; })
 }
+
+// Wait for any of the given processes to exit
+// - Returns the index in 'list' and stores the exit code in 'exit_code'
+// - Returns -1 on failure
+// - Only the given processes are reaped, other children are left alone
+static i32 proc_wait_any(Process **list, u32 count, i32 *exit_code) {
+    IF_LINUX({
+        for (;;) {
+            for (u32 i = 0; i < count; ++i) {
+                i32 status = 0;
+                i32 pid = waitpid(fd_from_handle(list[i]), &status, WNOHANG);
+                check_or(pid >= 0) return -1;
+                if (pid == 0) continue;
+                *exit_code = proc_exit_code(status);
+                return i;
+            }
+
+            // Nothing finished yet, poll again shortly
+            os_sleep(TIME_MS);
+        }
+    })
+
+    IF_WINDOWS({ return -1; })
+    IF_WASM({ return -1; })
+}
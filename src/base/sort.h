@@ -0,0 +1,71 @@
+// Copyright (c) 2026 - Tom Smeets <tom@tsmeets.nl>
+// sort.h - Stable sorting of arrays
+#pragma once
+#include "mem.h"
+#include "ptr.h"
+#include "type.h"
+
+// Returns < 0 if a comes before b, > 0 if a comes after b and 0 if they are equal
+typedef i32 sort_cmp(void *a, void *b);
+
+// Sort 'count' elements of 'size' bytes using a bottom-up merge sort
+// - Stable, equal elements keep their order
+// - Already sorted runs are cheap, which is common for address tables
+static void sort_array(void *data, size_t count, size_t size, sort_cmp *compare) {
+    if (count < 2) return;
+
+    Memory *tmp = mem_new();
+    u8 *src = data;
+    u8 *dst = mem_alloc_uninit(tmp, count * size);
+    for (size_t width = 1; width < count; width *= 2) {
+        for (size_t start = 0; start < count; start += 2 * width) {
+            size_t mid = MIN(start + width, count);
+            size_t end = MIN(start + 2 * width, count);
+            size_t i = start, j = mid, k = start;
+
+            // Skip merging if the two halves are already in order
+            if (mid == end || compare(src + (mid - 1) * size, src + mid * size) <= 0) {
+                ptr_copy(dst + start * size, src + start * size, (end - start) * size);
+                continue;
+            }
+
+            while (i < mid && j < end) {
+                if (compare(src + j * size, src + i * size) < 0) ptr_copy(dst + k++ * size, src + j++ * size, size);
+                else ptr_copy(dst + k++ * size, src + i++ * size, size);
+            }
+            ptr_copy(dst + k * size, src + i * size, (mid - i) * size);
+            k += mid - i;
+            ptr_copy(dst + k * size, src + j * size, (end - j) * size);
+        }
+        u8 *swap = src;
+        src = dst;
+        dst = swap;
+    }
+
+    // Result should end up in the original array
+    if (src != data) ptr_copy(data, src, count * size);
+    mem_free(tmp);
+}
+
+static i32 _test_sort_cmp(void *a, void *b) {
+    u32 x = *(u32 *)a >> 8;
+    u32 y = *(u32 *)b >> 8;
+    return x < y ? -1 : x > y;
+}
+
+static void test_sort(void) {
+    // Key in the high bits, original index in the low bits to test stability
+    u32 values[200];
+    u32 seed = 1;
+    for (u32 i = 0; i < array_count(values); ++i) {
+        seed = seed * 1103515245 + 12345;
+        values[i] = (seed >> 16) % 64 << 8 | i;
+    }
+    sort_array(values, array_count(values), sizeof(u32), _test_sort_cmp);
+
+    for (u32 i = 1; i < array_count(values); ++i) {
+        u32 a = values[i - 1];
+        u32 b = values[i];
+        check((a >> 8) < (b >> 8) || ((a >> 8) == (b >> 8) && (a & 0xff) < (b & 0xff)));
+    }
+}
@@ -0,0 +1,35 @@
+// Copyright (c) 2026 - Tom Smeets <tom@tsmeets.nl>
+// atomic.h - Atomic operations for sharing data between threads
+#pragma once
+#include "type.h"
+
+// All operations are sequentially consistent.
+// This is the easiest model to reason about and fast enough for our use.
+#define atomic_load(PTR) __atomic_load_n(PTR, __ATOMIC_SEQ_CST)
+#define atomic_store(PTR, VALUE) __atomic_store_n(PTR, VALUE, __ATOMIC_SEQ_CST)
+
+// Store a new value and return the old value
+#define atomic_swap(PTR, VALUE) __atomic_exchange_n(PTR, VALUE, __ATOMIC_SEQ_CST)
+
+// Add or subtract and return the old value
+#define atomic_add(PTR, VALUE) __atomic_fetch_add(PTR, VALUE, __ATOMIC_SEQ_CST)
+#define atomic_sub(PTR, VALUE) __atomic_fetch_sub(PTR, VALUE, __ATOMIC_SEQ_CST)
+
+// Replace '*PTR' with 'NEW' only if it is equal to 'OLD', returns true on success
+#define atomic_cas(PTR, OLD, NEW) \
+    ({ \
+        typeof(*(PTR)) _old = (OLD); \
+        __atomic_compare_exchange_n(PTR, &_old, NEW, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST); \
+    })
+
+// Full memory barrier
+#define atomic_fence() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+// Hint to the cpu that we are in a spin loop
+static void cpu_relax(void) {
+#if __x86_64__ || __i386__
+    __builtin_ia32_pause();
+#elif __aarch64__
+    __asm__ volatile("yield");
+#endif
+}
@@ -33,6 +33,12 @@ static bool buf_starts_with(Buffer buf, Buffer start) {
     return ptr_eq(buf.data, start.data, start.size);
 }
 
+// Check if buffer ends with the same data
+static bool buf_ends_with(Buffer buf, Buffer end) {
+    if (buf.size < end.size) return false;
+    return ptr_eq(buf.data + buf.size - end.size, end.data, end.size);
+}
+
 // Return the first 'size' bytes of the buffer
 static Buffer buf_take(Buffer a, size_t size) {
     if (size > a.size) size = a.size;
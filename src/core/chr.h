@@ -23,3 +23,14 @@ static bool chr_is_alpha(u8 chr) {
 static bool chr_is_digit(u8 chr) {
     return chr >= '0' && chr <= '9';
 }
+
+static bool chr_is_hex(u8 chr) {
+    return chr_is_digit(chr) || (chr >= 'a' && chr <= 'f') || (chr >= 'A' && chr <= 'F');
+}
+
+// Value of a hexadecimal digit
+static u32 chr_to_hex(u8 chr) {
+    if (chr_is_digit(chr)) return chr - '0';
+    if (chr_is_lower(chr)) return chr - 'a' + 10;
+    return chr - 'A' + 10;
+}
@@ -0,0 +1,260 @@
+// Copyright (c) 2026 - Tom Smeets <tom@tsmeets.nl>
+// job.h - Work stealing job system
+#pragma once
+#include "atomic.h"
+#include "error.h"
+#include "mem.h"
+#include "mutex.h"
+#include "thread.h"
+#include "type.h"
+
+// Usage:
+//   Job_System *jobs = job_system_new(mem, 0);
+//   u32 counter = 0;
+//   for (...) job_push(jobs, &counter, fn, user);
+//   job_wait(jobs, &counter);
+//   job_system_free(jobs);
+//
+// Every worker owns a queue. The owner pushes and pops at the bottom,
+// idle workers steal from the top. The thread calling job_system_new
+// is worker 0 and executes jobs while waiting in job_wait.
+
+// Job entry point
+typedef void job_fn(void *user);
+
+// Should be a power of two
+#define JOB_QUEUE_SIZE 1024
+
+typedef struct {
+    job_fn *fn;
+    void *user;
+
+    // Decremented when the job is done
+    u32 *counter;
+} Job;
+
+// Fixed size Chase-Lev deque
+typedef struct {
+    i64 top;
+    i64 bottom;
+    Job jobs[JOB_QUEUE_SIZE];
+} Job_Queue;
+
+typedef struct Job_System Job_System;
+
+typedef struct {
+    Job_System *system;
+    u32 index;
+    Thread *thread;
+    Job_Queue queue;
+} Job_Worker;
+
+struct Job_System {
+    u32 worker_count;
+    Job_Worker *workers;
+
+    // Incremented on every push, sleeping workers wait on this
+    u32 signal;
+    u32 sleepers;
+    u32 quit;
+};
+
+// The worker running on this thread
+static thread_local Job_Worker *job_worker;
+
+// Push a job to the bottom, only called by the owner
+static bool job_queue_push(Job_Queue *queue, Job job) {
+    i64 bottom = atomic_load(&queue->bottom);
+    i64 top = atomic_load(&queue->top);
+    if (bottom - top >= JOB_QUEUE_SIZE) return false;
+    queue->jobs[bottom & (JOB_QUEUE_SIZE - 1)] = job;
+    atomic_store(&queue->bottom, bottom + 1);
+    return true;
+}
+
+// Pop a job from the bottom, only called by the owner
+static bool job_queue_pop(Job_Queue *queue, Job *job) {
+    i64 bottom = atomic_load(&queue->bottom) - 1;
+    atomic_store(&queue->bottom, bottom);
+    i64 top = atomic_load(&queue->top);
+
+    // Queue was empty
+    if (top > bottom) {
+        atomic_store(&queue->bottom, bottom + 1);
+        return false;
+    }
+
+    *job = queue->jobs[bottom & (JOB_QUEUE_SIZE - 1)];
+    if (top < bottom) return true;
+
+    // Last job, race against thieves
+    bool ok = atomic_cas(&queue->top, top, top + 1);
+    atomic_store(&queue->bottom, bottom + 1);
+    return ok;
+}
+
+// Steal a job from the top, called by other workers
+static bool job_queue_steal(Job_Queue *queue, Job *job) {
+    i64 top = atomic_load(&queue->top);
+    i64 bottom = atomic_load(&queue->bottom);
+    if (top >= bottom) return false;
+    *job = queue->jobs[top & (JOB_QUEUE_SIZE - 1)];
+    return atomic_cas(&queue->top, top, top + 1);
+}
+
+static void job_run(Job job) {
+    job.fn(job.user);
+    if (job.counter) atomic_sub(job.counter, 1);
+}
+
+// Find a job in our own queue, or steal one from another worker
+static bool job_find(Job_Worker *worker, Job *job) {
+    if (job_queue_pop(&worker->queue, job)) return true;
+
+    Job_System *system = worker->system;
+    for (u32 i = 1; i < system->worker_count; ++i) {
+        Job_Worker *victim = system->workers + (worker->index + i) % system->worker_count;
+        if (job_queue_steal(&victim->queue, job)) return true;
+    }
+    return false;
+}
+
+static void job_worker_main(void *user) {
+    Job_Worker *worker = user;
+    Job_System *system = worker->system;
+    job_worker = worker;
+
+    u32 idle = 0;
+    while (!atomic_load(&system->quit)) {
+        Job job;
+        if (job_find(worker, &job)) {
+            job_run(job);
+            idle = 0;
+            continue;
+        }
+
+        // Spin a bit before going to sleep
+        if (idle++ < 128) {
+            cpu_relax();
+            continue;
+        }
+
+        // Register as sleeper before the last check, so a push can't be missed
+        atomic_add(&system->sleepers, 1);
+        u32 signal = atomic_load(&system->signal);
+        if (job_find(worker, &job)) {
+            atomic_sub(&system->sleepers, 1);
+            job_run(job);
+            idle = 0;
+            continue;
+        }
+        if (!atomic_load(&system->quit)) os_futex_wait(&system->signal, signal);
+        atomic_sub(&system->sleepers, 1);
+    }
+    job_worker = 0;
+}
+
+// Create a job system with 'thread_count' workers including the calling thread
+// - Zero uses one worker per cpu core
+static Job_System *job_system_new(Memory *mem, u32 thread_count) {
+    if (thread_count == 0) thread_count = os_cpu_count();
+    if (OS_WASM) thread_count = 1;
+
+    Job_System *system = mem_struct(mem, Job_System);
+    system->worker_count = thread_count;
+    system->workers = mem_array_zero(mem, Job_Worker, thread_count);
+    for (u32 i = 0; i < thread_count; ++i) {
+        system->workers[i].system = system;
+        system->workers[i].index = i;
+    }
+
+    // Worker 0 is the calling thread
+    job_worker = system->workers;
+    for (u32 i = 1; i < thread_count; ++i) {
+        Job_Worker *worker = system->workers + i;
+        worker->thread = os_thread_start(mem, job_worker_main, worker);
+    }
+    return system;
+}
+
+// Schedule 'fn(user)' to be executed on any worker
+// - 'counter' is incremented now and decremented when the job is done, can be null
+// - Jobs pushed from threads outside of this system are executed immediately
+static void job_push(Job_System *system, u32 *counter, job_fn *fn, void *user) {
+    Job job = {fn, user, counter};
+    if (counter) atomic_add(counter, 1);
+
+    Job_Worker *worker = job_worker;
+    if (!worker || worker->system != system || !job_queue_push(&worker->queue, job)) {
+        job_run(job);
+        return;
+    }
+
+    atomic_add(&system->signal, 1);
+    if (atomic_load(&system->sleepers)) os_futex_wake(&system->signal, 1);
+}
+
+// Execute jobs until 'counter' reaches zero
+static void job_wait(Job_System *system, u32 *counter) {
+    Job_Worker *worker = job_worker;
+    while (atomic_load(counter)) {
+        Job job;
+        if (worker && worker->system == system && job_find(worker, &job)) {
+            job_run(job);
+        } else {
+            cpu_relax();
+        }
+    }
+}
+
+// Stop all workers, queued jobs are not executed
+static void job_system_free(Job_System *system) {
+    atomic_store(&system->quit, 1);
+    atomic_add(&system->signal, 1);
+    os_futex_wake(&system->signal, U32_MAX >> 1);
+    for (u32 i = 1; i < system->worker_count; ++i) os_thread_join(system->workers[i].thread);
+    if (job_worker && job_worker->system == system) job_worker = 0;
+}
+
+typedef struct {
+    Job_System *system;
+    u32 *counter;
+    u32 depth;
+    u64 *sum;
+} Job_Test;
+
+// Recursively spawn jobs, to test pushing from workers
+static void _test_job_fn(void *user) {
+    Job_Test *test = user;
+    atomic_add(test->sum, 1);
+    if (test->depth == 0) return;
+
+    // Children are allocated by the parent job and freed after waiting
+    Job_Test children[2];
+    u32 counter = 0;
+    for (u32 i = 0; i < 2; ++i) {
+        children[i] = (Job_Test){test->system, &counter, test->depth - 1, test->sum};
+        job_push(test->system, &counter, _test_job_fn, children + i);
+    }
+    job_wait(test->system, &counter);
+}
+
+static void test_job(void) {
+    Memory *mem = mem_new();
+    Job_System *system = job_system_new(mem, 4);
+
+    u64 sum = 0;
+    u32 counter = 0;
+    Job_Test tests[8];
+    for (u32 i = 0; i < 8; ++i) {
+        tests[i] = (Job_Test){system, &counter, 8, &sum};
+        job_push(system, &counter, _test_job_fn, tests + i);
+    }
+    job_wait(system, &counter);
+
+    // Each tree of depth 8 has 2^9 - 1 nodes
+    check(counter == 0);
+    check(sum == 8 * 511);
+    job_system_free(system);
+    mem_free(mem);
+}
@@ -41,6 +41,7 @@ static struct linux_timespec time_to_timespec(u64 time) {
 // Functions from libc
 extern int system(const char *command);
 extern char *realpath(const char *path, char *resolved_path);
+extern int setenv(const char *name, const char *value, int overwrite);
 
 #define RTLD_NOW 0x00002
 #define RTLD_LOCAL 0
@@ -56,6 +57,11 @@ typedef struct {
 } Dl_info;
 extern int dladdr(const void *__address, Dl_info *__info);
 
+// Threads are created using libc, so that it can setup TLS for us
+typedef ulong pthread_t;
+extern int pthread_create(pthread_t *thread, const void *attr, void *(*start_routine)(void *), void *arg);
+extern int pthread_join(pthread_t thread, void **retval);
+
 // =================== Syscalls ==============
 static i64 linux_syscall6(i64 a0, i64 a1, i64 a2, i64 a3, i64 a4, i64 a5, i64 a6) {
     i64 ret;
@@ -216,19 +222,27 @@ static i64 linux_seek(i32 fd, i64 offset, u32 whence) {
 // ==== Memory allocation (mmap) ====
 #define PROT_READ 0x1
 #define PROT_WRITE 0x2
+#define PROT_EXEC 0x4
 
 #define MAP_PRIVATE 0x02
 #define MAP_ANONYMOUS 0x20
 #define MAP_FAILED ((void *)-1)
 
+// Returns MAP_FAILED on error, like libc
 static void *linux_mmap(void *addr, u64 len, i32 prot, i32 flags, i32 fd, i64 offset) {
-    return (void *)linux_syscall6(0x09, (i64)addr, len, prot, flags, fd, offset);
+    i64 ret = linux_syscall6(0x09, (i64)addr, len, prot, flags, fd, offset);
+    if (ret < 0 && ret >= -4095) return MAP_FAILED;
+    return (void *)ret;
 }
 
 static void linux_munmap(void *addr, u64 len) {
     linux_syscall2(0x0b, (i64)addr, len);
 }
 
+static i32 linux_mprotect(void *addr, u64 len, i32 prot) {
+    return linux_syscall3(0x0a, (i64)addr, len, prot);
+}
+
 // ==== Sleep ====
 static i32 linux_nanosleep(const struct linux_timespec *duration, struct linux_timespec *remaining) {
     return linux_syscall2(0x23, (i64)duration, (i64)remaining);
@@ -283,6 +297,44 @@ static i64 linux_getdents64(i32 fd, struct linux_dirent64 *dirent, u32 count) {
     return linux_syscall3(0xd9, fd, (i64)dirent, count);
 }
 
+// ==== CPU Affinity ====
+// Mask is a bitset of cpu indices, pid 0 is the calling thread
+static i64 linux_sched_setaffinity(i32 pid, u64 size, u64 *mask) {
+    return linux_syscall3(0xcb, pid, size, (i64)mask);
+}
+
+// Returns the number of bytes written to mask
+static i64 linux_sched_getaffinity(i32 pid, u64 size, u64 *mask) {
+    return linux_syscall3(0xcc, pid, size, (i64)mask);
+}
+
+// ==== Scheduling ====
+#define SCHED_FIFO 1
+
+struct linux_sched_param {
+    i32 sched_priority;
+};
+
+// Set the scheduling policy, pid 0 is the calling thread
+static i32 linux_sched_setscheduler(i32 pid, i32 policy, struct linux_sched_param *param) {
+    return linux_syscall3(0x90, pid, policy, (i64)param);
+}
+
+// ==== Futex ====
+// Private futexes are only shared between threads of the same process
+#define FUTEX_WAIT_PRIVATE 128
+#define FUTEX_WAKE_PRIVATE 129
+
+// Sleep while '*addr == value', or until woken, timeout may be null
+static i64 linux_futex_wait(u32 *addr, u32 value, struct linux_timespec *timeout) {
+    return linux_syscall4(0xca, (i64)addr, FUTEX_WAIT_PRIVATE, value, (i64)timeout);
+}
+
+// Wake up to 'count' threads waiting on 'addr'
+static i64 linux_futex_wake(u32 *addr, u32 count) {
+    return linux_syscall3(0xca, (i64)addr, FUTEX_WAKE_PRIVATE, count);
+}
+
 // ==== Exit ====
 __attribute__((__noreturn__)) static void linux_exit_group(i32 error_code) {
     // Add infinite loop to make clang happy
@@ -297,6 +349,7 @@ static i64 linux_getrandom(void *buf, u64 size, u32 flags) {
 
 // ==== INotify ====
 int fork(void);
+#define WNOHANG 1
 int waitpid(int pid, int *status, int options);
 int execvp(const char *file, char *const argv[]);
 
@@ -306,6 +359,12 @@ static long sys_read(uint fd, char *buf, size_t count) {
 static long sys_write(uint fd, const char *buf, size_t count) {
     return linux_syscall3(1, fd, (i64)buf, count);
 }
+static long sys_open(const char *filename, int flags, umode_t mode) {
+    return linux_syscall3(2, (i64)filename, flags, mode);
+}
 static long sys_close(uint fd) {
     return linux_syscall1(3, fd);
 }
+static long sys_dup2(uint old_fd, uint new_fd) {
+    return linux_syscall2(0x21, old_fd, new_fd);
+}
@@ -0,0 +1,133 @@
+// Copyright (c) 2026 - Tom Smeets <tom@tsmeets.nl>
+// mutex.h - Futex based mutex and condition variable
+#pragma once
+#include "atomic.h"
+#include "error.h"
+#include "mem.h"
+#include "os_headers.h"
+#include "thread.h"
+#include "type.h"
+
+// Sleep while '*addr == value', can return spuriously
+static void os_futex_wait(u32 *addr, u32 value) {
+#if OS_LINUX
+    linux_futex_wait(addr, value, 0);
+#elif OS_WINDOWS
+    WaitOnAddress(addr, &value, sizeof(value), INFINITE);
+#elif OS_WASM
+    // Single threaded, nobody could wake us up
+    cpu_relax();
+#endif
+}
+
+// Wake up to 'count' threads sleeping in os_futex_wait
+static void os_futex_wake(u32 *addr, u32 count) {
+#if OS_LINUX
+    linux_futex_wake(addr, count);
+#elif OS_WINDOWS
+    if (count == 1) WakeByAddressSingle(addr);
+    else WakeByAddressAll(addr);
+#endif
+}
+
+// A Mutex is zero initialized
+//   0 -> unlocked
+//   1 -> locked
+//   2 -> locked, and other threads might be sleeping
+typedef struct {
+    u32 state;
+} Mutex;
+
+static bool mutex_try_lock(Mutex *mutex) {
+    return atomic_cas(&mutex->state, 0, 1);
+}
+
+static void mutex_lock(Mutex *mutex) {
+    // Fast path, no contention
+    if (atomic_cas(&mutex->state, 0, 1)) return;
+
+    // Spin for a bit, the lock is usually held only briefly
+    for (u32 i = 0; i < 64; ++i) {
+        cpu_relax();
+        if (atomic_load(&mutex->state) == 0 && atomic_cas(&mutex->state, 0, 1)) return;
+    }
+
+    // Mark the mutex as contended and sleep until it is released
+    while (atomic_swap(&mutex->state, 2) != 0) os_futex_wait(&mutex->state, 2);
+}
+
+static void mutex_unlock(Mutex *mutex) {
+    // Only do the syscall if someone might be waiting
+    if (atomic_swap(&mutex->state, 0) == 2) os_futex_wake(&mutex->state, 1);
+}
+
+// A Condition variable is zero initialized
+// The sequence number changes on every signal, so a wakeup between
+// releasing the mutex and sleeping is never lost.
+typedef struct {
+    u32 seq;
+} Cond;
+
+// Release the mutex and wait for a signal, the mutex is locked again on return
+// - Can return spuriously, always check the condition in a loop
+static void cond_wait(Cond *cond, Mutex *mutex) {
+    u32 seq = atomic_load(&cond->seq);
+    mutex_unlock(mutex);
+    os_futex_wait(&cond->seq, seq);
+    mutex_lock(mutex);
+}
+
+// Wake up one waiting thread
+static void cond_signal(Cond *cond) {
+    atomic_add(&cond->seq, 1);
+    os_futex_wake(&cond->seq, 1);
+}
+
+// Wake up all waiting threads
+static void cond_broadcast(Cond *cond) {
+    atomic_add(&cond->seq, 1);
+    os_futex_wake(&cond->seq, U32_MAX >> 1);
+}
+
+typedef struct {
+    Mutex mutex;
+    Cond cond;
+    u32 counter;
+    u32 ready;
+} Mutex_Test;
+
+static void _test_mutex_fn(void *user) {
+    Mutex_Test *test = user;
+
+    // Wait until all threads are started
+    mutex_lock(&test->mutex);
+    while (!test->ready) cond_wait(&test->cond, &test->mutex);
+    mutex_unlock(&test->mutex);
+
+    // Non atomic increment, only correct if the mutex works
+    for (u32 i = 0; i < 10000; ++i) {
+        mutex_lock(&test->mutex);
+        test->counter++;
+        mutex_unlock(&test->mutex);
+    }
+}
+
+static void test_mutex(void) {
+    Memory *mem = mem_new();
+    Mutex_Test test = {};
+
+    Thread *threads[4];
+    for (u32 i = 0; i < 4; ++i) threads[i] = os_thread_start(mem, _test_mutex_fn, &test);
+
+    mutex_lock(&test.mutex);
+    test.ready = 1;
+    cond_broadcast(&test.cond);
+    mutex_unlock(&test.mutex);
+
+    for (u32 i = 0; i < 4; ++i) os_thread_join(threads[i]);
+    check(test.counter == 4 * 10000);
+    check(mutex_try_lock(&test.mutex));
+    check(!mutex_try_lock(&test.mutex));
+    mutex_unlock(&test.mutex);
+    mem_free(mem);
+}
@@ -6,7 +6,10 @@
 #include "type.h"
 
 // Allocate a new chunk of memory
+// - Returns null on failure, or when 'size' is 0
 static void *os_alloc(size_t size) {
+    if (size == 0) return 0;
+
 #if OS_LINUX
     // see 'man 2 mmap'
     void *ptr = linux_mmap(
@@ -24,7 +27,7 @@ static void *os_alloc(size_t size) {
     );
 
     // Check if mapping was ok
-    check(ptr != MAP_FAILED);
+    check_or(ptr != MAP_FAILED) return 0;
 #elif OS_WINDOWS
     void *ptr = VirtualAlloc(
         // Let the system choose a starting address for us
@@ -44,18 +47,49 @@ static void *os_alloc(size_t size) {
     size_t page_ix = wasm_memory_grow(pages);
 
     // Check allocation result, -1 is failure
-    check(page_ix != (size_t)-1);
+    check_or(page_ix != (size_t)-1) return 0;
 
     // Convert to pointer
     void *ptr = (void *)(page_ix * WASM_PAGE_SIZE);
 #endif
     // We consider null to also be invalid
-    if (size > 0) check(ptr != 0);
+    check(ptr != 0);
     return ptr;
 }
 
+// Return memory from 'os_alloc' to the system
+static void os_free(void *ptr, size_t size) {
+#if OS_LINUX
+    linux_munmap(ptr, size);
+#elif OS_WINDOWS
+    VirtualFree(ptr, 0, MEM_RELEASE);
+#elif OS_WASM
+    // WASM memory can only grow
+    (void)ptr;
+    (void)size;
+#endif
+}
+
+// Make memory from 'os_alloc' executable and read-only, for generated machine code
+// - Memory is never writable and executable at the same time
+// - Returns false if the platform does not support executing generated code
+static bool os_protect_exec(void *ptr, size_t size) {
+#if OS_LINUX
+    return linux_mprotect(ptr, size, PROT_READ | PROT_EXEC) == 0;
+#elif OS_WINDOWS
+    DWORD old_protect;
+    if (!VirtualProtect(ptr, size, PAGE_EXECUTE_READ, &old_protect)) return false;
+    return FlushInstructionCache(GetCurrentProcess(), ptr, size);
+#elif OS_WASM
+    (void)ptr;
+    (void)size;
+    return false;
+#endif
+}
+
 static void test_alloc(void) {
     char *n = os_alloc(0);
+    check(!n && !error);
     char *a = os_alloc(16);
     char *b = os_alloc(32);
     check(a);
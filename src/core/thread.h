@@ -0,0 +1,131 @@
+// Copyright (c) 2026 - Tom Smeets <tom@tsmeets.nl>
+// thread.h - Native threads
+#pragma once
+#include "error.h"
+#include "mem.h"
+#include "os_headers.h"
+#include "type.h"
+
+// Thread entry point
+typedef void thread_fn(void *user);
+
+typedef struct {
+    thread_fn *fn;
+    void *user;
+#if OS_LINUX
+    pthread_t handle;
+#elif OS_WINDOWS
+    HANDLE handle;
+#endif
+} Thread;
+
+// Common entry point for all threads
+static void _os_thread_main(Thread *thread) {
+    thread->fn(thread->user);
+
+    // Temporary memory is thread local, so it is our responsibility
+    mem_tmp_free();
+}
+
+#if OS_LINUX
+static void *_os_thread_main_linux(void *thread) {
+    _os_thread_main(thread);
+    return 0;
+}
+#elif OS_WINDOWS
+static DWORD WINAPI _os_thread_main_windows(void *thread) {
+    _os_thread_main(thread);
+    return 0;
+}
+#endif
+
+// Start a new thread executing 'fn(user)'
+// - All thread_local variables (error, mem_tmp, chunk cache) start out empty
+// - The thread handle is allocated in 'mem'
+static Thread *os_thread_start(Memory *mem, thread_fn *fn, void *user) {
+    Thread *thread = mem_struct(mem, Thread);
+    thread->fn = fn;
+    thread->user = user;
+
+#if OS_LINUX
+    check_or(pthread_create(&thread->handle, 0, _os_thread_main_linux, thread) == 0) return 0;
+#elif OS_WINDOWS
+    thread->handle = CreateThread(0, 0, _os_thread_main_windows, thread, 0, 0);
+    check_or(thread->handle) return 0;
+#else
+    check_or(!"Threads are not supported on this platform") return 0;
+#endif
+    return thread;
+}
+
+// Wait for a thread to finish
+static void os_thread_join(Thread *thread) {
+    if (!thread) return;
+#if OS_LINUX
+    check(pthread_join(thread->handle, 0) == 0);
+#elif OS_WINDOWS
+    check(WaitForSingleObject(thread->handle, INFINITE) == WAIT_OBJECT_0);
+    check(CloseHandle(thread->handle));
+#endif
+}
+
+// Run the calling thread with real-time priority, for latency sensitive work like audio
+// - Returns false when this is not permitted, the thread then keeps running normally
+static bool os_thread_realtime(void) {
+#if OS_LINUX
+    struct linux_sched_param param = {.sched_priority = 10};
+    return linux_sched_setscheduler(0, SCHED_FIFO, &param) == 0;
+#elif OS_WINDOWS
+    return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+#else
+    return false;
+#endif
+}
+
+// Number of cpu cores this process is allowed to run on
+static u32 os_cpu_count(void) {
+    u32 count = 0;
+#if OS_LINUX
+    u64 mask[16] = {};
+    i64 size = linux_sched_getaffinity(0, sizeof(mask), mask);
+    check_or(size >= 0) size = 0;
+    for (u32 i = 0; i < size / sizeof(u64); ++i) count += __builtin_popcountll(mask[i]);
+#elif OS_WINDOWS
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    count = info.dwNumberOfProcessors;
+#endif
+    return MAX(count, 1);
+}
+
+// Restrict the calling thread to run only on the given cpu core
+static void os_thread_pin(u32 cpu) {
+#if OS_LINUX
+    u64 mask[16] = {};
+    check_or(cpu < sizeof(mask) * 8) return;
+    mask[cpu / 64] = (u64)1 << (cpu % 64);
+    check(linux_sched_setaffinity(0, sizeof(mask), mask) == 0);
+#elif OS_WINDOWS
+    check(SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu));
+#endif
+}
+
+static void _test_thread_fn(void *user) {
+    u32 *value = user;
+    *value += 1;
+
+    // Errors are thread local, so this does not leak into the main thread
+    error_set("Error in thread");
+}
+
+static void test_thread(void) {
+    Memory *mem = mem_new();
+    check(os_cpu_count() >= 1);
+
+    u32 values[4] = {1, 2, 3, 4};
+    Thread *threads[4];
+    for (u32 i = 0; i < 4; ++i) threads[i] = os_thread_start(mem, _test_thread_fn, values + i);
+    for (u32 i = 0; i < 4; ++i) os_thread_join(threads[i]);
+    for (u32 i = 0; i < 4; ++i) check(values[i] == i + 2);
+    mem_free(mem);
+}
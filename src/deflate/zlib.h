@@ -0,0 +1,81 @@
+// Copyright (c) 2026 - Tom Smeets <tom@tsmeets.nl>
+// zlib.h - ZLIB decompressor
+#pragma once
+#include "base64.h"
+#include "crc.h"
+#include "deflate.h"
+#include "error.h"
+#include "mem.h"
+#include "read.h"
+
+// See RFC 1950
+// A two byte header, raw deflate data and an adler32 checksum of the result
+
+static Buffer zlib_read_from(Memory *mem, Read *read) {
+    // Compression method and flags
+    u8 cmf = read_u8(read);
+    u8 flg = read_u8(read);
+
+    // Method 8 = deflate
+    check((cmf & 0xf) == 8);
+
+    // Header is a multiple of 31
+    check(((u32)cmf << 8 | flg) % 31 == 0);
+
+    // Preset dictionaries are not supported
+    check((flg & 0x20) == 0);
+    if (error) return buf_null();
+
+    Buffer result = deflate_read_from(mem, read);
+    if (error) return buf_null();
+
+    // Checksum is big endian
+    u32 adler = 0;
+    for (u32 i = 0; i < 4; ++i) adler = adler << 8 | read_u8(read);
+    check(adler == adler_compute(result));
+    if (error) return buf_null();
+    return result;
+}
+
+static Buffer zlib_read(Memory *mem, Buffer input) {
+    Read read = read_from(input);
+    return zlib_read_from(mem, &read);
+}
+
+static Buffer zlib_write(Memory *mem, Buffer input) {
+    Write *output = write_new(mem);
+    write_u8(output, 0x78); // Deflate with a 32K window
+    write_u8(output, 0x01); // Fastest compression, (0x7801 % 31 == 0)
+    write_buffer(output, deflate_write(mem, input));
+
+    u32 adler = adler_compute(input);
+    for (u32 i = 0; i < 4; ++i) write_u8(output, adler >> (24 - i * 8));
+    return write_get_written(output);
+}
+
+static void test_zlib(void) {
+    Memory *mem = mem_new();
+    Buffer target = str_buf("hello hello world hello hello\n");
+
+    {
+        // Created with python zlib.compress
+        Buffer input = base64_decode(mem, str_buf("eJzLSM3JyVfIAJPl+UU5KVA2mOQCAK99CwM="));
+        Buffer output = zlib_read(mem, input);
+        check(buf_eq(target, output));
+    }
+
+    {
+        Buffer input = zlib_write(mem, target);
+        Buffer output = zlib_read(mem, input);
+        check(buf_eq(target, output));
+    }
+
+    if (!error) {
+        // Wrong checksum
+        Buffer input = zlib_write(mem, target);
+        input.data[input.size - 1] ^= 1;
+        zlib_read(mem, input);
+        check(error_pop());
+    }
+    mem_free(mem);
+}
@@ -4,9 +4,35 @@
 #include "dwarf_types.h"
 #include "elf.h"
 #include "fmt.h"
+#include "fs.h"
+#include "job.h"
 #include "parse.h"
+#include "sort.h"
 #include "str.h"
 
+// Usage:
+//   Dwarf_File *dwarf = dwarf_load(mem, elf);
+//   for (u32 i = 1; i < dwarf->die_count; ++i) {
+//       Dwarf_Die *die = dwarf->dies + i;
+//       char *name = dwarf_attr_str(dwarf, die, DW_AT_name);
+//   }
+//
+//   // Or only parse the units that are needed
+//   Dwarf_File *dwarf = dwarf_open(mem, elf);
+//   Dwarf_Die *fn = dwarf_subprogram_at(dwarf, addr);
+//
+// All DIEs of all units are stored in one flat array. dwarf_load parses
+// everything in .debug_info order, dwarf_open only maps the sections and
+// units are appended when they are first needed.
+// The tree is formed by parent/child/sibling indices, index 0 is never used
+// and means 'none'. Attributes of a DIE are a contiguous range in 'attrs'.
+//
+// Attribute values are resolved after loading:
+//   string forms    -> value is a 'char *'
+//   reference forms -> value is a DIE index (ref_sig8 is kept as signature)
+//   addrx forms     -> value is the address
+//   block forms     -> value is a pointer to the data, 'size' is the length
+
 typedef struct {
     Dwarf_Attribute_Type name;
     Dwarf_Form form;
@@ -20,10 +46,68 @@ typedef struct {
     Dwarf_Abbrev_Attr *attr_list;
 } Dwarf_Abbrev;
 
-typedef struct {
+// All abbreviations starting at one offset in .debug_abbrev
+// Codes are numbered 1..N by compilers, so a dense array indexed by code is used
+typedef struct Dwarf_Abbrev_List Dwarf_Abbrev_List;
+struct Dwarf_Abbrev_List {
+    u64 offset;
     u32 count;
     Dwarf_Abbrev *abbrev;
-} Dwarf_Abbrev_List;
+    Dwarf_Abbrev_List *next;
+};
+
+typedef struct {
+    // Unit header, offsets are relative to the start of .debug_info
+    u64 offset;
+    u64 size;
+    u16 version;
+    u8 unit_type;
+    u8 addr_size;
+    u8 offset_size;
+    u64 abbrev_offset;
+    Dwarf_Abbrev_List *abbrev;
+
+    // DIEs of this unit are 'dies[die_start .. die_start + die_count]'
+    bool loaded;
+    u32 die_start;
+    u32 die_count;
+
+    // Found in the unit DIE, used to resolve strx and addrx forms
+    u64 str_offsets_base;
+    u64 addr_base;
+    u64 rnglists_base;
+
+    // Base address for range lists
+    u64 low_pc;
+
+    // Line table of this unit, loaded on first use by dwarf_line.h
+    struct Dwarf_Lines *lines;
+} Dwarf_Unit;
+
+typedef struct {
+    u16 name; // Dwarf_Attribute_Type
+    u16 form; // Dwarf_Form
+
+    // Length of block forms
+    u32 size;
+    u64 value;
+} Dwarf_Attr;
+
+typedef struct {
+    // Offset in .debug_info
+    u64 offset;
+    Dwarf_Tag tag;
+    u32 unit;
+
+    // Tree structure, 0 means none
+    u32 parent;
+    u32 child;
+    u32 sibling;
+
+    // Attributes are 'attrs[attr_start .. attr_start + attr_count]'
+    u32 attr_start;
+    u32 attr_count;
+} Dwarf_Die;
 
 typedef struct {
     Memory *mem;
@@ -33,19 +117,65 @@ typedef struct {
     Buffer sect_abbrev;
     Buffer sect_str;
     Buffer sect_str_offsets;
+    Buffer sect_line_str;
+    Buffer sect_addr;
+    Buffer sect_line;
+    Buffer sect_ranges;
+    Buffer sect_rnglists;
+    Buffer sect_aranges;
+
+    Dwarf_Abbrev_List *abbrev_lists;
+
+    bool units_loaded;
+    u32 unit_count;
+    Dwarf_Unit *units;
+
+    u32 die_count;
+    u32 die_cap;
+    Dwarf_Die *dies;
+
+    u32 attr_count;
+    u32 attr_cap;
+    Dwarf_Attr *attrs;
+
+    // Address ranges of all units sorted by start, see dwarf_unit_at
+    bool unit_ranges_loaded;
+    u32 unit_range_count;
+    struct Dwarf_Unit_Range *unit_ranges;
+
+    // Line table, loaded on first use by dwarf_line.h
+    struct Dwarf_Lines *lines;
+
+    // Function address ranges, loaded on first use by dwarf_func.h
+    struct Dwarf_Funcs *funcs;
 } Dwarf_File;
 
-static Buffer elf_read_section(Memory *mem, char *name, Elf *elf) {
-    Elf_Section *sect = elf_find_section(elf, name);
-    check(sect);
-    if (error) return buf_null();
+// Append an element to a growable array allocated in 'mem'
+#define DWARF_PUSH(MEM, ARRAY, COUNT, CAP) \
+    ({ \
+        if ((COUNT) == (CAP)) { \
+            u32 _cap = (CAP) ? (CAP) * 2 : 256; \
+            size_t _size = sizeof(*(ARRAY)); \
+            (ARRAY) = (typeof(ARRAY))mem_realloc((MEM), (u8 *)(ARRAY), _size * (COUNT), _size * _cap); \
+            (CAP) = _cap; \
+        } \
+        &(ARRAY)[(COUNT)++]; \
+    })
 
-    io_seek(elf->file, sect->offset);
-    u64 size = sect->size;
-    u8 *data = io_read_alloc(elf->file, mem, size);
-    return (Buffer){data, size};
-}
+// Reserve room for 'EXTRA' more elements in a growable array
+#define DWARF_RESERVE(MEM, ARRAY, COUNT, CAP, EXTRA) \
+    ({ \
+        if ((COUNT) + (EXTRA) > (CAP)) { \
+            u32 _cap = MAX((CAP) * 2, (COUNT) + (EXTRA)); \
+            size_t _size = sizeof(*(ARRAY)); \
+            (ARRAY) = (typeof(ARRAY))mem_realloc((MEM), (u8 *)(ARRAY), _size * (COUNT), _size * _cap); \
+            (CAP) = _cap; \
+        } \
+    })
 
+// Open the debug info without parsing anything
+// - Sections are views into the mapped file when possible
+// - Missing sections are empty, a file without debug info has no units
 static Dwarf_File *dwarf_open(Memory *mem, Elf *elf) {
     Dwarf_File *dwarf = mem_struct(mem, Dwarf_File);
     dwarf->mem = mem;
@@ -55,49 +185,74 @@ static Dwarf_File *dwarf_open(Memory *mem, Elf *elf) {
     dwarf->sect_abbrev = elf_read_section(mem, ".debug_abbrev", elf);
     dwarf->sect_str = elf_read_section(mem, ".debug_str", elf);
     dwarf->sect_str_offsets = elf_read_section(mem, ".debug_str_offsets", elf);
+    dwarf->sect_line_str = elf_read_section(mem, ".debug_line_str", elf);
+    dwarf->sect_addr = elf_read_section(mem, ".debug_addr", elf);
+    dwarf->sect_line = elf_read_section(mem, ".debug_line", elf);
+    dwarf->sect_ranges = elf_read_section(mem, ".debug_ranges", elf);
+    dwarf->sect_rnglists = elf_read_section(mem, ".debug_rnglists", elf);
+    dwarf->sect_aranges = elf_read_section(mem, ".debug_aranges", elf);
+    if (error) return 0;
     return dwarf;
 }
 
-static Dwarf_Abbrev_List dwarf_load_abbrev(Dwarf_File *file) {
-    // debug_abbrev contains the structure of each DIE
-    Parse *parse = parse_new(file->mem, file->sect_abbrev.data, file->sect_abbrev.size);
+// Load the abbreviation table starting at 'offset' in .debug_abbrev
+static Dwarf_Abbrev_List *dwarf_load_abbrev(Dwarf_File *file, u64 offset) {
+    // Units usually share tables, so check if it was already loaded
+    for (Dwarf_Abbrev_List *list = file->abbrev_lists; list; list = list->next) {
+        if (list->offset == offset) return list;
+    }
+
+    check_or(offset < file->sect_abbrev.size) return 0;
+    Buffer data = buf_drop(file->sect_abbrev, offset);
+    Parse parse = {.data = data.data, .size = data.size};
 
-    // Allocate a big enough array for abbreviation list
-    u32 abbrev_capacity = 1024 * 4;
     u32 abbrev_count = 0;
-    Dwarf_Abbrev *abbrev_list = mem_array(file->mem, Dwarf_Abbrev, abbrev_capacity);
+    u32 abbrev_capacity = 0;
+    Dwarf_Abbrev *abbrev_list = 0;
     for (;;) {
-        if (parse_eof(parse)) break;
-        u64 abbrev_code = parse_uleb128(parse);
+        if (parse_eof(&parse)) break;
+        u64 abbrev_code = parse_uleb128(&parse);
+
+        // Code 0 ends this table
+        if (abbrev_code == 0) break;
+        check_or(abbrev_code < (1 << 24)) return 0;
 
-        // Code 0 is used for padding
-        if (abbrev_code == 0) continue;
-        assert(abbrev_code < abbrev_capacity);
-        if (abbrev_code >= abbrev_count) abbrev_count = abbrev_code + 1;
+        // Grow the dense array up to the code
+        while (abbrev_count <= abbrev_code) {
+            Dwarf_Abbrev *abbrev = DWARF_PUSH(file->mem, abbrev_list, abbrev_count, abbrev_capacity);
+            *abbrev = (Dwarf_Abbrev){};
+        }
 
         Dwarf_Abbrev *abbrev = &abbrev_list[abbrev_code];
-        abbrev->tag = parse_uleb128(parse);
-        abbrev->has_children = parse_u8(parse);
+        abbrev->tag = parse_uleb128(&parse);
+        abbrev->has_children = parse_u8(&parse);
         u32 attr_count = 0;
-        Dwarf_Abbrev_Attr attr_list[64];
+        Dwarf_Abbrev_Attr attr_list[256];
         for (;;) {
-            u64 attr_name = parse_uleb128(parse);
-            u64 attr_form = parse_uleb128(parse);
+            u64 attr_name = parse_uleb128(&parse);
+            u64 attr_form = parse_uleb128(&parse);
             if (attr_name == 0 && attr_form == 0) break;
+            check_or(attr_count < array_count(attr_list)) return 0;
             Dwarf_Abbrev_Attr *attr = &attr_list[attr_count++];
             attr->name = attr_name;
             attr->form = attr_form;
+            attr->implicit_const_value = 0;
             if (attr_form == DW_FORM_implicit_const) {
-                attr->implicit_const_value = parse_ileb128(parse);
+                attr->implicit_const_value = parse_ileb128(&parse);
             }
         }
         abbrev->attr_count = attr_count;
         abbrev->attr_list = mem_clone(file->mem, attr_list, attr_count * sizeof(Dwarf_Abbrev_Attr));
     }
-    return (Dwarf_Abbrev_List){
-        .count = abbrev_count,
-        .abbrev = abbrev_list,
-    };
+    check_or(!parse.overrun) return 0;
+
+    Dwarf_Abbrev_List *list = mem_struct(file->mem, Dwarf_Abbrev_List);
+    list->offset = offset;
+    list->count = abbrev_count;
+    list->abbrev = abbrev_list;
+    list->next = file->abbrev_lists;
+    file->abbrev_lists = list;
+    return list;
 }
 
 static u64 parse_u64_form(Parse *parse, Dwarf_Form form) {
@@ -107,6 +262,7 @@ static u64 parse_u64_form(Parse *parse, Dwarf_Form form) {
     case DW_FORM_ref_udata:
     case DW_FORM_udata:
     case DW_FORM_rnglistx:
+    case DW_FORM_loclistx:
         return parse_uleb128(parse);
     case DW_FORM_sdata:
         return parse_ileb128(parse);
@@ -114,171 +270,943 @@ static u64 parse_u64_form(Parse *parse, Dwarf_Form form) {
     case DW_FORM_data1:
     case DW_FORM_addrx1:
     case DW_FORM_ref1:
+    case DW_FORM_flag:
         return parse_u8(parse);
     case DW_FORM_strx2:
     case DW_FORM_data2:
     case DW_FORM_addrx2:
     case DW_FORM_ref2:
         return parse_u16(parse);
+    case DW_FORM_strx3:
     case DW_FORM_addrx3:
         return parse_u24(parse);
     case DW_FORM_strx4:
     case DW_FORM_data4:
     case DW_FORM_addrx4:
     case DW_FORM_ref4:
+    case DW_FORM_ref_sup4:
         return parse_u32(parse);
     case DW_FORM_data8:
     case DW_FORM_ref8:
-        return parse_u64(parse);
-    case DW_FORM_data16:
-        (void)parse_u64(parse);
+    case DW_FORM_ref_sig8:
+    case DW_FORM_ref_sup8:
         return parse_u64(parse);
     default:
-        assert(0);
+        error_set("Unsupported DWARF form");
         return 0;
     }
 }
 
-typedef struct Dwarf_Die Dwarf_Die;
-typedef struct Dwarf_Die_Attr Dwarf_Die_Attr;
+// Parse an offset into another section, the size depends on the 32 or 64 bit dwarf format
+static u64 parse_offset(Parse *parse, u8 offset_size) {
+    return offset_size == 8 ? parse_u64(parse) : parse_u32(parse);
+}
 
-struct Dwarf_Die {
-    Dwarf_Die_Attr *attr_list;
-    Dwarf_Die *next;
-    Dwarf_Die *child;
-};
+// Parse a single attribute value, without resolving it
+static void dwarf_parse_attr(Parse *parse, Dwarf_Unit *unit, Dwarf_Abbrev_Attr *abbrev, Dwarf_Attr *attr) {
+    Dwarf_Form form = abbrev->form;
 
-struct Dwarf_Die_Attr {
-    Dwarf_Attribute_Type name;
-    union {
-        u64 data;
-        char *str;
-        Dwarf_Die *ref;
-    } value;
-    Dwarf_Die_Attr *next;
-};
+    // The form is stored in the DIE itself
+    while (form == DW_FORM_indirect) form = parse_uleb128(parse);
+
+    attr->name = abbrev->name;
+    attr->form = form;
+    attr->size = 0;
+    attr->value = 0;
+
+    switch (form) {
+    case DW_FORM_addr:
+        attr->value = unit->addr_size == 8 ? parse_u64(parse) : parse_u32(parse);
+        break;
+    case DW_FORM_strp:
+    case DW_FORM_line_strp:
+    case DW_FORM_strp_sup:
+    case DW_FORM_sec_offset:
+    case DW_FORM_ref_addr:
+        attr->value = parse_offset(parse, unit->offset_size);
+        break;
+    case DW_FORM_string:
+        attr->value = (u64)(parse->data + parse->cursor);
+        while (parse_peek(parse)) parse_next(parse);
+        parse_next(parse);
+        break;
+    case DW_FORM_implicit_const:
+        attr->value = abbrev->implicit_const_value;
+        break;
+    case DW_FORM_flag_present:
+        attr->value = 1;
+        break;
+    case DW_FORM_exprloc:
+    case DW_FORM_block:
+    case DW_FORM_block1:
+    case DW_FORM_block2:
+    case DW_FORM_block4:
+    case DW_FORM_data16: {
+        u64 size = 16;
+        if (form == DW_FORM_exprloc || form == DW_FORM_block) size = parse_uleb128(parse);
+        if (form == DW_FORM_block1) size = parse_u8(parse);
+        if (form == DW_FORM_block2) size = parse_u16(parse);
+        if (form == DW_FORM_block4) size = parse_u32(parse);
+        attr->value = (u64)parse_data(parse, size);
+
+        // Truncated blocks have no data
+        attr->size = attr->value ? size : 0;
+    } break;
+    default:
+        attr->value = parse_u64_form(parse, form);
+        break;
+    }
+}
+
+// A group of units that is parsed by a single job
+// Each job writes to its own arena, the results are merged afterwards.
+typedef struct {
+    Dwarf_File *dwarf;
+    u32 unit_start;
+    u32 unit_end;
+
+    // Only parse the unit DIE, used to find the address ranges of a unit
+    bool root_only;
+
+    // Local DIE and attribute arrays, local DIE 0 is unused like in Dwarf_File
+    Memory *mem;
+    u32 die_count;
+    u32 die_cap;
+    Dwarf_Die *dies;
+    u32 attr_count;
+    u32 attr_cap;
+    Dwarf_Attr *attrs;
+
+    // Offset of the local arrays in the merged arrays
+    u32 die_base;
+    u32 attr_base;
+
+    // Errors are thread local, so they are passed back here
+    char *error;
+} Dwarf_Load_Job;
 
-static void dwarf_load_die(Dwarf_File *dwarf, Dwarf_Abbrev_List *abbrev) {
-    Parse *parse = parse_new(dwarf->mem, dwarf->sect_info.data, dwarf->sect_info.size);
+// Parse all DIEs in a single unit and append them to the job's arrays
+static void dwarf_load_unit(Dwarf_Load_Job *job, u32 unit_index) {
+    Dwarf_File *dwarf = job->dwarf;
+    Dwarf_Unit *unit = dwarf->units + unit_index;
+    Dwarf_Abbrev_List *abbrev = unit->abbrev;
+    check_or(abbrev) return;
 
-    u32 unit_length = parse_u32(parse);
-    print("unit_length: ", unit_length);
-    check_or(unit_length < 0xfffffff0) return;
+    Buffer data = buf_slice(dwarf->sect_info, unit->offset, unit->size);
+    Parse parse = {.data = data.data, .size = data.size};
 
-    u16 version = parse_u16(parse);
-    print("version: ", version);
-    check_or(version == 5) return;
+    // Skip the header
+    parse.cursor = unit->offset_size == 8 ? 12 : 4;
+    u16 version = parse_u16(&parse);
+    if (version >= 5) parse.cursor += 2 + unit->offset_size;
+    if (version < 5) parse.cursor += 1 + unit->offset_size;
+    if (unit->unit_type == DW_UT_skeleton || unit->unit_type == DW_UT_split_compile) parse.cursor += 8;
+    if (unit->unit_type == DW_UT_type || unit->unit_type == DW_UT_split_type) parse.cursor += 8 + unit->offset_size;
 
-    u8 unit_type = parse_u8(parse);
-    print("unit_type: ", unit_type);
-    check_or(unit_type == DW_UT_compile) return;
+    u32 die_start = job->die_count;
 
-    u8 addr_size = parse_u8(parse);
-    print("addr_size: ", addr_size);
-    check_or(addr_size == 8) return;
+    // Last child at each depth, used to link siblings
+    u32 depth = 0;
+    u32 parent[256] = {};
+    u32 last_child[256] = {};
+    while (!parse_eof(&parse)) {
+        u64 offset = unit->offset + parse.cursor;
+        u64 code = parse_uleb128(&parse);
 
-    u32 debug_abbrev_offset = parse_u32(parse);
-    print("debug_abbrev_offset: ", debug_abbrev_offset);
-    check_or(debug_abbrev_offset == 0) return;
+        // Code 0 ends the list of children
+        if (code == 0) {
+            if (depth > 0) depth--;
+            continue;
+        }
 
-    while (1) {
-        if (parse_eof(parse)) break;
+        check_or(code < abbrev->count && abbrev->abbrev[code].tag) return;
+        Dwarf_Abbrev *die_abbrev = abbrev->abbrev + code;
 
-        u64 off = parse->cursor;
-        u64 die_abbrev_id = parse_uleb128(parse);
-        // 0 is reserved for alignment
-        if (die_abbrev_id == 0) continue;
+        u32 die_index = job->die_count;
+        Dwarf_Die *die = DWARF_PUSH(job->mem, job->dies, job->die_count, job->die_cap);
+        *die = (Dwarf_Die){};
+        die->offset = offset;
+        die->tag = die_abbrev->tag;
+        die->unit = unit_index;
+        die->parent = parent[depth];
+        die->attr_start = job->attr_count;
+        die->attr_count = die_abbrev->attr_count;
 
-        print("");
-        print("Abbrev: ", die_abbrev_id);
-        print("Offset: ", off);
+        if (last_child[depth]) job->dies[last_child[depth]].sibling = die_index;
+        else if (parent[depth]) job->dies[parent[depth]].child = die_index;
+        last_child[depth] = die_index;
 
-        Dwarf_Abbrev *die_abbrev = abbrev->abbrev + die_abbrev_id;
-        print(dwarf_tag_to_string(die_abbrev->tag));
         for (u32 i = 0; i < die_abbrev->attr_count; ++i) {
-            Dwarf_Abbrev_Attr *attr = die_abbrev->attr_list + i;
-            print(F_NoEOL, "  ", dwarf_attribute_type_to_string(attr->name), " ");
-            // fmt_pad_line(fout, 30, ' ');
-            print(F_NoEOL, dwarf_form_to_string(attr->form), " ");
-            // fmt_pad_line(fout, 55, ' ');
-
-            Dwarf_Die_Attr die_attr = {};
-            die_attr.name = attr->name;
-
-            switch (attr->form) {
-            case DW_FORM_strx:
-            case DW_FORM_strx1:
-            case DW_FORM_strx2:
-            case DW_FORM_strx4: {
-                u64 off = parse_u64_form(parse, attr->form);
-                print(F_NoEOL, "offset = ", off);
-                die_attr.value.str = "";
-            } break;
-            case DW_FORM_udata:
-            case DW_FORM_sdata:
-            case DW_FORM_data1:
-            case DW_FORM_data2:
-            case DW_FORM_data4:
-            case DW_FORM_data8:
-            case DW_FORM_data16:
-                die_attr.value.data = parse_u64_form(parse, attr->form);
-                print(F_NoEOL, "data = ", die_attr.value.data);
-                break;
-            case DW_FORM_sec_offset:
-                die_attr.value.data = parse_u32(parse); // ?
-                break;
-            case DW_FORM_addr:
-                if (addr_size == 8) die_attr.value.data = parse_u64(parse);
-                if (addr_size == 4) die_attr.value.data = parse_u32(parse);
-                print(F_NoEOL, "addr = ", die_attr.value.data);
-                break;
-            case DW_FORM_addrx:
-            case DW_FORM_addrx1:
-            case DW_FORM_addrx2:
-            case DW_FORM_addrx3:
-            case DW_FORM_addrx4: {
-                u64 data = parse_u64_form(parse, attr->form);
-                print(F_NoEOL, "addr = ", data);
-            } break;
-            case DW_FORM_ref_udata:
-            case DW_FORM_ref1:
-            case DW_FORM_ref2:
-            case DW_FORM_ref4:
-            case DW_FORM_ref8: {
-                u64 data = parse_u64_form(parse, attr->form);
-                print(F_NoEOL, "ref = ", data);
-            } break;
-            case DW_FORM_exprloc: {
-                u64 len = parse_uleb128(parse);
-                parse_data(parse, len);
-                print(F_NoEOL, "exprloc = ", len);
-            } break;
-            case DW_FORM_flag_present: {
-                print(F_NoEOL, "flag = ", 1);
-            } break;
-            case DW_FORM_flag: {
-                u8 present = parse_u8(parse);
-                print(F_NoEOL, "flag = ", present);
-            } break;
-            case DW_FORM_rnglistx: {
-                u64 ix = parse_uleb128(parse);
-                print(F_NoEOL, "range_ix = ", ix);
-            } break;
-
-            default: {
-                print(F_NoEOL, "?");
-                assert(0);
-            } break;
-            }
-            print("");
+            Dwarf_Attr *attr = DWARF_PUSH(job->mem, job->attrs, job->attr_count, job->attr_cap);
+            dwarf_parse_attr(&parse, unit, die_abbrev->attr_list + i, attr);
+        }
+        check_or(!parse.overrun) return;
+
+        if (job->root_only) return;
+
+        if (die_abbrev->has_children) {
+            check_or(depth + 1 < array_count(parent)) return;
+            depth++;
+            parent[depth] = die_index;
+            last_child[depth] = 0;
+        }
+    }
+    unit->die_start = die_start;
+    unit->die_count = job->die_count - die_start;
+}
+
+static void dwarf_load_job(void *user) {
+    Dwarf_Load_Job *job = user;
+    job->mem = mem_new();
+
+    // Index 0 is reserved to mean 'none'
+    *DWARF_PUSH(job->mem, job->dies, job->die_count, job->die_cap) = (Dwarf_Die){};
+    for (u32 i = job->unit_start; i < job->unit_end; ++i) {
+        dwarf_load_unit(job, i);
+        if (error) break;
+    }
+    job->error = error_pop();
+}
+
+// Scan all unit headers in .debug_info
+static void dwarf_load_units(Dwarf_File *dwarf) {
+    if (dwarf->units_loaded) return;
+    dwarf->units_loaded = true;
+
+    Buffer info = dwarf->sect_info;
+    Parse parse = {.data = info.data, .size = info.size};
+    u32 unit_cap = 0;
+
+    while (!parse_eof(&parse)) {
+        u64 offset = parse.cursor;
+        u8 offset_size = 4;
+        u64 length = parse_u32(&parse);
+
+        // 64-bit DWARF
+        if (length == 0xffffffff) {
+            offset_size = 8;
+            length = parse_u64(&parse);
+        }
+        check_or(length < 0xfffffff0 || offset_size == 8) return;
+
+        u64 header_size = parse.cursor - offset;
+        check_or(offset + header_size + length <= info.size) return;
+
+        Dwarf_Unit *unit = DWARF_PUSH(dwarf->mem, dwarf->units, dwarf->unit_count, unit_cap);
+        *unit = (Dwarf_Unit){};
+        unit->offset = offset;
+        unit->size = header_size + length;
+        unit->offset_size = offset_size;
+        unit->version = parse_u16(&parse);
+        check_or(unit->version >= 2 && unit->version <= 5) return;
+
+        if (unit->version >= 5) {
+            unit->unit_type = parse_u8(&parse);
+            unit->addr_size = parse_u8(&parse);
+            unit->abbrev_offset = parse_offset(&parse, offset_size);
+        } else {
+            unit->unit_type = DW_UT_compile;
+            unit->abbrev_offset = parse_offset(&parse, offset_size);
+            unit->addr_size = parse_u8(&parse);
         }
+        check_or(unit->addr_size == 4 || unit->addr_size == 8) return;
+        check_or(!parse.overrun) return;
+        parse.cursor = offset + unit->size;
+    }
+}
+
+static void dwarf_unit_load(Dwarf_File *dwarf, u32 unit_index);
+
+// Find the unit containing a .debug_info offset, returns unit_count if there is none
+static u32 dwarf_unit_index_at(Dwarf_File *dwarf, u64 offset) {
+    u32 lo = 0;
+    u32 hi = dwarf->unit_count;
+    while (lo < hi) {
+        u32 mid = lo + (hi - lo) / 2;
+        if (dwarf->units[mid].offset <= offset) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == 0) return dwarf->unit_count;
+    Dwarf_Unit *unit = dwarf->units + lo - 1;
+    if (offset >= unit->offset + unit->size) return dwarf->unit_count;
+    return lo - 1;
+}
+
+// Find the DIE at a given .debug_info offset, the unit is loaded if needed
+static u32 dwarf_die_at(Dwarf_File *dwarf, u64 offset) {
+    u32 unit_index = dwarf_unit_index_at(dwarf, offset);
+    if (unit_index == dwarf->unit_count) return 0;
+    dwarf_unit_load(dwarf, unit_index);
+
+    // DIEs in a unit are in .debug_info order
+    Dwarf_Unit *unit = dwarf->units + unit_index;
+    u32 lo = unit->die_start;
+    u32 hi = unit->die_start + unit->die_count;
+    while (lo < hi) {
+        u32 mid = lo + (hi - lo) / 2;
+        if (dwarf->dies[mid].offset < offset) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo < unit->die_start + unit->die_count && dwarf->dies[lo].offset == offset) return lo;
+    return 0;
+}
+
+// Read an entry from an index table like .debug_str_offsets or .debug_addr
+static u64 dwarf_read_index(Buffer table, u64 base, u64 index, u32 size) {
+    u64 offset = base + index * size;
+    check_or(offset + size <= table.size) return 0;
+    if (size == 8) return *(u64 *)(table.data + offset);
+    return *(u32 *)(table.data + offset);
+}
+
+static char *dwarf_str_at(Buffer sect, u64 offset) {
+    check_or(offset < sect.size) return "";
+    return (char *)sect.data + offset;
+}
+
+// Read the bases needed to resolve strx and addrx forms from the unit DIE
+static void dwarf_unit_bases(Dwarf_Unit *unit, Dwarf_Attr *attrs, u32 attr_count) {
+    for (u32 i = 0; i < attr_count; ++i) {
+        Dwarf_Attr *attr = attrs + i;
+        if (attr->name == DW_AT_str_offsets_base) unit->str_offsets_base = attr->value;
+        if (attr->name == DW_AT_addr_base) unit->addr_base = attr->value;
+        if (attr->name == DW_AT_rnglists_base) unit->rnglists_base = attr->value;
+    }
+}
+
+// Resolve the string, address or reference in a single attribute
+static void dwarf_resolve_attr(Dwarf_File *dwarf, Dwarf_Unit *unit, Dwarf_Attr *attr) {
+    switch (attr->form) {
+    case DW_FORM_strp:
+        attr->value = (u64)dwarf_str_at(dwarf->sect_str, attr->value);
+        break;
+    case DW_FORM_line_strp:
+        attr->value = (u64)dwarf_str_at(dwarf->sect_line_str, attr->value);
+        break;
+    case DW_FORM_strx:
+    case DW_FORM_strx1:
+    case DW_FORM_strx2:
+    case DW_FORM_strx3:
+    case DW_FORM_strx4: {
+        u64 offset = dwarf_read_index(dwarf->sect_str_offsets, unit->str_offsets_base, attr->value, unit->offset_size);
+        attr->value = (u64)dwarf_str_at(dwarf->sect_str, offset);
+    } break;
+    case DW_FORM_addrx:
+    case DW_FORM_addrx1:
+    case DW_FORM_addrx2:
+    case DW_FORM_addrx3:
+    case DW_FORM_addrx4:
+        attr->value = dwarf_read_index(dwarf->sect_addr, unit->addr_base, attr->value, unit->addr_size);
+        break;
+    case DW_FORM_ref1:
+    case DW_FORM_ref2:
+    case DW_FORM_ref4:
+    case DW_FORM_ref8:
+    case DW_FORM_ref_udata:
+        attr->value = dwarf_die_at(dwarf, unit->offset + attr->value);
+        break;
+    case DW_FORM_ref_addr:
+        attr->value = dwarf_die_at(dwarf, attr->value);
+        break;
+    default:
+        break;
+    }
+}
+
+// Resolve strings, addresses and references of all attributes in a unit
+static void dwarf_resolve_unit(Dwarf_File *dwarf, Dwarf_Unit *unit) {
+    if (unit->die_count == 0) return;
+    Dwarf_Die *root = dwarf->dies + unit->die_start;
+    dwarf_unit_bases(unit, dwarf->attrs + root->attr_start, root->attr_count);
+
+    // Attributes of a unit are contiguous
+    // References can load other units, which moves the arrays, so only use indices
+    Dwarf_Die *last = root + unit->die_count - 1;
+    u32 attr_start = root->attr_start;
+    u32 attr_end = last->attr_start + last->attr_count;
+    for (u32 i = attr_start; i < attr_end; ++i) {
+        Dwarf_Attr attr = dwarf->attrs[i];
+        dwarf_resolve_attr(dwarf, unit, &attr);
+        dwarf->attrs[i] = attr;
+    }
+
+    // Can be an addrx form, so only known after resolving
+    Dwarf_Attr *attrs = dwarf->attrs + attr_start;
+    for (u32 i = 0; i < dwarf->dies[unit->die_start].attr_count; ++i) {
+        if (attrs[i].name == DW_AT_low_pc) unit->low_pc = attrs[i].value;
+    }
+}
+
+// Find an attribute of a DIE
+static Dwarf_Attr *dwarf_attr(Dwarf_File *dwarf, Dwarf_Die *die, Dwarf_Attribute_Type name) {
+    for (u32 i = 0; i < die->attr_count; ++i) {
+        Dwarf_Attr *attr = dwarf->attrs + die->attr_start + i;
+        if (attr->name == name) return attr;
     }
+    return 0;
+}
+
+static bool dwarf_form_is_str(Dwarf_Form form) {
+    return form == DW_FORM_string || form == DW_FORM_strp || form == DW_FORM_line_strp || form == DW_FORM_strx ||
+           form == DW_FORM_strx1 || form == DW_FORM_strx2 || form == DW_FORM_strx3 || form == DW_FORM_strx4;
+}
+
+static bool dwarf_form_is_ref(Dwarf_Form form) {
+    return form == DW_FORM_ref1 || form == DW_FORM_ref2 || form == DW_FORM_ref4 || form == DW_FORM_ref8 ||
+           form == DW_FORM_ref_udata || form == DW_FORM_ref_addr;
+}
+
+// Get a string attribute, or null if it is not present
+static char *dwarf_attr_str(Dwarf_File *dwarf, Dwarf_Die *die, Dwarf_Attribute_Type name) {
+    Dwarf_Attr *attr = dwarf_attr(dwarf, die, name);
+    if (!attr || !dwarf_form_is_str(attr->form)) return 0;
+    return (char *)attr->value;
+}
+
+// Get a numeric attribute, or zero if it is not present
+static u64 dwarf_attr_u64(Dwarf_File *dwarf, Dwarf_Die *die, Dwarf_Attribute_Type name) {
+    Dwarf_Attr *attr = dwarf_attr(dwarf, die, name);
+    if (!attr) return 0;
+    return attr->value;
+}
+
+// Get the DIE an attribute refers to, or null
+static Dwarf_Die *dwarf_attr_ref(Dwarf_File *dwarf, Dwarf_Die *die, Dwarf_Attribute_Type name) {
+    Dwarf_Attr *attr = dwarf_attr(dwarf, die, name);
+    if (!attr || !dwarf_form_is_ref(attr->form) || !attr->value) return 0;
+    return dwarf->dies + attr->value;
+}
+
+// Tree navigation, returns null at the end
+static Dwarf_Die *dwarf_die_child(Dwarf_File *dwarf, Dwarf_Die *die) {
+    return die->child ? dwarf->dies + die->child : 0;
+}
+
+static Dwarf_Die *dwarf_die_sibling(Dwarf_File *dwarf, Dwarf_Die *die) {
+    return die->sibling ? dwarf->dies + die->sibling : 0;
 }
 
-static void dwarf_load(Memory *mem, Elf *elf) {
+static Dwarf_Die *dwarf_die_parent(Dwarf_File *dwarf, Dwarf_Die *die) {
+    return die->parent ? dwarf->dies + die->parent : 0;
+}
+
+// Copy the DIEs of a job into the merged arrays
+static void dwarf_merge_job(void *user) {
+    Dwarf_Load_Job *job = user;
+    Dwarf_File *dwarf = job->dwarf;
+    for (u32 i = 1; i < job->die_count; ++i) {
+        Dwarf_Die die = job->dies[i];
+        if (die.parent) die.parent += job->die_base;
+        if (die.child) die.child += job->die_base;
+        if (die.sibling) die.sibling += job->die_base;
+        die.attr_start += job->attr_base;
+        dwarf->dies[i + job->die_base] = die;
+    }
+    ptr_copy(dwarf->attrs + job->attr_base, job->attrs, job->attr_count * sizeof(Dwarf_Attr));
+
+    for (u32 i = job->unit_start; i < job->unit_end; ++i) {
+        dwarf->units[i].die_start += job->die_base;
+        dwarf->units[i].loaded = true;
+    }
+}
+
+static void dwarf_resolve_job(void *user) {
+    Dwarf_Load_Job *job = user;
+    for (u32 i = job->unit_start; i < job->unit_end; ++i) dwarf_resolve_unit(job->dwarf, job->dwarf->units + i);
+}
+
+// Load the DIE tree of all units
+// 1. Scan unit headers, this is fast because units can be skipped
+// 2. Parse groups of units in parallel, each in its own arena
+// 3. Merge the results and resolve references in parallel
+static void dwarf_load_die(Dwarf_File *dwarf, Job_System *jobs) {
+    dwarf_load_units(dwarf);
+    if (error) return;
+
+    // Abbreviation tables are shared, so load them before parsing in parallel
+    for (u32 i = 0; i < dwarf->unit_count; ++i) {
+        Dwarf_Unit *unit = dwarf->units + i;
+        unit->abbrev = dwarf_load_abbrev(dwarf, unit->abbrev_offset);
+        if (error) return;
+    }
+
+    // Split the units in groups of roughly equal size
+    Memory *tmp = mem_new();
+    u32 group_count = MAX(jobs->worker_count * 4, 1);
+    u64 group_size = dwarf->sect_info.size / group_count + 1;
+    Dwarf_Load_Job *group_list = mem_array_zero(tmp, Dwarf_Load_Job, dwarf->unit_count);
+    u32 job_count = 0;
+    for (u32 i = 0; i < dwarf->unit_count; ++i) {
+        Dwarf_Load_Job *job = job_count ? group_list + job_count - 1 : 0;
+        if (!job || dwarf->units[i].offset - dwarf->units[job->unit_start].offset >= group_size) {
+            job = group_list + job_count++;
+            job->dwarf = dwarf;
+            job->unit_start = i;
+        }
+        job->unit_end = i + 1;
+    }
+
+    u32 counter = 0;
+    for (u32 i = 0; i < job_count; ++i) job_push(jobs, &counter, dwarf_load_job, group_list + i);
+    job_wait(jobs, &counter);
+
+    // Index 0 is reserved to mean 'none'
+    dwarf->die_count = 1;
+    dwarf->attr_count = 0;
+    for (u32 i = 0; i < job_count; ++i) {
+        Dwarf_Load_Job *job = group_list + i;
+        if (job->error) error_set(job->error);
+        job->die_base = dwarf->die_count - 1;
+        job->attr_base = dwarf->attr_count;
+        dwarf->die_count += job->die_count - 1;
+        dwarf->attr_count += job->attr_count;
+    }
+
+    if (!error) {
+        dwarf->dies = mem_array(dwarf->mem, Dwarf_Die, dwarf->die_count);
+        dwarf->attrs = mem_array(dwarf->mem, Dwarf_Attr, dwarf->attr_count);
+        dwarf->die_cap = dwarf->die_count;
+        dwarf->attr_cap = dwarf->attr_count;
+        dwarf->dies[0] = (Dwarf_Die){};
+        for (u32 i = 0; i < job_count; ++i) job_push(jobs, &counter, dwarf_merge_job, group_list + i);
+        job_wait(jobs, &counter);
+
+        // References can point into other units, so resolve after everything is merged
+        for (u32 i = 0; i < job_count; ++i) job_push(jobs, &counter, dwarf_resolve_job, group_list + i);
+        job_wait(jobs, &counter);
+    }
+
+    for (u32 i = 0; i < job_count; ++i) mem_free(group_list[i].mem);
+    mem_free(tmp);
+}
+
+// Parse a single unit on demand and append it to the DIE arrays
+static void dwarf_unit_load(Dwarf_File *dwarf, u32 unit_index) {
+    Dwarf_Unit *unit = dwarf->units + unit_index;
+    if (unit->loaded) return;
+
+    // Set before resolving, references back into this unit should not load it again
+    unit->loaded = true;
+    if (!unit->abbrev) unit->abbrev = dwarf_load_abbrev(dwarf, unit->abbrev_offset);
+    if (error) return;
+
+    Dwarf_Load_Job job = {.dwarf = dwarf, .unit_start = unit_index, .unit_end = unit_index + 1};
+    dwarf_load_job(&job);
+    if (job.error) error_set(job.error);
+
+    if (!error) {
+        // Index 0 is reserved to mean 'none'
+        if (dwarf->die_count == 0) *DWARF_PUSH(dwarf->mem, dwarf->dies, dwarf->die_count, dwarf->die_cap) = (Dwarf_Die){};
+
+        DWARF_RESERVE(dwarf->mem, dwarf->dies, dwarf->die_count, dwarf->die_cap, job.die_count - 1);
+        DWARF_RESERVE(dwarf->mem, dwarf->attrs, dwarf->attr_count, dwarf->attr_cap, job.attr_count);
+        job.die_base = dwarf->die_count - 1;
+        job.attr_base = dwarf->attr_count;
+        dwarf->die_count += job.die_count - 1;
+        dwarf->attr_count += job.attr_count;
+        dwarf_merge_job(&job);
+        dwarf_resolve_unit(dwarf, unit);
+    }
+    mem_free(job.mem);
+}
+
+// Name of a DIE, which can also be stored in the declaration or in the abstract inline instance
+static char *dwarf_die_name(Dwarf_File *dwarf, Dwarf_Die *die) {
+    for (u32 i = 0; die && i < 8; ++i) {
+        char *name = dwarf_attr_str(dwarf, die, DW_AT_name);
+        if (name) return name;
+        Dwarf_Die *next = dwarf_attr_ref(dwarf, die, DW_AT_specification);
+        if (!next) next = dwarf_attr_ref(dwarf, die, DW_AT_abstract_origin);
+        die = next;
+    }
+    return 0;
+}
+
+// Location expression operations, only the ones giving a fixed address
+typedef enum {
+    DW_OP_addr = 0x03,
+    DW_OP_addrx = 0xa1,
+    DW_OP_GNU_addr_index = 0xfb,
+} Dwarf_Op;
+
+// Range list entries in .debug_rnglists
+typedef enum {
+    DW_RLE_end_of_list = 0x00,
+    DW_RLE_base_addressx = 0x01,
+    DW_RLE_startx_endx = 0x02,
+    DW_RLE_startx_length = 0x03,
+    DW_RLE_offset_pair = 0x04,
+    DW_RLE_base_address = 0x05,
+    DW_RLE_start_end = 0x06,
+    DW_RLE_start_length = 0x07,
+} Dwarf_Range_List_Entry;
+
+typedef struct {
+    u64 start;
+    u64 end;
+} Dwarf_Range;
+
+typedef struct {
+    Memory *mem;
+    u32 count;
+    u32 cap;
+    Dwarf_Range *ranges;
+} Dwarf_Range_List;
+
+static void dwarf_range_add(Dwarf_Range_List *list, u64 start, u64 end) {
+    // Code removed by the linker is moved to address 0
+    if (start == 0 || end <= start) return;
+    *DWARF_PUSH(list->mem, list->ranges, list->count, list->cap) = (Dwarf_Range){start, end};
+}
+
+static u64 dwarf_parse_addr(Parse *parse, Dwarf_Unit *unit) {
+    return unit->addr_size == 8 ? parse_u64(parse) : parse_u32(parse);
+}
+
+static u64 dwarf_addr_index(Dwarf_File *dwarf, Dwarf_Unit *unit, u64 index) {
+    return dwarf_read_index(dwarf->sect_addr, unit->addr_base, index, unit->addr_size);
+}
+
+// Read a DWARF 5 range list from .debug_rnglists
+static void dwarf_read_rnglist(Dwarf_File *dwarf, Dwarf_Unit *unit, u64 offset, Dwarf_Range_List *list) {
+    Buffer sect = dwarf->sect_rnglists;
+    check_or(offset < sect.size) return;
+
+    Parse parse = {.data = sect.data, .cursor = offset, .size = sect.size};
+    u64 base = unit->low_pc;
+    while (!parse_eof(&parse)) {
+        u8 kind = parse_u8(&parse);
+        if (kind == DW_RLE_end_of_list) break;
+
+        if (kind == DW_RLE_base_addressx) {
+            base = dwarf_addr_index(dwarf, unit, parse_uleb128(&parse));
+        } else if (kind == DW_RLE_base_address) {
+            base = dwarf_parse_addr(&parse, unit);
+        } else if (kind == DW_RLE_startx_endx) {
+            u64 start = dwarf_addr_index(dwarf, unit, parse_uleb128(&parse));
+            u64 end = dwarf_addr_index(dwarf, unit, parse_uleb128(&parse));
+            dwarf_range_add(list, start, end);
+        } else if (kind == DW_RLE_startx_length) {
+            u64 start = dwarf_addr_index(dwarf, unit, parse_uleb128(&parse));
+            dwarf_range_add(list, start, start + parse_uleb128(&parse));
+        } else if (kind == DW_RLE_offset_pair) {
+            u64 start = base + parse_uleb128(&parse);
+            dwarf_range_add(list, start, base + parse_uleb128(&parse));
+        } else if (kind == DW_RLE_start_end) {
+            u64 start = dwarf_parse_addr(&parse, unit);
+            dwarf_range_add(list, start, dwarf_parse_addr(&parse, unit));
+        } else if (kind == DW_RLE_start_length) {
+            u64 start = dwarf_parse_addr(&parse, unit);
+            dwarf_range_add(list, start, start + parse_uleb128(&parse));
+        } else {
+            error_set("Unsupported DWARF range list entry");
+            break;
+        }
+    }
+    check(!parse.overrun);
+}
+
+// Read a DWARF 2 to 4 range list from .debug_ranges
+static void dwarf_read_ranges(Dwarf_File *dwarf, Dwarf_Unit *unit, u64 offset, Dwarf_Range_List *list) {
+    Buffer sect = dwarf->sect_ranges;
+    check_or(offset < sect.size) return;
+
+    Parse parse = {.data = sect.data, .cursor = offset, .size = sect.size};
+    u64 base = unit->low_pc;
+    u64 max = unit->addr_size == 8 ? U64_MAX : U32_MAX;
+    while (!parse_eof(&parse)) {
+        u64 start = dwarf_parse_addr(&parse, unit);
+        u64 end = dwarf_parse_addr(&parse, unit);
+        if (start == 0 && end == 0) break;
+
+        // Base address selection entry
+        if (start == max) {
+            base = end;
+            continue;
+        }
+        dwarf_range_add(list, base + start, base + end);
+    }
+    check(!parse.overrun);
+}
+
+// Add the address ranges described by the low_pc, high_pc and ranges attributes
+// - The attributes should be resolved, missing attributes can be null
+static void dwarf_attr_ranges(Dwarf_File *dwarf, Dwarf_Unit *unit, Dwarf_Attr *low_pc, Dwarf_Attr *high_pc, Dwarf_Attr *ranges, Dwarf_Range_List *list) {
+    if (ranges && unit->version >= 5) {
+        u64 offset = ranges->value;
+        if (ranges->form == DW_FORM_rnglistx) {
+            offset = unit->rnglists_base + dwarf_read_index(dwarf->sect_rnglists, unit->rnglists_base, offset, unit->offset_size);
+        }
+        dwarf_read_rnglist(dwarf, unit, offset, list);
+        return;
+    }
+
+    if (ranges) {
+        dwarf_read_ranges(dwarf, unit, ranges->value, list);
+        return;
+    }
+
+    if (!low_pc || !high_pc) return;
+
+    // High pc is either an address or a size
+    u64 end = high_pc->value;
+    bool is_addr = high_pc->form == DW_FORM_addr || high_pc->form == DW_FORM_addrx || high_pc->form == DW_FORM_addrx1 ||
+                   high_pc->form == DW_FORM_addrx2 || high_pc->form == DW_FORM_addrx3 || high_pc->form == DW_FORM_addrx4;
+    if (!is_addr) end += low_pc->value;
+    dwarf_range_add(list, low_pc->value, end);
+}
+
+// Add the address ranges of a DIE
+static void dwarf_die_ranges(Dwarf_File *dwarf, Dwarf_Die *die, Dwarf_Range_List *list) {
+    Dwarf_Attr *low_pc = dwarf_attr(dwarf, die, DW_AT_low_pc);
+    Dwarf_Attr *high_pc = dwarf_attr(dwarf, die, DW_AT_high_pc);
+    Dwarf_Attr *ranges = dwarf_attr(dwarf, die, DW_AT_ranges);
+    dwarf_attr_ranges(dwarf, dwarf->units + die->unit, low_pc, high_pc, ranges, list);
+}
+
+typedef struct Dwarf_Unit_Range Dwarf_Unit_Range;
+struct Dwarf_Unit_Range {
+    u64 start;
+    u64 end;
+    u32 unit;
+};
+
+static i32 dwarf_unit_range_cmp(void *a, void *b) {
+    Dwarf_Unit_Range *range_a = a;
+    Dwarf_Unit_Range *range_b = b;
+    if (range_a->start == range_b->start) return 0;
+    return range_a->start < range_b->start ? -1 : 1;
+}
+
+// Read the address ranges of units from .debug_aranges
+static void dwarf_load_aranges(Dwarf_File *dwarf, bool *covered, u32 *cap) {
+    Buffer sect = dwarf->sect_aranges;
+    Parse parse = {.data = sect.data, .size = sect.size};
+    while (!parse_eof(&parse)) {
+        u64 set_start = parse.cursor;
+        u8 offset_size = 4;
+        u64 length = parse_u32(&parse);
+        if (length == 0xffffffff) {
+            offset_size = 8;
+            length = parse_u64(&parse);
+        }
+        u64 set_end = parse.cursor + length;
+        check_or(set_end <= sect.size) return;
+
+        parse_u16(&parse); // version
+        u64 info_offset = parse_offset(&parse, offset_size);
+        u8 addr_size = parse_u8(&parse);
+        u8 segment_size = parse_u8(&parse);
+        check_or((addr_size == 4 || addr_size == 8) && segment_size == 0) return;
+
+        // Tuples are aligned to twice the address size
+        u64 align = addr_size * 2;
+        parse.cursor = set_start + (parse.cursor - set_start + align - 1) / align * align;
+
+        u32 unit_index = dwarf_unit_index_at(dwarf, info_offset);
+        while (parse.cursor + align <= set_end && unit_index < dwarf->unit_count) {
+            u64 start = addr_size == 8 ? parse_u64(&parse) : parse_u32(&parse);
+            u64 size = addr_size == 8 ? parse_u64(&parse) : parse_u32(&parse);
+            if (start == 0 && size == 0) break;
+            if (start == 0 || size == 0) continue;
+
+            Dwarf_Unit_Range *range = DWARF_PUSH(dwarf->mem, dwarf->unit_ranges, dwarf->unit_range_count, *cap);
+            *range = (Dwarf_Unit_Range){start, start + size, unit_index};
+            covered[unit_index] = true;
+        }
+        check_or(!parse.overrun) return;
+        parse.cursor = set_end;
+    }
+}
+
+// Read the address ranges of a unit from its unit DIE, without loading the other DIEs
+static void dwarf_unit_root_ranges(Dwarf_File *dwarf, u32 unit_index, Dwarf_Range_List *list) {
+    Dwarf_Unit *unit = dwarf->units + unit_index;
+    if (!unit->abbrev) unit->abbrev = dwarf_load_abbrev(dwarf, unit->abbrev_offset);
+    if (error) return;
+
+    Dwarf_Load_Job job = {.dwarf = dwarf, .unit_start = unit_index, .unit_end = unit_index + 1, .root_only = true};
+    dwarf_load_job(&job);
+    if (job.error) error_set(job.error);
+
+    if (!error && job.die_count == 2) {
+        Dwarf_Attr *attrs = job.attrs + job.dies[1].attr_start;
+        u32 attr_count = job.dies[1].attr_count;
+        dwarf_unit_bases(unit, attrs, attr_count);
+
+        Dwarf_Attr *low_pc = 0, *high_pc = 0, *ranges = 0;
+        for (u32 i = 0; i < attr_count; ++i) {
+            Dwarf_Attr *attr = attrs + i;
+            if (attr->name == DW_AT_low_pc) low_pc = attr;
+            if (attr->name == DW_AT_high_pc) high_pc = attr;
+            if (attr->name == DW_AT_ranges) ranges = attr;
+        }
+
+        // Only address forms, so this never loads other units
+        if (low_pc) dwarf_resolve_attr(dwarf, unit, low_pc);
+        if (high_pc) dwarf_resolve_attr(dwarf, unit, high_pc);
+        if (low_pc) unit->low_pc = low_pc->value;
+        dwarf_attr_ranges(dwarf, unit, low_pc, high_pc, ranges, list);
+    }
+    mem_free(job.mem);
+}
+
+// Build the index of unit address ranges
+// .debug_aranges is used when present, other units are found through their unit DIE.
+static void dwarf_load_unit_ranges(Dwarf_File *dwarf) {
+    if (dwarf->unit_ranges_loaded) return;
+    dwarf->unit_ranges_loaded = true;
+    dwarf_load_units(dwarf);
+
+    Memory *tmp = mem_new();
+    u32 cap = 0;
+    bool *covered = mem_array_zero(tmp, bool, dwarf->unit_count);
+    dwarf_load_aranges(dwarf, covered, &cap);
+
+    for (u32 i = 0; i < dwarf->unit_count && !error; ++i) {
+        if (covered[i]) continue;
+        Dwarf_Range_List list = {.mem = tmp};
+        dwarf_unit_root_ranges(dwarf, i, &list);
+        for (u32 j = 0; j < list.count; ++j) {
+            Dwarf_Unit_Range *range = DWARF_PUSH(dwarf->mem, dwarf->unit_ranges, dwarf->unit_range_count, cap);
+            *range = (Dwarf_Unit_Range){list.ranges[j].start, list.ranges[j].end, i};
+        }
+    }
+    sort_array(dwarf->unit_ranges, dwarf->unit_range_count, sizeof(Dwarf_Unit_Range), dwarf_unit_range_cmp);
+    mem_free(tmp);
+}
+
+// Find and load the unit containing an address, or null
+static Dwarf_Unit *dwarf_unit_at(Dwarf_File *dwarf, u64 addr) {
+    dwarf_load_unit_ranges(dwarf);
+
+    // Find the first range starting after 'addr'
+    u32 lo = 0;
+    u32 hi = dwarf->unit_range_count;
+    while (lo < hi) {
+        u32 mid = lo + (hi - lo) / 2;
+        if (dwarf->unit_ranges[mid].start <= addr) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == 0) return 0;
+
+    Dwarf_Unit_Range *range = dwarf->unit_ranges + lo - 1;
+    if (addr >= range->end) return 0;
+    dwarf_unit_load(dwarf, range->unit);
+    return dwarf->units + range->unit;
+}
+
+// Find the function containing an address, only the unit containing it is loaded
+static Dwarf_Die *dwarf_subprogram_at(Dwarf_File *dwarf, u64 addr) {
+    Dwarf_Unit *unit = dwarf_unit_at(dwarf, addr);
+    if (!unit) return 0;
+
+    Memory *tmp = mem_new();
+    Dwarf_Die *result = 0;
+    for (u32 i = 0; i < unit->die_count && !result; ++i) {
+        Dwarf_Die *die = dwarf->dies + unit->die_start + i;
+        if (die->tag != DW_TAG_subprogram) continue;
+
+        Dwarf_Range_List list = {.mem = tmp};
+        dwarf_die_ranges(dwarf, die, &list);
+        for (u32 j = 0; j < list.count; ++j) {
+            if (addr >= list.ranges[j].start && addr < list.ranges[j].end) result = die;
+        }
+    }
+    mem_free(tmp);
+    return result;
+}
+
+// Load all debug info using the given job system
+static Dwarf_File *dwarf_load_with(Memory *mem, Elf *elf, Job_System *jobs) {
+    elf_decompress_sections(elf, jobs);
+    if (error) return 0;
     Dwarf_File *dwarf = dwarf_open(mem, elf);
+    if (error) return 0;
+    dwarf_load_die(dwarf, jobs);
+    if (error) return 0;
+    return dwarf;
+}
+
+// Load all debug info using one thread per cpu core
+static Dwarf_File *dwarf_load(Memory *mem, Elf *elf) {
+    Memory *tmp = mem_new();
+    Job_System *jobs = job_system_new(tmp, 0);
+    Dwarf_File *dwarf = dwarf_load_with(mem, elf, jobs);
+    job_system_free(jobs);
+    mem_free(tmp);
+    return dwarf;
+}
+
+// Print a DIE and all its children
+static void dwarf_print_die(Dwarf_File *dwarf, Dwarf_Die *die, u32 depth) {
+    for (; die; die = dwarf_die_sibling(dwarf, die)) {
+        char *name = dwarf_attr_str(dwarf, die, DW_AT_name);
+        for (u32 i = 0; i < depth; ++i) print(F_NoEOL, "  ");
+        print(dwarf_tag_to_string(die->tag), " ", name ?: "");
+        dwarf_print_die(dwarf, dwarf_die_child(dwarf, die), depth + 1);
+    }
+}
+
+// Find a DIE by tag and name
+static Dwarf_Die *dwarf_find(Dwarf_File *dwarf, Dwarf_Tag tag, char *name) {
+    for (u32 i = 1; i < dwarf->die_count; ++i) {
+        Dwarf_Die *die = dwarf->dies + i;
+        if (die->tag != tag) continue;
+        char *die_name = dwarf_attr_str(dwarf, die, DW_AT_name);
+        if (die_name && str_eq(die_name, name)) return die;
+    }
+    return 0;
+}
+
+static void test_dwarf(void) {
+    if (!OS_LINUX) return;
+
+    // Read our own debug info
+    Memory *mem = mem_new();
+    File *file = fs_open("/proc/self/exe", FileMode_Read);
+    Elf *elf = elf_load(mem, file);
+    if (!elf || !elf_find_section(elf, ".debug_info")) {
+        // Built without debug info
+        if (elf) elf_close(elf);
+        else if (file) io_close(file);
+        mem_free(mem);
+        return;
+    }
+
+    Dwarf_File *dwarf = dwarf_load(mem, elf);
+    check_or(dwarf && dwarf->unit_count >= 1) {
+        elf_close(elf);
+        mem_free(mem);
+        return;
+    }
+
+    // This function should be a child of a compile unit
+    Dwarf_Die *fn = dwarf_find(dwarf, DW_TAG_subprogram, "test_dwarf");
+    check(fn);
+    check(fn && dwarf_die_parent(dwarf, fn)->tag == DW_TAG_compile_unit);
+
+    // References are resolved to DIEs
+    Dwarf_Die *type = dwarf_find(dwarf, DW_TAG_typedef, "Dwarf_File");
+    Dwarf_Die *target = type ? dwarf_attr_ref(dwarf, type, DW_AT_type) : 0;
+    check(target && target->tag == DW_TAG_structure_type);
+
+    // Children are linked through siblings
+    u32 member_count = 0;
+    for (Dwarf_Die *m = target ? dwarf_die_child(dwarf, target) : 0; m; m = dwarf_die_sibling(dwarf, m)) {
+        check(m->tag == DW_TAG_member);
+        member_count++;
+    }
+    check(member_count > 4);
+
+    // Lazy loading finds the same function
+    u64 low_pc = fn ? dwarf_attr_u64(dwarf, fn, DW_AT_low_pc) : 0;
+    Dwarf_File *lazy = dwarf_open(mem, elf);
+    Dwarf_Die *lazy_fn = dwarf_subprogram_at(lazy, low_pc + 1);
+    check(lazy_fn && fn && lazy_fn->offset == fn->offset);
+    check(lazy_fn && str_eq(dwarf_die_name(lazy, lazy_fn), "test_dwarf"));
+    check(!dwarf_subprogram_at(lazy, 0));
 
-    // Load abbreviation list
-    Dwarf_Abbrev_List abbrev = dwarf_load_abbrev(dwarf);
-    dwarf_load_die(dwarf, &abbrev);
+    elf_close(elf);
+    mem_free(mem);
 }
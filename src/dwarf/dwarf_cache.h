@@ -0,0 +1,471 @@
+// Copyright (c) 2026 - Tom Smeets <tom@tsmeets.nl>
+// dwarf_cache.h - On-disk cache of the line, function and type indices
+#pragma once
+#include "dwarf.h"
+#include "dwarf_func.h"
+#include "dwarf_line.h"
+#include "fs.h"
+#include "sort.h"
+#include "write.h"
+
+// Usage:
+//   Dwarf_Cache *cache = dwarf_cache_load(mem, elf, path, cache_path);
+//   Dwarf_Line line = dwarf_cache_line(cache, addr);
+//   Dwarf_Cache_Func *func = dwarf_cache_func(cache, addr);
+//   if (func) print(dwarf_cache_str(cache, func->name));
+//
+// The cache file is a header followed by flat arrays. Strings are stored
+// as offsets into a single string table, so the file can be mapped and
+// searched directly without parsing or relocation.
+//
+// The file is only used when the build id, modification time and size of
+// the ELF file match. Otherwise the indices are built from the debug info
+// and the cache is written again.
+
+// Function address range, sorted by 'start' and not overlapping
+typedef struct {
+    u64 start;
+    u64 end;
+
+    // Offset of the DW_TAG_subprogram in .debug_info, or 0 if found in the symbol table
+    u64 die;
+    u32 name;
+    u32 reserved;
+} Dwarf_Cache_Func;
+
+// Named type, sorted by name
+typedef struct {
+    u32 name;
+    u32 tag; // Dwarf_Tag
+    u64 size;
+
+    // Offset of the DIE in .debug_info
+    u64 die;
+} Dwarf_Cache_Type;
+
+// Identifies the ELF file the cache was created from
+typedef struct {
+    u8 build_id[32];
+    u32 build_id_size;
+    u32 reserved;
+    u64 mtime;
+    u64 size;
+} Dwarf_Cache_Key;
+
+typedef struct {
+    u64 offset; // From the start of the file, aligned to 8 bytes
+    u64 count;
+} Dwarf_Cache_Table;
+
+typedef struct {
+    u8 magic[8];
+    u32 version;
+    u32 reserved;
+    Dwarf_Cache_Key key;
+
+    // Size of .debug_info, all DIE offsets are below it
+    u64 info_size;
+
+    // Line table, see Dwarf_Lines
+    Dwarf_Cache_Table rows;
+    Dwarf_Cache_Table eytz_addr;
+    Dwarf_Cache_Table eytz_row;
+    Dwarf_Cache_Table files; // u32 string offsets
+
+    Dwarf_Cache_Table funcs;
+    Dwarf_Cache_Table types;
+    Dwarf_Cache_Table strings;
+} Dwarf_Cache_Header;
+
+#define DWARF_CACHE_VERSION 2
+
+typedef struct {
+    // The whole cache file, mapped or in memory
+    Buffer data;
+    File *file;
+
+    // Only the file names are copied, everything else points into 'data'
+    Dwarf_Lines lines;
+
+    u32 func_count;
+    Dwarf_Cache_Func *funcs;
+
+    u32 type_count;
+    Dwarf_Cache_Type *types;
+
+    // Zero terminated strings
+    Buffer strings;
+} Dwarf_Cache;
+
+static bool dwarf_cache_is_type(Dwarf_Tag tag) {
+    return tag == DW_TAG_structure_type || tag == DW_TAG_union_type || tag == DW_TAG_class_type ||
+           tag == DW_TAG_enumeration_type || tag == DW_TAG_typedef || tag == DW_TAG_base_type;
+}
+
+// Get a string from the string table, or null when out of bounds
+static char *dwarf_cache_str(Dwarf_Cache *cache, u32 offset) {
+    if (offset >= cache->strings.size) return 0;
+    return (char *)cache->strings.data + offset;
+}
+
+// Compute the key of an ELF file at 'path'
+static Dwarf_Cache_Key dwarf_cache_key(Elf *elf, char *path) {
+    Dwarf_Cache_Key key = {};
+    Memory *tmp = mem_new();
+    Buffer build_id = elf_build_id(tmp, elf);
+    key.build_id_size = MIN(build_id.size, sizeof(key.build_id));
+    ptr_copy(key.build_id, build_id.data, key.build_id_size);
+    mem_free(tmp);
+
+    FileInfo info = fs_stat(path);
+    key.mtime = info.mtime;
+    key.size = info.size;
+    return key;
+}
+
+// Get a table from the file if it is in bounds
+static void *dwarf_cache_table(Buffer data, Dwarf_Cache_Table table, u64 elem_size) {
+    check_or(table.offset % 8 == 0 && table.offset <= data.size) return 0;
+    check_or(table.count <= (data.size - table.offset) / elem_size) return 0;
+    return data.data + table.offset;
+}
+
+// Use a cache file in memory, returns null if it does not match 'key'
+// - All indices and string offsets are checked here, so lookups can use them directly
+// - A matching file with invalid tables also sets 'error'
+static Dwarf_Cache *dwarf_cache_from(Memory *mem, Buffer data, Dwarf_Cache_Key key) {
+    if (data.size < sizeof(Dwarf_Cache_Header)) return 0;
+    Dwarf_Cache_Header *header = (Dwarf_Cache_Header *)data.data;
+    if (!ptr_eq(header->magic, "tl-dwarf", 8)) return 0;
+    if (header->version != DWARF_CACHE_VERSION) return 0;
+    if (!ptr_eq(&header->key, &key, sizeof(key))) return 0;
+
+    Dwarf_Cache *cache = mem_struct(mem, Dwarf_Cache);
+    cache->data = data;
+
+    Dwarf_Lines *lines = &cache->lines;
+    lines->row_count = header->rows.count;
+    lines->rows = dwarf_cache_table(data, header->rows, sizeof(Dwarf_Line_Row));
+    lines->eytz_addr = dwarf_cache_table(data, header->eytz_addr, sizeof(u64));
+    lines->eytz_row = dwarf_cache_table(data, header->eytz_row, sizeof(u32));
+    u32 *files = dwarf_cache_table(data, header->files, sizeof(u32));
+    cache->func_count = header->funcs.count;
+    cache->funcs = dwarf_cache_table(data, header->funcs, sizeof(Dwarf_Cache_Func));
+    cache->type_count = header->types.count;
+    cache->types = dwarf_cache_table(data, header->types, sizeof(Dwarf_Cache_Type));
+    u8 *strings = dwarf_cache_table(data, header->strings, 1);
+    cache->strings = (Buffer){strings, header->strings.count};
+
+    check_or(lines->rows && lines->eytz_addr && lines->eytz_row && files && cache->funcs && cache->types && strings) return 0;
+    check_or(header->rows.count < U32_MAX && header->funcs.count <= U32_MAX && header->types.count <= U32_MAX) return 0;
+
+    // Every string must be terminated, so the table ends with zero
+    check(cache->strings.size && strings[cache->strings.size - 1] == 0);
+    check(header->eytz_addr.count == lines->row_count + 1 && header->eytz_row.count == lines->row_count + 1);
+    if (error) return 0;
+
+    // Search tree nodes start at 1 and point one past the row they select
+    for (u32 i = 1; i <= lines->row_count; ++i) {
+        check_or(lines->eytz_row[i] <= lines->row_count) return 0;
+    }
+
+    for (u32 i = 0; i < cache->func_count; ++i) {
+        Dwarf_Cache_Func *func = cache->funcs + i;
+        // Functions from the symbol table have no DIE
+        check_or(func->name < cache->strings.size && (!func->die || func->die < header->info_size)) return 0;
+    }
+
+    for (u32 i = 0; i < cache->type_count; ++i) {
+        Dwarf_Cache_Type *type = cache->types + i;
+        check_or(type->name < cache->strings.size && type->die < header->info_size) return 0;
+    }
+
+    lines->file_count = header->files.count;
+    lines->files = mem_array(mem, char *, lines->file_count);
+    for (u32 i = 0; i < lines->file_count; ++i) {
+        check_or(files[i] < cache->strings.size) return 0;
+        lines->files[i] = dwarf_cache_str(cache, files[i]);
+    }
+    return cache;
+}
+
+// Map a cache file, returns null if it is missing or does not match 'key'
+static Dwarf_Cache *dwarf_cache_open(Memory *mem, char *path, Dwarf_Cache_Key key) {
+    if (!fs_exists(path)) return 0;
+    File *file = fs_open(path, FileMode_Read);
+    if (error) return 0;
+
+    Buffer data = io_map(file);
+    Dwarf_Cache *cache = data.data ? dwarf_cache_from(mem, data, key) : 0;
+    if (!cache) {
+        io_unmap(data);
+        io_close(file);
+        return 0;
+    }
+
+    cache->file = file;
+    return cache;
+}
+
+static void dwarf_cache_close(Dwarf_Cache *cache) {
+    if (!cache->file) return;
+    io_unmap(cache->data);
+    io_close(cache->file);
+}
+
+static u32 dwarf_cache_str_add(Write *strings, char *str) {
+    if (!str) return 0;
+    u32 offset = write_cursor(strings);
+    write_buffer(strings, str_buf(str));
+    write_u8(strings, 0);
+    return offset;
+}
+
+// Append an array, aligned to 8 bytes
+static Dwarf_Cache_Table dwarf_cache_write_table(Write *output, void *data, u64 count, u64 elem_size) {
+    while (write_cursor(output) % 8) write_u8(output, 0);
+    Dwarf_Cache_Table table = {write_cursor(output), count};
+    write_buffer(output, (Buffer){data, count * elem_size});
+    return table;
+}
+
+// A type with its name before it is added to the string table
+typedef struct {
+    char *name;
+    Dwarf_Cache_Type type;
+} Dwarf_Cache_Type_Entry;
+
+static i32 dwarf_cache_type_cmp(void *a, void *b) {
+    Dwarf_Cache_Type_Entry *entry_a = a;
+    Dwarf_Cache_Type_Entry *entry_b = b;
+    return str_compare(entry_a->name, entry_b->name);
+}
+
+// Build the cache file contents from fully loaded debug info
+static Buffer dwarf_cache_build(Memory *mem, Dwarf_File *dwarf, Dwarf_Cache_Key key) {
+    Dwarf_Lines *lines = dwarf_load_lines(dwarf);
+    Dwarf_Funcs *funcs = dwarf_load_funcs(dwarf);
+    if (error) return buf_null();
+
+    Memory *tmp = mem_new();
+    Write *strings = write_new(tmp);
+    write_u8(strings, 0);
+
+    u32 *files = mem_array(tmp, u32, lines->file_count);
+    for (u32 i = 0; i < lines->file_count; ++i) files[i] = dwarf_cache_str_add(strings, lines->files[i]);
+
+    Dwarf_Cache_Func *func_list = mem_array_zero(tmp, Dwarf_Cache_Func, funcs->count);
+    for (u32 i = 0; i < funcs->count; ++i) {
+        Dwarf_Func *func = funcs->funcs + i;
+        Dwarf_Cache_Func *out = func_list + i;
+        out->start = func->start;
+        out->end = func->end;
+        out->die = func->die ? dwarf->dies[func->die].offset : 0;
+        out->name = dwarf_cache_str_add(strings, func->name);
+    }
+
+    // Named type definitions, declarations have no layout
+    u32 type_count = 0;
+    u32 type_cap = 0;
+    Dwarf_Cache_Type_Entry *entry_list = 0;
+    for (u32 i = 1; i < dwarf->die_count; ++i) {
+        Dwarf_Die *die = dwarf->dies + i;
+        if (!dwarf_cache_is_type(die->tag) || dwarf_attr(dwarf, die, DW_AT_declaration)) continue;
+        char *name = dwarf_attr_str(dwarf, die, DW_AT_name);
+        if (!name) continue;
+
+        Dwarf_Cache_Type_Entry *entry = DWARF_PUSH(tmp, entry_list, type_count, type_cap);
+        *entry = (Dwarf_Cache_Type_Entry){name, {.tag = die->tag, .die = die->offset}};
+        entry->type.size = dwarf_attr_u64(dwarf, die, DW_AT_byte_size);
+    }
+    sort_array(entry_list, type_count, sizeof(Dwarf_Cache_Type_Entry), dwarf_cache_type_cmp);
+
+    Dwarf_Cache_Type *type_list = mem_array(tmp, Dwarf_Cache_Type, type_count);
+    for (u32 i = 0; i < type_count; ++i) {
+        type_list[i] = entry_list[i].type;
+        type_list[i].name = dwarf_cache_str_add(strings, entry_list[i].name);
+    }
+
+    Dwarf_Cache_Header header = {.version = DWARF_CACHE_VERSION, .key = key, .info_size = dwarf->sect_info.size};
+    ptr_copy(header.magic, "tl-dwarf", 8);
+
+    Write *output = write_new(mem);
+    write_buffer(output, buf_from_struct(&header));
+    header.rows = dwarf_cache_write_table(output, lines->rows, lines->row_count, sizeof(Dwarf_Line_Row));
+    header.eytz_addr = dwarf_cache_write_table(output, lines->eytz_addr, lines->row_count + 1, sizeof(u64));
+    header.eytz_row = dwarf_cache_write_table(output, lines->eytz_row, lines->row_count + 1, sizeof(u32));
+    header.files = dwarf_cache_write_table(output, files, lines->file_count, sizeof(u32));
+    header.funcs = dwarf_cache_write_table(output, func_list, funcs->count, sizeof(Dwarf_Cache_Func));
+    header.types = dwarf_cache_write_table(output, type_list, type_count, sizeof(Dwarf_Cache_Type));
+    Buffer str_table = write_get_written(strings);
+    header.strings = dwarf_cache_write_table(output, str_table.data, str_table.size, 1);
+
+    Buffer result = write_get_written(output);
+    ptr_copy(result.data, &header, sizeof(header));
+    mem_free(tmp);
+    return result;
+}
+
+// Open the cache for the ELF file at 'path', or rebuild it when it is missing or stale
+// - A cache that can't be written is still returned
+static Dwarf_Cache *dwarf_cache_load(Memory *mem, Elf *elf, char *path, char *cache_path) {
+    Dwarf_Cache_Key key = dwarf_cache_key(elf, path);
+    if (error) return 0;
+
+    Dwarf_Cache *cache = dwarf_cache_open(mem, cache_path, key);
+    if (cache) return cache;
+
+    // An unreadable or corrupt cache is rebuilt
+    if (error) error_pop();
+
+    // The full index is only needed to write the cache
+    Memory *tmp = mem_new();
+    Dwarf_File *dwarf = dwarf_load(tmp, elf);
+    Buffer data = error ? buf_null() : dwarf_cache_build(tmp, dwarf, key);
+    if (error) {
+        mem_free(tmp);
+        return 0;
+    }
+
+    fs_write(cache_path, data);
+    error_pop();
+
+    // Keep only the cache itself
+    Buffer copy = mem_buffer(mem, data.size);
+    ptr_copy(copy.data, data.data, data.size);
+    mem_free(tmp);
+    return dwarf_cache_from(mem, copy, key);
+}
+
+// Find the source line of an address
+static Dwarf_Line dwarf_cache_line(Dwarf_Cache *cache, u64 addr) {
+    return dwarf_lines_find(&cache->lines, addr);
+}
+
+// Find the function containing an address, or null
+static Dwarf_Cache_Func *dwarf_cache_func(Dwarf_Cache *cache, u64 addr) {
+    u32 low = 0;
+    u32 high = cache->func_count;
+    while (low < high) {
+        u32 mid = low + (high - low) / 2;
+        if (cache->funcs[mid].start <= addr) low = mid + 1;
+        else high = mid;
+    }
+
+    if (low == 0) return 0;
+    Dwarf_Cache_Func *func = cache->funcs + low - 1;
+    return addr < func->end ? func : 0;
+}
+
+// Find a type definition by name, or null
+static Dwarf_Cache_Type *dwarf_cache_type(Dwarf_Cache *cache, char *name) {
+    u32 low = 0;
+    u32 high = cache->type_count;
+    while (low < high) {
+        u32 mid = low + (high - low) / 2;
+        char *mid_name = dwarf_cache_str(cache, cache->types[mid].name);
+        if (mid_name && str_compare(mid_name, name) < 0) low = mid + 1;
+        else high = mid;
+    }
+
+    if (low == cache->type_count) return 0;
+    Dwarf_Cache_Type *type = cache->types + low;
+    char *type_name = dwarf_cache_str(cache, type->name);
+    return type_name && str_eq(type_name, name) ? type : 0;
+}
+
+static void test_dwarf_cache(void) {
+    if (!OS_LINUX) return;
+
+    Memory *mem = mem_new();
+    File *file = fs_open("/proc/self/exe", FileMode_Read);
+    Elf *elf = elf_load(mem, file);
+    if (!elf || !elf_find_section(elf, ".debug_info")) {
+        // Built without debug info
+        if (elf) elf_close(elf);
+        else if (file) io_close(file);
+        mem_free(mem);
+        return;
+    }
+
+    Dwarf_File *dwarf = dwarf_load(mem, elf);
+    Dwarf_Cache_Key key = dwarf_cache_key(elf, "/proc/self/exe");
+    Buffer data = dwarf_cache_build(mem, dwarf, key);
+    Dwarf_Cache *cache = dwarf_cache_from(mem, data, key);
+    check_or(cache) {
+        elf_close(elf);
+        mem_free(mem);
+        return;
+    }
+
+    // A different file does not match
+    Dwarf_Cache_Key other = key;
+    other.mtime++;
+    check(!dwarf_cache_from(mem, data, other));
+
+    // Same results as the parsed debug info
+    Dwarf_Funcs *funcs = dwarf_load_funcs(dwarf);
+    check(cache->func_count == funcs->count);
+    for (u32 i = 0; i < funcs->count; i += 97) {
+        Dwarf_Func *func = funcs->funcs + i;
+        u64 addr = func->start + (func->end - func->start) / 2;
+        Dwarf_Cache_Func *cached = dwarf_cache_func(cache, addr);
+        check(cached && cached->start == func->start && str_eq(dwarf_cache_str(cache, cached->name), func->name));
+
+        Dwarf_Line line = dwarf_lines_find(dwarf_load_lines(dwarf), addr);
+        Dwarf_Line cached_line = dwarf_cache_line(cache, addr);
+        check(line.line == cached_line.line);
+        check(!line.file == !cached_line.file);
+        if (line.file && cached_line.file) check(str_eq(line.file, cached_line.file));
+    }
+    check(!dwarf_cache_func(cache, 0));
+
+    Dwarf_Cache_Type *type = dwarf_cache_type(cache, "Dwarf_Cache_Header");
+    check(type && type->tag == DW_TAG_typedef);
+    check(!dwarf_cache_type(cache, "Not_A_Type"));
+
+    Dwarf_Cache_Type *structure = 0;
+    for (u32 i = 0; i < cache->type_count; ++i) {
+        if (cache->types[i].tag == DW_TAG_structure_type && cache->types[i].size) structure = cache->types + i;
+    }
+    check(structure);
+    if (structure) {
+        u32 die = dwarf_die_at(dwarf, structure->die);
+        check(die && dwarf->dies[die].tag == DW_TAG_structure_type);
+    }
+
+    // A corrupt table is an error, not a crash
+    Buffer corrupt = mem_buffer(mem, data.size);
+    ptr_copy(corrupt.data, data.data, data.size);
+    ((Dwarf_Cache_Header *)corrupt.data)->strings.offset = 0x7ffffff8;
+    check(!dwarf_cache_from(mem, corrupt, key));
+    check(error_pop());
+
+    // So are indices and offsets inside the tables
+    Dwarf_Cache_Header *header = (Dwarf_Cache_Header *)data.data;
+    check(header->funcs.count && header->types.count && header->files.count);
+    for (u32 i = 0; i < 5; ++i) {
+        Buffer bad = mem_buffer(mem, data.size);
+        ptr_copy(bad.data, data.data, data.size);
+        Dwarf_Cache_Func *bad_func = (Dwarf_Cache_Func *)(bad.data + header->funcs.offset);
+        Dwarf_Cache_Type *bad_type = (Dwarf_Cache_Type *)(bad.data + header->types.offset);
+        if (i == 0) ((u32 *)(bad.data + header->eytz_row.offset))[1] = header->rows.count + 1;
+        if (i == 1) bad_func->name = header->strings.count;
+        if (i == 2) bad_func->die = header->info_size;
+        if (i == 3) bad_type->die = header->info_size;
+        if (i == 4) ((u32 *)(bad.data + header->files.offset))[0] = header->strings.count;
+        check(!dwarf_cache_from(mem, bad, key));
+        check(error_pop());
+    }
+
+    // And a corrupt cache file is rebuilt
+    char *cache_path = "/tmp/tl_test_dwarf_cache";
+    fs_write(cache_path, corrupt);
+    Dwarf_Cache *rebuilt = dwarf_cache_load(mem, elf, "/proc/self/exe", cache_path);
+    check(rebuilt && rebuilt->func_count == cache->func_count);
+    check(dwarf_cache_from(mem, fs_read(mem, cache_path), key));
+    fs_remove(cache_path);
+
+    elf_close(elf);
+    mem_free(mem);
+}
@@ -0,0 +1,215 @@
+// Copyright (c) 2026 - Tom Smeets <tom@tsmeets.nl>
+// dwarf_func.h - Find the function containing an address
+#pragma once
+#include "dwarf.h"
+#include "sort.h"
+
+// Usage:
+//   Dwarf_Func *fn = dwarf_func_at(dwarf, addr);
+//   if (fn) print(fn->name);
+//
+//   // Symbolize many addresses at once, for example profiler samples
+//   Dwarf_Func **result = mem_array(mem, Dwarf_Func *, count);
+//   dwarf_func_lookup(dwarf, count, addr_list, result);
+//
+// The index contains the address ranges of every DW_TAG_subprogram.
+// Functions without debug info are added from the ELF symbol table.
+// Ranges are sorted by start address and don't overlap.
+
+typedef struct {
+    u64 start;
+    u64 end;
+    char *name;
+
+    // The DW_TAG_subprogram, or 0 if found in the symbol table
+    u32 die;
+} Dwarf_Func;
+
+typedef struct Dwarf_Funcs Dwarf_Funcs;
+struct Dwarf_Funcs {
+    u32 count;
+    Dwarf_Func *funcs;
+};
+
+typedef struct {
+    Dwarf_File *dwarf;
+    u32 count;
+    u32 cap;
+    Dwarf_Func *funcs;
+
+    // Reused for every subprogram
+    Dwarf_Range_List ranges;
+} Dwarf_Func_Loader;
+
+static void dwarf_func_add(Dwarf_Func_Loader *loader, u64 start, u64 end, char *name, u32 die) {
+    if (start == 0 || end <= start) return;
+    *DWARF_PUSH(loader->dwarf->mem, loader->funcs, loader->count, loader->cap) = (Dwarf_Func){start, end, name, die};
+}
+
+// Add all address ranges of a subprogram
+static void dwarf_func_add_die(Dwarf_Func_Loader *loader, u32 die_index) {
+    Dwarf_File *dwarf = loader->dwarf;
+    Dwarf_Die *die = dwarf->dies + die_index;
+    Dwarf_Range_List *list = &loader->ranges;
+
+    list->count = 0;
+    dwarf_die_ranges(dwarf, die, list);
+    char *name = dwarf_die_name(dwarf, die);
+    for (u32 i = 0; i < list->count; ++i) dwarf_func_add(loader, list->ranges[i].start, list->ranges[i].end, name, die_index);
+}
+
+static i32 dwarf_func_cmp(void *a, void *b) {
+    Dwarf_Func *func_a = a;
+    Dwarf_Func *func_b = b;
+    if (func_a->start != func_b->start) return func_a->start < func_b->start ? -1 : 1;
+
+    // Prefer debug info over symbols
+    return (func_a->die == 0) - (func_b->die == 0);
+}
+
+// Build the function index
+static Dwarf_Funcs *dwarf_load_funcs(Dwarf_File *dwarf) {
+    if (dwarf->funcs) return dwarf->funcs;
+
+    // The file can be opened lazily, so make sure all units are loaded
+    dwarf_load_units(dwarf);
+    for (u32 i = 0; i < dwarf->unit_count; ++i) dwarf_unit_load(dwarf, i);
+
+    Memory *tmp = mem_new();
+    Dwarf_Func_Loader loader = {.dwarf = dwarf, .ranges = {.mem = tmp}};
+    for (u32 i = 1; i < dwarf->die_count; ++i) {
+        if (dwarf->dies[i].tag == DW_TAG_subprogram) dwarf_func_add_die(&loader, i);
+    }
+
+    // Fill the gaps with functions from the symbol table
+    Elf *elf = dwarf->elf;
+    elf_load_symbols(dwarf->mem, elf);
+    for (u32 i = 0; i < elf->symbol_count; ++i) {
+        Elf_Symbol *sym = elf->symbols + i;
+        if (sym->type != Elf_Symbol_Func) continue;
+
+        // Hand written assembly often has no size, assume it runs until the next symbol
+        u64 end = sym->addr + sym->size;
+        for (u32 j = i + 1; sym->size == 0 && j < elf->symbol_count && end == sym->addr; ++j) end = elf->symbols[j].addr;
+        dwarf_func_add(&loader, sym->addr, end, sym->name, 0);
+    }
+
+    sort_array(loader.funcs, loader.count, sizeof(Dwarf_Func), dwarf_func_cmp);
+
+    // Remove overlapping ranges, keeping the first
+    u32 count = 0;
+    for (u32 i = 0; i < loader.count; ++i) {
+        Dwarf_Func *func = loader.funcs + i;
+        if (count && func->start < loader.funcs[count - 1].end) continue;
+        loader.funcs[count++] = *func;
+    }
+
+    Dwarf_Funcs *funcs = mem_struct(dwarf->mem, Dwarf_Funcs);
+    funcs->count = count;
+    funcs->funcs = loader.funcs;
+    dwarf->funcs = funcs;
+    mem_free(tmp);
+    return funcs;
+}
+
+// Find the function containing an address, or null
+static Dwarf_Func *dwarf_func_at(Dwarf_File *dwarf, u64 addr) {
+    Dwarf_Funcs *funcs = dwarf_load_funcs(dwarf);
+
+    // Find the first function starting after 'addr'
+    u32 low = 0;
+    u32 high = funcs->count;
+    while (low < high) {
+        u32 mid = low + (high - low) / 2;
+        if (funcs->funcs[mid].start <= addr) low = mid + 1;
+        else high = mid;
+    }
+
+    if (low == 0) return 0;
+    Dwarf_Func *func = funcs->funcs + low - 1;
+    return addr < func->end ? func : 0;
+}
+
+typedef struct {
+    u64 addr;
+    u32 index;
+} Dwarf_Func_Query;
+
+static i32 dwarf_func_query_cmp(void *a, void *b) {
+    Dwarf_Func_Query *query_a = a;
+    Dwarf_Func_Query *query_b = b;
+    if (query_a->addr == query_b->addr) return 0;
+    return query_a->addr < query_b->addr ? -1 : 1;
+}
+
+// Find the functions containing 'count' addresses, missing functions are null
+// The addresses are sorted, then both lists are walked once.
+static void dwarf_func_lookup(Dwarf_File *dwarf, u32 count, u64 *addr_list, Dwarf_Func **result) {
+    Dwarf_Funcs *funcs = dwarf_load_funcs(dwarf);
+
+    Memory *tmp = mem_new();
+    Dwarf_Func_Query *queries = mem_array(tmp, Dwarf_Func_Query, count);
+    for (u32 i = 0; i < count; ++i) queries[i] = (Dwarf_Func_Query){addr_list[i], i};
+    sort_array(queries, count, sizeof(Dwarf_Func_Query), dwarf_func_query_cmp);
+
+    u32 func_index = 0;
+    for (u32 i = 0; i < count; ++i) {
+        u64 addr = queries[i].addr;
+
+        // Skip functions that end before this address
+        while (func_index < funcs->count && funcs->funcs[func_index].end <= addr) func_index++;
+
+        Dwarf_Func *func = funcs->funcs + func_index;
+        bool found = func_index < funcs->count && func->start <= addr;
+        result[queries[i].index] = found ? func : 0;
+    }
+    mem_free(tmp);
+}
+
+static void test_dwarf_func(void) {
+    if (!OS_LINUX) return;
+
+    Memory *mem = mem_new();
+    File *file = fs_open("/proc/self/exe", FileMode_Read);
+    Elf *elf = elf_load(mem, file);
+    if (!elf || !elf_find_section(elf, ".debug_info")) {
+        // Built without debug info
+        if (elf) elf_close(elf);
+        else if (file) io_close(file);
+        mem_free(mem);
+        return;
+    }
+
+    Dwarf_File *dwarf = dwarf_load(mem, elf);
+    Dwarf_Die *fn = dwarf ? dwarf_find(dwarf, DW_TAG_subprogram, "test_dwarf_func") : 0;
+    check_or(dwarf && fn) {
+        elf_close(elf);
+        mem_free(mem);
+        return;
+    }
+    u64 low_pc = dwarf_attr_u64(dwarf, fn, DW_AT_low_pc);
+
+    // Single lookup
+    Dwarf_Func *func = dwarf_func_at(dwarf, low_pc + 1);
+    check(func && str_eq(func->name, "test_dwarf_func"));
+    check(func && dwarf->dies + func->die == fn);
+    check(!dwarf_func_at(dwarf, 0));
+
+    // The symbol table agrees
+    Elf_Symbol *sym = elf_find_symbol(elf, low_pc);
+    check(sym && str_eq(sym->name, "test_dwarf_func"));
+
+    // Batch lookup gives the same results in the original order
+    Dwarf_Funcs *funcs = dwarf->funcs;
+    u64 addr_list[64];
+    Dwarf_Func *result[64];
+    for (u32 i = 0; i < array_count(addr_list); ++i) {
+        Dwarf_Func *f = funcs->funcs + (i * 7919) % funcs->count;
+        addr_list[i] = i % 5 == 0 ? 0 : f->start + (f->end - f->start) / 2;
+    }
+    dwarf_func_lookup(dwarf, array_count(addr_list), addr_list, result);
+    for (u32 i = 0; i < array_count(addr_list); ++i) check(result[i] == dwarf_func_at(dwarf, addr_list[i]));
+
+    elf_close(elf);
+    mem_free(mem);
+}
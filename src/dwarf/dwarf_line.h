@@ -0,0 +1,495 @@
+// Copyright (c) 2026 - Tom Smeets <tom@tsmeets.nl>
+// dwarf_line.h - Address to source line lookup using .debug_line
+#pragma once
+#include "dwarf.h"
+#include "sort.h"
+
+// Usage:
+//   Dwarf_Line line = dwarf_addr_to_line(dwarf, addr);
+//   if (line.file) print(line.file, ":", line.line);
+//
+// The line program of the unit containing the address is executed once into a
+// table of rows sorted by address, only that unit is loaded. dwarf_load_lines
+// builds the same table for all line programs at once.
+// A row covers all addresses up to the next row, rows with line 0 end a sequence.
+// The addresses are also stored in Eytzinger order, which makes the binary search
+// cache friendly because the first levels of the tree are next to each other.
+
+// Line number header entry formats
+typedef enum {
+    DW_LNCT_path = 0x1,
+    DW_LNCT_directory_index = 0x2,
+    DW_LNCT_timestamp = 0x3,
+    DW_LNCT_size = 0x4,
+    DW_LNCT_MD5 = 0x5,
+} Dwarf_Line_Content;
+
+// Standard opcodes
+typedef enum {
+    DW_LNS_copy = 0x01,
+    DW_LNS_advance_pc = 0x02,
+    DW_LNS_advance_line = 0x03,
+    DW_LNS_set_file = 0x04,
+    DW_LNS_set_column = 0x05,
+    DW_LNS_negate_stmt = 0x06,
+    DW_LNS_set_basic_block = 0x07,
+    DW_LNS_const_add_pc = 0x08,
+    DW_LNS_fixed_advance_pc = 0x09,
+    DW_LNS_set_prologue_end = 0x0a,
+    DW_LNS_set_epilogue_begin = 0x0b,
+    DW_LNS_set_isa = 0x0c,
+} Dwarf_Line_Opcode;
+
+// Extended opcodes
+typedef enum {
+    DW_LNE_end_sequence = 0x01,
+    DW_LNE_set_address = 0x02,
+    DW_LNE_define_file = 0x03,
+    DW_LNE_set_discriminator = 0x04,
+} Dwarf_Line_Extended_Opcode;
+
+typedef struct {
+    u64 addr;
+    u32 file;
+    u32 line;
+} Dwarf_Line_Row;
+
+typedef struct Dwarf_Lines Dwarf_Lines;
+struct Dwarf_Lines {
+    // Sorted by address
+    u32 row_count;
+    Dwarf_Line_Row *rows;
+
+    // Full path of every file in the line programs
+    u32 file_count;
+    char **files;
+
+    // Row addresses in Eytzinger order, index 0 is unused
+    u64 *eytz_addr;
+    u32 *eytz_row;
+};
+
+// Result of a lookup, file is null if the address was not found
+typedef struct {
+    char *file;
+    u32 line;
+} Dwarf_Line;
+
+// Header of a single line program
+typedef struct {
+    u16 version;
+    u8 offset_size;
+    u8 min_inst_length;
+    u8 default_is_stmt;
+    i8 line_base;
+    u8 line_range;
+    u8 opcode_base;
+    u8 opcode_lengths[256];
+
+    // Index of the first file of this program in Dwarf_Lines
+    u32 file_base;
+    u32 file_count;
+} Dwarf_Line_Header;
+
+typedef struct {
+    Dwarf_File *dwarf;
+    Dwarf_Lines *lines;
+    u32 row_cap;
+    u32 file_cap;
+
+    // Relative directories before DWARF 5 are relative to this, can be null
+    char *comp_dir;
+} Dwarf_Line_Loader;
+
+// Parse a string or string offset form used in the v5 header
+static char *dwarf_line_str(Dwarf_File *dwarf, Parse *parse, Dwarf_Form form, u8 offset_size) {
+    if (form == DW_FORM_string) {
+        char *str = (char *)parse->data + parse->cursor;
+        while (parse_peek(parse)) parse_next(parse);
+        parse_next(parse);
+        return str;
+    }
+    if (form == DW_FORM_line_strp) return dwarf_str_at(dwarf->sect_line_str, parse_offset(parse, offset_size));
+    if (form == DW_FORM_strp) return dwarf_str_at(dwarf->sect_str, parse_offset(parse, offset_size));
+    error_set("Unsupported DWARF line string form");
+    return "";
+}
+
+// Skip a value of a form we don't need
+static void dwarf_line_skip(Parse *parse, Dwarf_Form form, u8 offset_size) {
+    if (form == DW_FORM_data16) parse_data(parse, 16);
+    else if (form == DW_FORM_block) parse_data(parse, parse_uleb128(parse));
+    else if (form == DW_FORM_line_strp || form == DW_FORM_strp) parse_offset(parse, offset_size);
+    else if (form == DW_FORM_string) dwarf_line_str(0, parse, form, offset_size);
+    else parse_u64_form(parse, form);
+}
+
+static void dwarf_line_add_file(Dwarf_Line_Loader *loader, Dwarf_Line_Header *header, char *dir, char *name) {
+    Dwarf_Lines *lines = loader->lines;
+    Memory *mem = loader->dwarf->mem;
+
+    char *path = name;
+    if (name[0] != '/' && dir && dir[0]) path = fstr(mem, dir, "/", name);
+    *DWARF_PUSH(mem, lines->files, lines->file_count, loader->file_cap) = path;
+    header->file_count++;
+}
+
+// Read the directory and file tables of DWARF 5
+static void dwarf_line_files_v5(Dwarf_Line_Loader *loader, Dwarf_Line_Header *header, Parse *parse) {
+    Dwarf_File *dwarf = loader->dwarf;
+    Memory *tmp = mem_new();
+
+    // Directories
+    u8 format_count = parse_u8(parse);
+    u64 format[2 * 256];
+    for (u32 i = 0; i < format_count * 2; ++i) format[i] = parse_uleb128(parse);
+
+    u64 dir_count = parse_uleb128(parse);
+    check_or(dir_count < (1 << 20)) dir_count = 0;
+    char **dirs = mem_array_zero(tmp, char *, dir_count);
+    for (u64 i = 0; i < dir_count; ++i) {
+        for (u32 j = 0; j < format_count; ++j) {
+            if (format[j * 2] == DW_LNCT_path) dirs[i] = dwarf_line_str(dwarf, parse, format[j * 2 + 1], header->offset_size);
+            else dwarf_line_skip(parse, format[j * 2 + 1], header->offset_size);
+        }
+
+        // Directory 0 is the compilation directory, the others can be relative to it
+        if (i > 0 && dirs[0] && dirs[i] && dirs[i][0] != '/') dirs[i] = fstr(tmp, dirs[0], "/", dirs[i]);
+    }
+
+    // Files
+    format_count = parse_u8(parse);
+    for (u32 i = 0; i < format_count * 2; ++i) format[i] = parse_uleb128(parse);
+
+    u64 file_count = parse_uleb128(parse);
+    check_or(file_count < (1 << 20)) file_count = 0;
+    for (u64 i = 0; i < file_count && !error; ++i) {
+        char *name = "";
+        u64 dir = 0;
+        for (u32 j = 0; j < format_count; ++j) {
+            Dwarf_Form form = format[j * 2 + 1];
+            if (format[j * 2] == DW_LNCT_path) name = dwarf_line_str(dwarf, parse, form, header->offset_size);
+            else if (format[j * 2] == DW_LNCT_directory_index) dir = parse_u64_form(parse, form);
+            else dwarf_line_skip(parse, form, header->offset_size);
+        }
+        dwarf_line_add_file(loader, header, dir < dir_count ? dirs[dir] : 0, name);
+    }
+    mem_free(tmp);
+}
+
+// Read the directory and file tables of DWARF 2 to 4
+static void dwarf_line_files_v4(Dwarf_Line_Loader *loader, Dwarf_Line_Header *header, Parse *parse) {
+    // Directory 0 is the compilation directory, which is only stored in the unit
+    char *comp_dir = loader->comp_dir;
+    u32 dir_count = 1;
+    char *dirs[1024] = {comp_dir ?: ""};
+    for (;;) {
+        char *dir = dwarf_line_str(0, parse, DW_FORM_string, 0);
+        if (!dir[0] || parse_eof(parse)) break;
+        if (comp_dir && dir[0] != '/') dir = fstr(loader->dwarf->mem, comp_dir, "/", dir);
+        if (dir_count < array_count(dirs)) dirs[dir_count++] = dir;
+    }
+
+    for (;;) {
+        char *name = dwarf_line_str(0, parse, DW_FORM_string, 0);
+        if (!name[0] || parse_eof(parse)) break;
+        u64 dir = parse_uleb128(parse);
+        parse_uleb128(parse); // mtime
+        parse_uleb128(parse); // length
+        dwarf_line_add_file(loader, header, dir < dir_count ? dirs[dir] : 0, name);
+    }
+}
+
+// Execute a single line program and append its rows
+static void dwarf_line_program(Dwarf_Line_Loader *loader, Dwarf_Line_Header *header, Parse *parse) {
+    Dwarf_Lines *lines = loader->lines;
+    Memory *mem = loader->dwarf->mem;
+
+    u64 addr = 0;
+    u32 file = 1;
+    i64 line = 1;
+    u32 sequence_start = lines->row_count;
+
+    // Files are numbered from 1 before DWARF 5
+    u32 file_offset = header->version >= 5 ? 0 : 1;
+
+    while (!parse_eof(parse) && !error) {
+        u8 opcode = parse_u8(parse);
+        bool emit = false;
+        bool end_sequence = false;
+
+        if (opcode >= header->opcode_base) {
+            // Special opcode, advance address and line at the same time
+            u32 adjusted = opcode - header->opcode_base;
+            addr += (adjusted / header->line_range) * header->min_inst_length;
+            line += header->line_base + (i32)(adjusted % header->line_range);
+            emit = true;
+        } else if (opcode == 0) {
+            u64 length = parse_uleb128(parse);
+            u64 end = parse->cursor + length;
+            u8 extended = length ? parse_u8(parse) : 0;
+            if (extended == DW_LNE_end_sequence) {
+                emit = true;
+                end_sequence = true;
+            }
+            if (extended == DW_LNE_set_address) {
+                // The address fills the rest of the instruction, older versions don't store the address size
+                u64 size = length - 1;
+                addr = size == 8 ? parse_u64(parse) : size == 4 ? parse_u32(parse) : 0;
+            }
+            parse->cursor = end;
+        } else if (opcode == DW_LNS_copy) {
+            emit = true;
+        } else if (opcode == DW_LNS_advance_pc) {
+            addr += parse_uleb128(parse) * header->min_inst_length;
+        } else if (opcode == DW_LNS_advance_line) {
+            line += parse_ileb128(parse);
+        } else if (opcode == DW_LNS_set_file) {
+            file = parse_uleb128(parse);
+        } else if (opcode == DW_LNS_const_add_pc) {
+            addr += ((255 - header->opcode_base) / header->line_range) * header->min_inst_length;
+        } else if (opcode == DW_LNS_fixed_advance_pc) {
+            addr += parse_u16(parse);
+        } else {
+            // Skip the arguments of opcodes we don't care about
+            for (u32 i = 0; i < header->opcode_lengths[opcode]; ++i) parse_uleb128(parse);
+        }
+
+        if (!emit) continue;
+
+        Dwarf_Line_Row *row = DWARF_PUSH(mem, lines->rows, lines->row_count, loader->row_cap);
+        row->addr = addr;
+        // Unknown file indices point to the first file of the unit, or nothing when it has no files
+        row->file = header->file_count ? header->file_base : U32_MAX;
+        if (file >= file_offset && file - file_offset < header->file_count) row->file += file - file_offset;
+        row->line = end_sequence ? 0 : MAX(line, 1);
+
+        if (end_sequence) {
+            // Sequences at address 0 belong to functions removed by the linker
+            if (lines->rows[sequence_start].addr == 0) lines->row_count = sequence_start;
+            sequence_start = lines->row_count;
+            addr = 0;
+            file = 1;
+            line = 1;
+        }
+    }
+}
+
+// Parse a single line program header, returns false at the end of the section
+static bool dwarf_line_unit(Dwarf_Line_Loader *loader, Parse *parse) {
+    Dwarf_Lines *lines = loader->lines;
+    u64 start = parse->cursor;
+
+    Dwarf_Line_Header header = {};
+    header.offset_size = 4;
+    u64 length = parse_u32(parse);
+    if (length == 0xffffffff) {
+        header.offset_size = 8;
+        length = parse_u64(parse);
+    }
+    u64 end = parse->cursor + length;
+    check_or(end <= parse->size) return false;
+
+    header.version = parse_u16(parse);
+    check_or(header.version >= 2 && header.version <= 5) return false;
+
+    if (header.version >= 5) {
+        parse_u8(parse); // address size, DW_LNE_set_address has its own length
+        parse_u8(parse); // segment selector size
+    }
+
+    u64 header_length = parse_offset(parse, header.offset_size);
+    u64 program_start = parse->cursor + header_length;
+    header.min_inst_length = parse_u8(parse);
+    if (header.version >= 4) parse_u8(parse); // max ops per instruction, only for VLIW
+    header.default_is_stmt = parse_u8(parse);
+    header.line_base = (i8)parse_u8(parse);
+    header.line_range = parse_u8(parse);
+    header.opcode_base = parse_u8(parse);
+    check_or(header.line_range > 0 && header.opcode_base > 0) return false;
+    for (u32 i = 1; i < header.opcode_base; ++i) header.opcode_lengths[i] = parse_u8(parse);
+
+    header.file_base = lines->file_count;
+    if (header.version >= 5) dwarf_line_files_v5(loader, &header, parse);
+    else dwarf_line_files_v4(loader, &header, parse);
+    if (error) return false;
+
+    // Run the program on a parser limited to this unit
+    Parse program = {.data = parse->data, .cursor = program_start, .size = end};
+    dwarf_line_program(loader, &header, &program);
+    check_or(!parse->overrun && !program.overrun) return false;
+
+    parse->cursor = end;
+    return end > start;
+}
+
+static i32 dwarf_line_row_cmp(void *a, void *b) {
+    Dwarf_Line_Row *row_a = a;
+    Dwarf_Line_Row *row_b = b;
+    if (row_a->addr != row_b->addr) return row_a->addr < row_b->addr ? -1 : 1;
+
+    // A sequence can start where another ends, the end should come first
+    return (row_a->line != 0) - (row_b->line != 0);
+}
+
+// Store the sorted rows as an implicit binary tree, index 'k' has children '2k' and '2k + 1'
+static u32 dwarf_line_eytzinger(Dwarf_Lines *lines, u32 row, u32 k) {
+    if (k > lines->row_count) return row;
+    row = dwarf_line_eytzinger(lines, row, 2 * k);
+    lines->eytz_addr[k] = lines->rows[row].addr;
+    lines->eytz_row[k] = row;
+    return dwarf_line_eytzinger(lines, row + 1, 2 * k + 1);
+}
+
+// Execute line programs starting at 'offset' into a sorted table
+static Dwarf_Lines *dwarf_lines_build(Dwarf_File *dwarf, u64 offset, bool all, char *comp_dir) {
+    Dwarf_Lines *lines = mem_struct(dwarf->mem, Dwarf_Lines);
+    Dwarf_Line_Loader loader = {.dwarf = dwarf, .lines = lines, .comp_dir = comp_dir};
+    Buffer data = dwarf->sect_line;
+    Parse parse = {.data = data.data, .cursor = offset, .size = data.size};
+    while (!parse_eof(&parse) && dwarf_line_unit(&loader, &parse) && all);
+
+    sort_array(lines->rows, lines->row_count, sizeof(Dwarf_Line_Row), dwarf_line_row_cmp);
+
+    // Index 0 is not part of the tree, zero it so the cache file is deterministic
+    lines->eytz_addr = mem_array_zero(dwarf->mem, u64, lines->row_count + 1);
+    lines->eytz_row = mem_array_zero(dwarf->mem, u32, lines->row_count + 1);
+    dwarf_line_eytzinger(lines, 0, 1);
+    return lines;
+}
+
+// Load all line programs in .debug_line
+static Dwarf_Lines *dwarf_load_lines(Dwarf_File *dwarf) {
+    if (!dwarf->lines) dwarf->lines = dwarf_lines_build(dwarf, 0, true, 0);
+    return dwarf->lines;
+}
+
+// Load the line program of a single unit
+static Dwarf_Lines *dwarf_unit_lines(Dwarf_File *dwarf, Dwarf_Unit *unit) {
+    if (unit->lines) return unit->lines;
+
+    Dwarf_Die *root = unit->die_count ? dwarf->dies + unit->die_start : 0;
+    Dwarf_Attr *stmt_list = root ? dwarf_attr(dwarf, root, DW_AT_stmt_list) : 0;
+    if (stmt_list) unit->lines = dwarf_lines_build(dwarf, stmt_list->value, false, dwarf_attr_str(dwarf, root, DW_AT_comp_dir));
+    else unit->lines = mem_struct(dwarf->mem, Dwarf_Lines);
+    return unit->lines;
+}
+
+// Find the row containing an address
+static Dwarf_Line dwarf_lines_find(Dwarf_Lines *lines, u64 addr) {
+    // Find the first row with an address greater than 'addr'
+    u32 k = 1;
+    while (k <= lines->row_count) k = 2 * k + (lines->eytz_addr[k] <= addr);
+
+    // Undo the final right turns, the remaining path ends at the answer
+    k >>= __builtin_ffs(~k);
+    u32 next = k ? lines->eytz_row[k] : lines->row_count;
+
+    // The row before that contains our address, unless it ends a sequence
+    if (next == 0) return (Dwarf_Line){};
+    Dwarf_Line_Row *row = lines->rows + next - 1;
+    if (row->line == 0 || row->file >= lines->file_count) return (Dwarf_Line){};
+    return (Dwarf_Line){lines->files[row->file], row->line};
+}
+
+// Find the source line of an address, only the unit containing it is loaded
+static Dwarf_Line dwarf_addr_to_line(Dwarf_File *dwarf, u64 addr) {
+    Dwarf_Unit *unit = dwarf_unit_at(dwarf, addr);
+    if (!unit) return (Dwarf_Line){};
+    return dwarf_lines_find(dwarf_unit_lines(dwarf, unit), addr);
+}
+
+static void test_dwarf_line(void) {
+    Memory *mem = mem_new();
+
+    // Rows with a file index outside of the file table have no file
+    char *files[] = {"a.c"};
+    Dwarf_Line_Row rows[] = {{0x10, 0, 1}, {0x20, U32_MAX, 2}, {0x30, 1, 3}, {0x40, 0, 0}};
+    Dwarf_Lines synth = {.row_count = array_count(rows), .rows = rows, .file_count = array_count(files), .files = files};
+    synth.eytz_addr = mem_array(mem, u64, synth.row_count + 1);
+    synth.eytz_row = mem_array(mem, u32, synth.row_count + 1);
+    dwarf_line_eytzinger(&synth, 0, 1);
+    check(dwarf_lines_find(&synth, 0x18).file == files[0]);
+    check(!dwarf_lines_find(&synth, 0x28).file);
+    check(!dwarf_lines_find(&synth, 0x38).file);
+
+    // A line program that is cut off in the middle of an instruction is an error
+    u8 truncated[] = {
+        39, 0, 0, 0, 4, 0, 27, 0, 0, 0,                   // length, version, header length
+        1, 1, 1, (u8)-5, 14, 13, 0, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0, 1, // opcodes
+        0, 'a', '.', 'c', 0, 0, 0, 0, 0,                  // directories, files
+        0, 9, DW_LNE_set_address, 0x10, 0x20, 0x30,       // address is missing 5 bytes
+    };
+    Dwarf_File synth_dwarf = {.mem = mem, .sect_line = buf_from(truncated, sizeof(truncated))};
+    dwarf_lines_build(&synth_dwarf, 0, true, 0);
+    check(error_pop());
+
+    // 32-bit addresses before version 5
+    u8 program32[] = {
+        49, 0, 0, 0, 4, 0, 27, 0, 0, 0,                   // length, version, header length
+        1, 1, 1, (u8)-5, 14, 13, 0, 1, 1, 1, 1, 0, 0, 0, 1, 0, 0, 1, // opcodes
+        0, 'a', '.', 'c', 0, 0, 0, 0, 0,                  // directories, files
+        0, 5, DW_LNE_set_address, 0x00, 0x10, 0, 0,       // address 0x1000
+        DW_LNS_copy,                                      // line 1
+        DW_LNS_advance_pc, 0x10, DW_LNS_advance_line, 4, // address 0x1010, line 5
+        DW_LNS_copy,                                      //
+        0, 1, DW_LNE_end_sequence,                        //
+    };
+    synth_dwarf.sect_line = buf_from(program32, sizeof(program32));
+    Dwarf_Lines *lines32 = dwarf_lines_build(&synth_dwarf, 0, true, 0);
+    check(lines32->row_count == 3);
+    check(dwarf_lines_find(lines32, 0x1008).line == 1);
+    check(dwarf_lines_find(lines32, 0x1010).line == 5);
+
+    if (!OS_LINUX) {
+        mem_free(mem);
+        return;
+    }
+
+    File *file = fs_open("/proc/self/exe", FileMode_Read);
+    Elf *elf = elf_load(mem, file);
+    if (!elf || !elf_find_section(elf, ".debug_line")) {
+        // Built without debug info
+        if (elf) elf_close(elf);
+        else if (file) io_close(file);
+        mem_free(mem);
+        return;
+    }
+
+    // The first row of a function points to the line it is declared on
+    Dwarf_File *dwarf = dwarf_load(mem, elf);
+    Dwarf_Die *fn = dwarf ? dwarf_find(dwarf, DW_TAG_subprogram, "test_dwarf_line") : 0;
+    check_or(dwarf && fn) {
+        elf_close(elf);
+        mem_free(mem);
+        return;
+    }
+
+    u64 low_pc = dwarf_attr_u64(dwarf, fn, DW_AT_low_pc);
+    Dwarf_Line line = dwarf_addr_to_line(dwarf, low_pc);
+    check(line.file);
+    check(line.line == dwarf_attr_u64(dwarf, fn, DW_AT_decl_line));
+    check(line.file && buf_ends_with(str_buf(line.file), str_buf("dwarf_line.h")));
+
+    // Rows are sorted
+    Dwarf_Lines *lines = dwarf_load_lines(dwarf);
+    for (u32 i = 1; i < lines->row_count; ++i) check(lines->rows[i - 1].addr <= lines->rows[i].addr);
+
+    // The table with all units gives the same result
+    Dwarf_Line all = dwarf_lines_find(lines, low_pc);
+    check(all.line == line.line && str_eq(all.file, line.file));
+
+    // Nothing at address 0
+    check(!dwarf_addr_to_line(dwarf, 0).file);
+
+    // Opened lazily, only the unit containing the address is loaded
+    Dwarf_File *lazy = dwarf_open(mem, elf);
+    Dwarf_Line lazy_line = dwarf_addr_to_line(lazy, low_pc);
+    check(lazy_line.file && str_eq(lazy_line.file, line.file) && lazy_line.line == line.line);
+    u32 loaded = 0;
+    for (u32 i = 0; i < lazy->unit_count; ++i) loaded += lazy->units[i].loaded;
+    check(loaded == 1);
+
+    elf_close(elf);
+    mem_free(mem);
+}
@@ -34,3 +34,9 @@ static_assert(sizeof(Pix_Audio_Sample) == 2 * sizeof(f32));
 // - 2 channels
 // - each sample is two 16 bit integers (left, right)
 static void pix_play(Pix *pix, u32 sample_count, Pix_Audio_Sample *samples);
+
+// Continue a stream of samples, for audio that is synthesized while the game runs
+// - Samples are mixed right after the samples of the previous call
+// - Returns how many streamed samples are not played yet,
+//   keep this above the time until the next call to prevent gaps
+static u32 pix_stream(Pix *pix, u32 sample_count, Pix_Audio_Sample *samples);
@@ -1,4 +1,5 @@
 #pragma once
+#include "atomic.h"
 #include "mem.h"
 #include "pix_api.h"
 #include "sdl2.h"
@@ -18,7 +19,21 @@ struct Pix {
 
     // Audio
     int audio_device;
-    u32 audio_count;
+
+    // Ring buffer shared with the audio thread, without locks
+    // - Cursors count samples since the start, the buffer index is 'cursor % array_count(audio_buffer)'
+    // - 'audio_read' is only written by the audio thread, 'audio_write' only by pix_play
+    // - The audio thread plays '[audio_read, audio_write)', the rest of the buffer is free
+    // - pix_play mixes into the buffer 'audio_ahead' samples after 'audio_read',
+    //   the audio thread reads at most that many samples at once
+    // - pix_stream continues at 'audio_stream'
+    // - 'audio_late' counts mixed samples the audio thread had already played,
+    //   this happens when pix_play is paused for longer than 'audio_ahead' samples
+    u32 audio_ahead;
+    u64 audio_read;
+    u64 audio_write;
+    u64 audio_stream;
+    u64 audio_late;
     Pix_Audio_Sample audio_buffer[48000 * 5];
 };
 
@@ -138,12 +153,16 @@ static void _pix_audio_callback(void *user, u8 *stream, int len) {
     u32 output_count = len / sizeof(Pix_Audio_Sample);
     Pix_Audio_Sample *output_buffer = (Pix_Audio_Sample *)stream;
 
+    u64 read = pix->audio_read;
+    u64 write = atomic_load(&pix->audio_write);
     u32 consumed_count = output_count;
-    if (consumed_count > pix->audio_count) consumed_count = pix->audio_count;
+    if (consumed_count > write - read) consumed_count = write - read;
 
     // Copy queued audio samples
+    u32 ix = read % array_count(pix->audio_buffer);
     for (u32 i = 0; i < consumed_count; ++i) {
-        output_buffer[i] = pix->audio_buffer[i];
+        output_buffer[i] = pix->audio_buffer[ix];
+        if (++ix == array_count(pix->audio_buffer)) ix = 0;
     }
 
     // Clear remaining output samples
@@ -151,57 +170,86 @@ static void _pix_audio_callback(void *user, u8 *stream, int len) {
         output_buffer[i] = (Pix_Audio_Sample){};
     }
 
-    // Update internal audio queue
-    if (consumed_count == 0) {
-        // Nothing consumed, so nothing to move
-    } else if (consumed_count == pix->audio_count) {
-        // Everything is consumed, so no need to move
-        pix->audio_count = 0;
-    } else {
-        // Some samples are consumed,
-        // remove them and move the remaining samples to the start
-        u32 remaining_count = pix->audio_count - consumed_count;
-        for (u32 i = 0; i < remaining_count; ++i) {
-            pix->audio_buffer[i] = pix->audio_buffer[i + consumed_count];
-        }
-        pix->audio_count = remaining_count;
-    }
+    // Give the samples back to pix_play
+    atomic_store(&pix->audio_read, read + consumed_count);
 }
 
-// Play a sound effect
-static void pix_play(Pix *pix, u32 sample_count, Pix_Audio_Sample *samples) {
-    if (!pix->audio_device) {
-        // Init audio
-        SDL_AudioSpec audio_spec = {
-            .freq = 48000,
-            .format = AUDIO_F32,
-            .channels = 2,
-            .callback = _pix_audio_callback,
-            .userdata = pix,
-        };
-        pix->audio_device = pix->sdl.SDL_OpenAudioDevice(0, 0, &audio_spec, 0, 0);
-
-        // Start playing audio (pause set to 0 means play)
-        pix->sdl.SDL_PauseAudioDevice(pix->audio_device, 0);
-    }
+// Open the audio device on first use
+static void _pix_audio_init(Pix *pix) {
+    if (pix->audio_device) return;
+
+    SDL_AudioSpec audio_spec = {
+        .freq = 48000,
+        .format = AUDIO_F32,
+        .channels = 2,
+        .samples = 512,
+        .callback = _pix_audio_callback,
+        .userdata = pix,
+    };
+    SDL_AudioSpec obtained = {};
+    pix->audio_device = pix->sdl.SDL_OpenAudioDevice(0, 0, &audio_spec, &obtained, 0);
+    pix->audio_ahead = obtained.samples ? obtained.samples : audio_spec.samples;
+
+    // Start playing audio (pause set to 0 means play)
+    pix->sdl.SDL_PauseAudioDevice(pix->audio_device, 0);
+}
 
-    pix->sdl.SDL_LockAudioDevice(pix->audio_device);
+// Mix samples into the buffer starting at cursor 'start', returns the cursor after the last sample
+// - 'start' has to be at least 'audio_ahead' samples after 'read'
+static u64 _pix_audio_mix(Pix *pix, u64 read, u64 start, u32 sample_count, Pix_Audio_Sample *samples) {
+    u64 write = pix->audio_write;
+    u64 end = start + sample_count;
 
     // Limit sample count
-    if (sample_count > array_count(pix->audio_buffer)) {
-        sample_count = array_count(pix->audio_buffer);
-    }
-
-    // Reserve space for more samples if needed
-    while (pix->audio_count < sample_count) {
-        pix->audio_buffer[pix->audio_count++] = (Pix_Audio_Sample){0, 0};
+    if (end > read + array_count(pix->audio_buffer)) end = read + array_count(pix->audio_buffer);
+    if (end <= start) return start;
+
+    // Reserve space for more samples if needed, this part is not played yet
+    u32 ix = write % array_count(pix->audio_buffer);
+    for (u64 i = write; i < end; ++i) {
+        pix->audio_buffer[ix] = (Pix_Audio_Sample){0, 0};
+        if (++ix == array_count(pix->audio_buffer)) ix = 0;
     }
 
     // Add samples to output stream
-    for (u32 i = 0; i < sample_count; ++i) {
-        pix->audio_buffer[i].left += samples[i].left;
-        pix->audio_buffer[i].right += samples[i].right;
+    ix = start % array_count(pix->audio_buffer);
+    for (u32 i = 0; i < end - start; ++i) {
+        pix->audio_buffer[ix].left += samples[i].left;
+        pix->audio_buffer[ix].right += samples[i].right;
+        if (++ix == array_count(pix->audio_buffer)) ix = 0;
     }
 
-    pix->sdl.SDL_UnlockAudioDevice(pix->audio_device);
+    // Publish the new samples to the audio thread
+    if (end > write) atomic_store(&pix->audio_write, end);
+
+    // 'read' is only a snapshot, the audio thread could have passed 'start' while we were mixing.
+    // Those samples were played without (all of) the new sound, so that part is dropped.
+    // The slots are reused after 'audio_write' and are cleared before that.
+    u64 played = atomic_load(&pix->audio_read);
+    if (played > start) pix->audio_late += MIN(played, end) - start;
+    return end;
+}
+
+// Play a sound effect
+// - Never waits for the audio thread
+// - Samples that do not fit in the buffer are dropped
+static void pix_play(Pix *pix, u32 sample_count, Pix_Audio_Sample *samples) {
+    _pix_audio_init(pix);
+
+    // The audio thread might be reading up to 'audio_ahead' samples after 'read',
+    // so the sound starts right after that
+    u64 read = atomic_load(&pix->audio_read);
+    _pix_audio_mix(pix, read, read + pix->audio_ahead, sample_count, samples);
+}
+
+// Continue a stream of samples
+// - Never waits for the audio thread
+// - When the stream fell behind it continues as soon as possible
+static u32 pix_stream(Pix *pix, u32 sample_count, Pix_Audio_Sample *samples) {
+    _pix_audio_init(pix);
+
+    u64 read = atomic_load(&pix->audio_read);
+    u64 start = MAX(pix->audio_stream, read + pix->audio_ahead);
+    pix->audio_stream = _pix_audio_mix(pix, read, start, sample_count, samples);
+    return pix->audio_stream - read;
 }
@@ -11,7 +11,10 @@ struct Pix {
     bool has_audio;
 
     // Audio
+    // - 'audio_cursor' is the next sample played, it is advanced by js
+    // - pix_stream continues at 'audio_stream'
     u32 audio_cursor;
+    u32 audio_stream;
     Pix_Audio_Sample audio_buffer[1024 * 48 * 5];
 
     u32 event_read;
@@ -83,11 +86,8 @@ static void pix_draw(Pix *pix, v2i size, u8 *rgb) {
        size.x, size.y, (void *)rgb);
 }
 
-// Play a sound effect
-// - sample rate is 48000 Hz
-// - 2 channels
-// - each sample is two 16 bit integers (left, right)
-static void pix_play(Pix *pix, u32 sample_count, Pix_Audio_Sample *samples) {
+// Start the audio processor on first use, and resume it when the browser paused it
+static void _pix_audio_init(Pix *pix) {
     js(R"((buffer_data_ptr, buffer_size, cursor_ptr) => {
         if(!tlib.audio_init) {
            const buffer_data = new Float32Array(tlib.memory.buffer, buffer_data_ptr, buffer_size*2);
@@ -121,14 +121,45 @@ static void pix_play(Pix *pix, u32 sample_count, Pix_Audio_Sample *samples) {
         tlib.audio.resume();
         })",
        (void *)pix->audio_buffer, array_count(pix->audio_buffer), (void *)&pix->audio_cursor);
+}
 
+// Mix samples into the buffer starting at 'cursor', returns the index after the last sample
+static u32 _pix_audio_mix(Pix *pix, u32 cursor, u32 sample_count, Pix_Audio_Sample *samples) {
     sample_count = MIN(sample_count, array_count(pix->audio_buffer));
-    u32 cursor = pix->audio_cursor;
     for (u32 i = 0; i < sample_count; ++i) {
         pix->audio_buffer[cursor].left += samples[i].left;
         pix->audio_buffer[cursor].right += samples[i].right;
         if (++cursor == array_count(pix->audio_buffer)) cursor = 0;
     }
+    return cursor;
+}
+
+// Play a sound effect
+// - sample rate is 48000 Hz
+// - 2 channels
+// - each sample is two 16 bit integers (left, right)
+static void pix_play(Pix *pix, u32 sample_count, Pix_Audio_Sample *samples) {
+    _pix_audio_init(pix);
+    _pix_audio_mix(pix, pix->audio_cursor, sample_count, samples);
+}
+
+// Continue a stream of samples
+// - When the stream fell behind it continues at the play cursor
+static u32 pix_stream(Pix *pix, u32 sample_count, Pix_Audio_Sample *samples) {
+    _pix_audio_init(pix);
+
+    u32 size = array_count(pix->audio_buffer);
+    u32 ahead = (pix->audio_stream + size - pix->audio_cursor) % size;
+
+    // The play cursor passed the end of the stream
+    if (ahead > size / 2) {
+        pix->audio_stream = pix->audio_cursor;
+        ahead = 0;
+    }
+
+    sample_count = MIN(sample_count, size / 2 - ahead);
+    pix->audio_stream = _pix_audio_mix(pix, pix->audio_stream, sample_count, samples);
+    return ahead + sample_count;
 }
 
 static Key key_from_char(u32 key) {
@@ -1,30 +0,0 @@
-// Copyright (c) 2026 - Tom Smeets <tom@tsmeets.nl>
-// sound.h - Notes and sound stuff
-#pragma once
-
-// Octave
-#define OCT_N1 (1.0f / 32.0f)
-#define OCT_0 (1.0f / 16.0f)
-#define OCT_1 (1.0f / 8.0f)
-#define OCT_2 (1.0f / 4.0f)
-#define OCT_3 (1.0f / 2.0f)
-#define OCT_4 (1.0f)
-#define OCT_5 (2.0f)
-#define OCT_6 (4.0f)
-#define OCT_7 (8.0f)
-#define OCT_8 (16.0f)
-#define OCT_9 (32.0f)
-
-// Note
-#define NOTE_C 261.62556530059860
-#define NOTE_CS 277.18263097687210
-#define NOTE_D 293.66476791740760
-#define NOTE_DS 311.12698372208090
-#define NOTE_E 329.62755691286990
-#define NOTE_F 349.22823143300390
-#define NOTE_FS 369.99442271163440
-#define NOTE_G 391.99543598174927
-#define NOTE_GS 415.30469757994510
-#define NOTE_A 440.00000000000000
-#define NOTE_AS 466.16376151808990
-#define NOTE_B 493.88330125612410
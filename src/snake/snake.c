@@ -6,32 +6,11 @@
 #include "pix.h"
 #include "rand.h"
 #include "snake_level.h"
-#include "sound.h"
+#include "sound_note.h"
+#include "sound_voice.h"
 #include "time.h"
 #include "vec.h"
 
-static void snake_play_sound(Pix *pix, f32 freq, f32 duration, f32 attack, f32 decay) {
-    // Construct sample array
-    u32 sample_count = duration * PIX_AUDIO_RATE;
-    Pix_Audio_Sample *samples = mem_array(mem_tmp(), Pix_Audio_Sample, sample_count);
-
-    f32 dt = 1.0f / PIX_AUDIO_RATE;
-    f32 phase = 0;
-    for (u32 i = 0; i < sample_count; ++i) {
-        f32 ta = i * dt;
-        f32 td = (sample_count - i - 1) * dt;
-        f32 va = attack > ta ? ta / attack : 1;
-        f32 vd = decay > td ? td / decay : 1;
-        f32 s = phase > 0.5 ? 1 : -1;
-
-        s = s * 0.25 * va * vd;
-        samples[i].left = s;
-        samples[i].right = s;
-        phase = f_fract(phase + dt * freq);
-    }
-    pix_play(pix, sample_count, samples);
-}
-
 // Game state
 typedef struct {
     Memory *mem;
@@ -49,8 +28,46 @@ typedef struct {
     bool input_sprint2;
 
     u32 high_score;
+
+    // Time of the next move
+    time_t step_time;
+
+    // Sound effects, synthesized while the game runs
+    Sound *snd;
+    Sound_Voices *voices;
 } Snake;
 
+// The game wakes up this often to synthesize more audio
+#define SNAKE_TICK (10 * TIME_MS)
+
+// Samples synthesized ahead of the speakers, has to last more than one tick
+#define SNAKE_AUDIO_AHEAD (PIX_AUDIO_RATE / 25)
+
+static void snake_play_sound(Snake *snake, f32 freq, f32 duration, f32 attack, f32 decay) {
+    Sound_Voice_Config cfg = {
+        .wave = Sound_Wave_Pulse,
+        .freq = freq,
+        .gain = 0.25,
+        .attack = attack,
+        .release = decay,
+        .duration = f_max(duration - decay, 0),
+    };
+    sound_voice_on(snake->voices, snake->voices->time, cfg);
+}
+
+// Synthesize sound effects until enough audio is queued for the next tick
+static void snake_audio(Snake *snake) {
+    u32 queued = pix_stream(snake->pix, 0, 0);
+    while (queued < SNAKE_AUDIO_AHEAD) {
+        sound_start(snake->snd);
+        Sound_Block out = sound_voices_block(snake->snd, snake->voices);
+
+        Pix_Audio_Sample samples[SOUND_BLOCK];
+        for (u32 i = 0; i < SOUND_BLOCK; ++i) samples[i] = (Pix_Audio_Sample){out.value[i], out.value[i]};
+        queued = pix_stream(snake->pix, SOUND_BLOCK, samples);
+    }
+}
+
 static void snake_draw(Snake *snake) {
     Level *level = snake->level;
     u8 *canvas = mem_array(mem_tmp(), u8, 4 * level->sx * level->sy);
@@ -98,6 +115,8 @@ static void os_main(void) {
         snake->pix = pix_new(mem, "Snake", (v2i){800, 600});
         snake->rand = rand_new();
         snake->level = snake_level_new(&snake->rand);
+        snake->snd = mem_struct(mem, Sound);
+        snake->voices = sound_voices_new(mem);
 
 #if OS_WASM
         js_set_html(
@@ -141,12 +160,18 @@ static void os_main(void) {
 #endif
     }
 
+    snake_audio(snake);
+    if (now < snake->step_time) {
+        os_sleep(MIN(snake->step_time - now, SNAKE_TICK));
+        return;
+    }
+
     if (snake->level->game_over) {
         if (snake->level->score > snake->high_score) {
             snake->high_score = snake->level->score;
-            snake_play_sound(snake->pix, 440.0, 0.5, 0, 0.5);
+            snake_play_sound(snake, 440.0, 0.5, 0, 0.5);
         } else {
-            snake_play_sound(snake->pix, 110.0, 0.5, 0, 0.5);
+            snake_play_sound(snake, 110.0, 0.5, 0, 0.5);
         }
         print("");
         print("---- Game Over ----");
@@ -197,19 +222,19 @@ static void os_main(void) {
         SnakeCell cell = snake_move(level);
         if (cell == SnakeCell_Snake || cell == SnakeCell_Wall) level->game_over = true;
         if (cell == SnakeCell_Food) {
-            snake_play_sound(snake->pix, OCT_3 * NOTE_B, 0.1f, 0.0, 0.1);
+            snake_play_sound(snake, OCT_3 * NOTE_B, 0.1f, 0.0, 0.1);
         }
     }
     if (snake_place_food(snake->level)) {
-        snake_play_sound(snake->pix, OCT_3 * NOTE_A, 0.1f, 0.0, 0.1);
+        snake_play_sound(snake, OCT_3 * NOTE_A, 0.1f, 0.0, 0.1);
     }
     snake_draw(snake);
 
     time_t delay = (snake->input_sprint || snake->input_sprint2) ? 50 * TIME_MS : 150 * TIME_MS;
-    time_t diff = now + delay - time_now();
+    snake->step_time = now + delay;
 #if OS_WASM
     js("(x) => document.getElementById('score').innerText = x", snake->level->score);
     js("(x) => document.getElementById('highscore').innerText = x", snake->high_score);
 #endif
-    os_sleep(diff);
+    os_sleep(MIN(snake->step_time - time_now(), SNAKE_TICK));
 }
@@ -4,16 +4,35 @@
 #include "cli.h"
 #include "crc.h"
 #include "deflate.h"
+#include "dwarf.h"
+#include "dwarf_cache.h"
+#include "dwarf_func.h"
+#include "dwarf_line.h"
 #include "fmt.h"
 #include "gzip.h"
+#include "hot.h"
 #include "huffman_code.h"
 #include "huffman_tree.h"
+#include "job.h"
 #include "macro_test.h"
+#include "mutex.h"
 #include "os_main.h"
+#include "parse.h"
 #include "read.h"
+#include "sort.h"
+#include "sound_filter.h"
+#include "sound_osc.h"
+#include "sound_voice.h"
 #include "str_test.h"
+#include "thread.h"
 #include "tlang.h"
+#include "tlang_doc.h"
+#include "tlang_exp.h"
+#include "tlang_intern.h"
+#include "tlang_jit.h"
+#include "tlang_vm.h"
 #include "tom.h"
+#include "zlib.h"
 
 #define TEST(FCN, ...) \
     ({ \
@@ -31,19 +50,38 @@ static void os_main(void) {
     TEST(test_cli_arg());
     TEST(test_crc());
     TEST(test_deflate());
+    TEST(test_dwarf());
+    TEST(test_dwarf_cache());
+    TEST(test_dwarf_func());
+    TEST(test_dwarf_line());
+    TEST(test_exp());
     TEST(test_fmt());
     TEST(test_gzip());
+    TEST(test_hot());
     TEST(test_huffman_code());
     TEST(test_huffman_tree());
+    TEST(test_job());
     TEST(test_macro());
     TEST(test_mem());
+    TEST(test_mutex());
+    TEST(test_parse());
     TEST(test_ptr());
     TEST(test_read());
+    TEST(test_sort());
+    TEST(test_sound_filter());
+    TEST(test_sound_osc());
+    TEST(test_sound_voice());
     TEST(test_str());
+    TEST(test_thread());
     TEST(test_time());
     TEST(test_tlang());
+    TEST(test_tlang_doc());
+    TEST(test_tlang_intern());
+    TEST(test_tlang_jit());
+    TEST(test_tlang_vm());
     TEST(test_tom());
     TEST(test_write());
+    TEST(test_zlib());
     if (!error) print("Success!");
     os_exit();
 }
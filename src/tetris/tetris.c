@@ -5,7 +5,7 @@
 #include "os_main.h"
 #include "pix.h"
 #include "rand.h"
-#include "sound.h"
+#include "sound_note.h"
 
 typedef struct {
     u8 x;
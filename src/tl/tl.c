@@ -3,6 +3,8 @@
 #include "base64.h"
 #include "cli.h"
 #include "dwarf.h"
+#include "dwarf_cache.h"
+#include "dwarf_line.h"
 #include "elf.h"
 #include "fs.h"
 #include "gzip.h"
@@ -67,6 +69,7 @@ static void tl_cmd_dump(Cli *cli, Memory *mem) {
 
 static void tl_cmd_elf(Cli *cli, Memory *mem) {
     cli_command(cli, "elf", "Elf and dwarf reader");
+    bool dump = cli_flag(cli, "-d", "--dump", "Print the DIE tree");
     char *path = cli_value(cli, "<Input>", "Input File");
     if (!cli_check(cli)) return;
 
@@ -78,7 +81,67 @@ static void tl_cmd_elf(Cli *cli, Memory *mem) {
     for (u32 i = 0; i < elf->section_count; ++i) {
         print(i, " ", elf->sections[i].size, " ", elf->sections[i].name);
     }
-    dwarf_load(mem, elf);
+
+    Dwarf_File *dwarf = dwarf_load(mem, elf);
+    if (error) return;
+    print("units: ", dwarf->unit_count, " dies: ", dwarf->die_count - 1, " attrs: ", dwarf->attr_count);
+    for (u32 i = 0; dump && i < dwarf->unit_count; ++i) {
+        Dwarf_Unit *unit = dwarf->units + i;
+        if (unit->die_count) dwarf_print_die(dwarf, dwarf->dies + unit->die_start, 0);
+    }
+}
+
+static void tl_cmd_addr2line(Cli *cli, Memory *mem) {
+    cli_command(cli, "addr2line", "Find the source line of an address");
+    bool functions = cli_flag(cli, "-f", "--functions", "Also print the function name");
+    bool use_cache = cli_flag(cli, "-c", "--cache", "Store the debug info indices in '<Input>.cache'");
+    char *path = cli_value(cli, "<Input>", "Input File");
+    char *addr_str = cli_value(cli, "<Address>", "Address in hex");
+    if (!cli_check(cli)) return;
+
+    u64 addr = 0;
+    Buffer hex = str_buf(addr_str);
+    if (buf_starts_with(hex, str_buf("0x"))) hex = buf_drop(hex, 2);
+    for (size_t i = 0; i < hex.size && chr_is_hex(hex.data[i]); ++i) addr = addr * 16 + chr_to_hex(hex.data[i]);
+
+    File *file = fs_open(path, FileMode_Read);
+    Elf *elf = elf_load(mem, file);
+    if (error) return;
+
+    if (use_cache) {
+        Dwarf_Cache *cache = dwarf_cache_load(mem, elf, path, fstr(mem, path, ".cache"));
+        if (error) return;
+
+        if (functions) {
+            Dwarf_Cache_Func *func = dwarf_cache_func(cache, addr);
+            print((func ? dwarf_cache_str(cache, func->name) : 0) ?: "??");
+        }
+
+        Dwarf_Line line = dwarf_cache_line(cache, addr);
+        if (!line.file) print("??:0");
+        else print(line.file, ":", line.line);
+        dwarf_cache_close(cache);
+        return;
+    }
+
+    // Only the unit containing the address is loaded
+    Dwarf_File *dwarf = dwarf_open(mem, elf);
+    if (error) return;
+
+    if (functions) {
+        Dwarf_Die *die = dwarf_subprogram_at(dwarf, addr);
+        char *name = die ? dwarf_die_name(dwarf, die) : 0;
+        if (!name) {
+            elf_load_symbols(mem, elf);
+            Elf_Symbol *sym = elf_find_symbol(elf, addr);
+            if (sym) name = sym->name;
+        }
+        print(name ?: "??");
+    }
+
+    Dwarf_Line line = dwarf_addr_to_line(dwarf, addr);
+    if (!line.file) print("??:0");
+    else print(line.file, ":", line.line);
 }
 
 static void os_main(void) {
@@ -89,6 +152,7 @@ static void os_main(void) {
     tl_cmd_gzip(cli, mem);
     tl_cmd_dump(cli, mem);
     tl_cmd_elf(cli, mem);
+    tl_cmd_addr2line(cli, mem);
     cli_help(cli);
     os_exit();
 }
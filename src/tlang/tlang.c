@@ -1,26 +1,105 @@
-#include "tlang.h"
 #include "fs.h"
+#include "fs_watch.h"
 #include "os_main.h"
+#include "time.h"
+#include "tlang_doc.h"
+#include "tlang_jit.h"
+
+// Measure lambda calculus reductions per second by computing 'even (2^20)'
+static void tlang_bench_exp(Memory *mem) {
+    Exp *t = exp_lambda(mem, exp_lambda(mem, exp_ref(mem, 1)));
+    Exp *f = exp_lambda(mem, exp_lambda(mem, exp_ref(mem, 0)));
+    Exp *not = exp_lambda(mem, exp_app(mem, exp_app(mem, exp_ref(mem, 0), f), t));
+    Exp *pow = exp_lambda(mem, exp_lambda(mem, exp_app(mem, exp_ref(mem, 0), exp_ref(mem, 1))));
+    Exp *n = exp_app(mem, exp_app(mem, pow, exp_church(mem, 2)), exp_church(mem, 20));
+
+    Exp_Machine m = {.mem = mem_new()};
+    time_t start = time_now();
+    Exp *even = exp_normalize(mem, &m, exp_app(mem, exp_app(mem, n, not), t));
+    time_t duration = time_now() - start;
+    mem_free(m.mem);
+
+    check_or(exp_eq(even, t)) return;
+    print("Steps: ", m.steps, " in ", duration / TIME_MS, " ms, ", m.steps * TIME_SEC / (duration + 1), " steps/s");
+}
+
+// Compile and run a block, printing all variables
+static void tlang_run(Memory *mem, Ast *ast) {
+    Tlang_Program *program = tlang_compile(mem, ast);
+    if (!program) return;
+
+    u32 *regs = mem_array_zero(mem, u32, program->reg_count);
+    Tlang_Jit jit = tlang_jit_compile(program);
+    tlang_jit_run(&jit, program, regs);
+    tlang_jit_free(&jit);
+    for (u32 i = 0; i < program->var_count; ++i) {
+        print(program->var_names[i], " = ", regs[i]);
+    }
+}
+
+// Watch state, only the changed statements are parsed again
+static Watch *watch;
+static Tlang_Doc *watch_doc;
+
+// Run a script every time it changes
+static void tlang_watch(char *path) {
+    bool init = !watch;
+    if (init) {
+        Memory *mem = mem_perm();
+        watch = fs_watch_new(mem);
+        if (!watch) {
+            print("Failed to create a file watcher");
+            os_exit();
+        }
+        fs_watch_add(watch, path);
+        watch_doc = tlang_doc_new(mem, tlang_intern_new(mem));
+    }
+
+    if (fs_watch_check(watch) || init) {
+        Memory *tmp = mem_new();
+        Buffer input = fs_read(tmp, path);
+        time_t start = time_now();
+        tlang_doc_update(watch_doc, input);
+        time_t duration = time_now() - start;
+        print("Parsed ", watch_doc->parse_count, "/", watch_doc->stmt_count, " statements in ", duration, " us");
+        if (!error) tlang_run(tmp, watch_doc->ast);
+        if (error) print("Error: ", error_pop());
+        mem_free(tmp);
+    }
+    os_sleep(10 * TIME_MS);
+}
 
 static void os_main(void) {
     Memory *mem = mem_perm();
-    check_or(os_argc == 2) return;
+    if (os_argc == 3 && str_eq(os_argv[1], "--watch")) {
+        tlang_watch(os_argv[2]);
+        return;
+    }
+
+    if (os_argc != 2) {
+        print("Usage: ", os_argv[0], " <FILE> | --watch <FILE> | --bench");
+        os_exit();
+    }
+
+    if (str_eq(os_argv[1], "--bench")) {
+        tlang_bench_exp(mem);
+        os_exit();
+    }
 
     Buffer input = fs_read(mem, os_argv[1]);
-    Ast *ast = tlang_lex(mem, input);
-    for (Ast *tok = ast; tok; tok = tok->next_token) {
-        print("Tok: ", " type ", tok->type, " text ", tok->text);
+    Tlang_Intern *intern = tlang_intern_new(mem);
+    Tlang_Tokens tokens = tlang_lex(mem, intern, input);
+    for (u32 i = 0; i < tokens.count; ++i) {
+        Tlang_Token *tok = tokens.token + i;
+        print("Tok: ", " type ", tok->type, " text ", tlang_token_text(input, tok));
     }
-    Parse p = {.token = ast};
-    ast = tlang_parse(&p);
+    Tlang_Parse p = {.mem = mem, .tokens = tokens};
+    Ast *ast = tlang_parse(&p);
 
     Fmt *f = fmt_new(mem);
     tlang_fmt(f, ast, 0);
     io_write(io_stdout(), fmt_end(f));
 
-    Stack *env = tlang_eval_block(mem, ast);
-    for (Stack *s = env; s; s = s->next) {
-        print(s->name, " = ", s->value);
-    }
+    tlang_run(mem, ast);
     os_exit();
 }
@@ -2,70 +2,10 @@
 #include "fmt.h"
 #include "list.h"
 #include "mem.h"
+#include "tlang_exp.h"
+#include "tlang_intern.h"
 #include "type.h"
 
-// data Exp = L Exp | A Exp Exp | R Int deriving (Show, Eq)
-
-typedef struct Exp Exp;
-
-typedef struct {
-    Exp *body;
-} Exp_Lambda;
-
-typedef struct {
-    Exp *fun;
-    Exp *arg;
-} Exp_App;
-
-typedef struct {
-    u32 ix;
-} Exp_Ref;
-
-typedef enum {
-    Exp_Type_None,
-    Exp_Type_Lambda,
-    Exp_Type_App,
-    Exp_Type_Ref,
-} Exp_Type;
-
-struct Exp {
-    Exp_Type type;
-    union {
-        Exp_App app;
-        Exp_Lambda lambda;
-        Exp_Ref ref;
-    };
-};
-
-static Exp *exp_app(Memory *mem, Exp *fun, Exp *arg) {
-    Exp *exp = mem_struct(mem, Exp);
-    exp->type = Exp_Type_App;
-    exp->app.fun = fun;
-    exp->app.arg = arg;
-    return exp;
-}
-
-static Exp *exp_lambda(Memory *mem, Exp *body) {
-    Exp *exp = mem_struct(mem, Exp);
-    exp->type = Exp_Type_Lambda;
-    exp->lambda.body = body;
-    return exp;
-}
-
-static Exp *exp_ref(Memory *mem, u32 ix) {
-    Exp *exp = mem_struct(mem, Exp);
-    exp->type = Exp_Type_Ref;
-    exp->ref.ix = ix;
-    return exp;
-}
-
-static Exp *exp_eval(Exp *e) {
-    // A(L(b), x)
-    if (e->type == Exp_Type_App && e->lambda.body->type == Exp_Type_Lambda) {
-    }
-    return 0;
-}
-
 typedef enum {
     Ast_Type_None,
     Ast_Type_Number,
@@ -75,86 +15,167 @@ typedef enum {
     Ast_Type_Error,
 } Ast_Type;
 
+// Labels and operators are interned, numbers and comments are only read from the source
+// - Editing a number or comment does not add symbols that live as long as the interner
+typedef struct {
+    Ast_Type type;
+    u32 sym;    // Symbol of a label or operator, 0 otherwise
+    u32 offset; // Byte offset in the source
+    u32 size;   // Size in bytes, including the '//' of a comment
+} Tlang_Token;
+
+typedef struct {
+    Tlang_Intern *intern;
+    Buffer input; // Source the token offsets point into
+    u32 count;
+    Tlang_Token *token;
+} Tlang_Tokens;
+
 typedef struct Ast Ast;
 struct Ast {
     Ast_Type type;
+    u32 sym;   // Interned text of a label or operator
+    u32 value; // Value of a number
     Buffer text;
-    Ast *next_token;
     Ast *next;
     Ast *child;
 };
 
-static Ast *tlang_lex(Memory *mem, Buffer input) {
-    Ast *list_start = 0;
-    Ast *list_end = 0;
-
-    u8 *cursor = input.data;
+// Lex the next token starting at 'offset', returns false at the end of the input
+static bool tlang_lex_token(Tlang_Intern *intern, Buffer input, u32 *offset, Tlang_Token *tok) {
+    u8 *cursor = input.data + *offset;
     u8 *end = input.data + input.size;
 
-    while (cursor < end) {
-        u8 *start = cursor++;
-        u8 chr = *start;
-
-        // Skip whitespace
-        if (chr_is_whitespace(chr)) continue;
-
-        // Create node
-        Ast *node = mem_struct(mem, Ast);
-        if (chr_is_digit(chr)) {
-            node->type = Ast_Type_Number;
-            while (cursor < end && (chr_is_digit(*cursor) || chr_is_alpha(*cursor) || *cursor == '.' || *cursor == '\'')) cursor++;
-        } else if (chr_is_alpha(chr)) {
-            node->type = Ast_Type_Label;
-            while (cursor < end && (chr_is_digit(*cursor) || chr_is_alpha(*cursor))) cursor++;
-        } else if (chr == '/' && *cursor == '/') {
-            start += 2;
-            node->type = Ast_Type_Comment;
-            while (cursor < end && *cursor != '\n' && *cursor != '\r') cursor++;
-        } else {
-            node->type = Ast_Type_Operator;
+    // Skip whitespace
+    while (cursor < end && chr_is_whitespace(*cursor)) cursor++;
+    if (cursor == end) {
+        *offset = input.size;
+        return false;
+    }
+
+    u8 *start = cursor++;
+    u8 chr = *start;
+
+    Ast_Type type = Ast_Type_Operator;
+    if (chr_is_digit(chr)) {
+        type = Ast_Type_Number;
+        while (cursor < end && (chr_is_digit(*cursor) || chr_is_alpha(*cursor) || *cursor == '.' || *cursor == '\'')) cursor++;
+    } else if (chr_is_alpha(chr)) {
+        type = Ast_Type_Label;
+        while (cursor < end && (chr_is_digit(*cursor) || chr_is_alpha(*cursor))) cursor++;
+    } else if (chr == '/' && cursor < end && *cursor == '/') {
+        type = Ast_Type_Comment;
+        while (cursor < end && *cursor != '\n' && *cursor != '\r') cursor++;
+    }
+
+    tok->type = type;
+    tok->sym = 0;
+    if (type == Ast_Type_Label || type == Ast_Type_Operator) tok->sym = tlang_intern(intern, buf_from(start, cursor - start));
+    tok->offset = start - input.data;
+    tok->size = cursor - start;
+    *offset = cursor - input.data;
+    return true;
+}
+
+// First and one past the last byte of a token in the source
+static u32 tlang_token_start(Tlang_Token *tok) {
+    return tok->offset;
+}
+
+static u32 tlang_token_end(Tlang_Token *tok) {
+    return tok->offset + tok->size;
+}
+
+// Text of a token in the source
+static Buffer tlang_token_text(Buffer input, Tlang_Token *tok) {
+    return buf_from(input.data + tok->offset, tok->size);
+}
+
+static Tlang_Tokens tlang_lex(Memory *mem, Tlang_Intern *intern, Buffer input) {
+    Tlang_Tokens tokens = {.intern = intern, .input = input};
+    u32 cap = 0;
+    u32 offset = 0;
+    for (;;) {
+        if (tokens.count == cap) {
+            u32 new_cap = cap ? cap * 2 : 256;
+            tokens.token = (Tlang_Token *)mem_realloc(mem, (u8 *)tokens.token, cap * sizeof(Tlang_Token), new_cap * sizeof(Tlang_Token));
+            cap = new_cap;
         }
-        node->text = buf_from(start, cursor - start);
-        LIST_APPEND_NEXT(list_start, list_end, node, next_token);
+        if (!tlang_lex_token(intern, input, &offset, tokens.token + tokens.count)) break;
+        tokens.count++;
     }
-    return list_start;
+    return tokens;
 }
 
 typedef struct {
     Memory *mem;
-    Ast *token;
-} Parse;
+    Tlang_Tokens tokens;
 
-static Ast *parse_fail(Parse *p, char *message) {
+    // Next token to parse
+    u32 index;
+} Tlang_Parse;
+
+static Ast *parse_fail(Tlang_Parse *p, char *message) {
     Ast *err = mem_struct(p->mem, Ast);
     err->type = Ast_Type_Error;
     err->text = str_buf(message);
     return err;
 }
 
-static Ast *tlang_parse_token_ex(Parse *p, Ast_Type type, char *text) {
-    Ast *tok = p->token;
-    if (!tok) return 0;
+static u32 u32_from_buffer(Buffer in) {
+    u32 value = 0;
+    for (u32 i = 0; i < in.size; ++i) {
+        u8 chr = in.data[i];
+        check(chr >= '0' && chr <= '9');
+        if (error) return 0;
+        value *= 10;
+        value += chr - '0';
+    }
+    return value;
+}
+
+// Consume the next token if it matches, 'sym' is ignored when negative
+static Tlang_Token *tlang_parse_match(Tlang_Parse *p, Ast_Type type, i32 sym) {
+    while (p->index < p->tokens.count && p->tokens.token[p->index].type == Ast_Type_Comment) p->index++;
+    if (p->index >= p->tokens.count) return 0;
+    Tlang_Token *tok = p->tokens.token + p->index;
     if (type && tok->type != type) return 0;
-    if (text && !buf_eq(tok->text, str_buf(text))) return 0;
-    p->token = tok->next_token;
-    tok->child = 0;
-    tok->next = 0;
+    if (sym >= 0 && tok->sym != (u32)sym) return 0;
+    p->index++;
     return tok;
 }
 
-static Ast *tlang_parse_number(Parse *parse) {
-    return tlang_parse_token_ex(parse, Ast_Type_Number, 0);
+static Ast *tlang_parse_token_ex(Tlang_Parse *p, Ast_Type type, i32 sym) {
+    Tlang_Token *tok = tlang_parse_match(p, type, sym);
+    if (!tok) return 0;
+
+    Ast *ast = mem_struct(p->mem, Ast);
+    ast->type = tok->type;
+    ast->sym = tok->sym;
+    if (tok->type == Ast_Type_Number) {
+        // The Ast can outlive the source, so the text is copied
+        Buffer text = tlang_token_text(p->tokens.input, tok);
+        ast->text = buf_from(mem_clone(p->mem, text.data, text.size), text.size);
+        ast->value = u32_from_buffer(ast->text);
+    } else {
+        ast->text = p->tokens.intern->names[tok->sym];
+    }
+    return ast;
+}
+
+static Ast *tlang_parse_number(Tlang_Parse *parse) {
+    return tlang_parse_token_ex(parse, Ast_Type_Number, -1);
 }
 
-static Ast *tlang_parse_op(Parse *parse, char *op) {
+static Ast *tlang_parse_op(Tlang_Parse *parse, Tlang_Sym op) {
     return tlang_parse_token_ex(parse, Ast_Type_Operator, op);
 }
 
-static Ast *tlang_parse_label(Parse *parse) {
-    return tlang_parse_token_ex(parse, Ast_Type_Label, 0);
+static Ast *tlang_parse_label(Tlang_Parse *parse) {
+    return tlang_parse_token_ex(parse, Ast_Type_Label, -1);
 }
 
-static Ast *tlang_parse_literal(Parse *parse) {
+static Ast *tlang_parse_literal(Tlang_Parse *parse) {
     Ast *num = tlang_parse_number(parse);
     if (num) return num;
 
@@ -163,9 +184,9 @@ static Ast *tlang_parse_literal(Parse *parse) {
     return 0;
 }
 
-static Ast *tlang_parse_mul(Parse *p) {
+static Ast *tlang_parse_mul(Tlang_Parse *p) {
     Ast *lhs = tlang_parse_literal(p);
-    Ast *op = tlang_parse_op(p, "*");
+    Ast *op = tlang_parse_op(p, Tlang_Sym_Mul);
     if (!op) return lhs;
 
     Ast *rhs = tlang_parse_mul(p);
@@ -175,9 +196,9 @@ static Ast *tlang_parse_mul(Parse *p) {
     return op;
 }
 
-static Ast *tlang_parse_expr(Parse *p) {
+static Ast *tlang_parse_expr(Tlang_Parse *p) {
     Ast *lhs = tlang_parse_mul(p);
-    Ast *op = tlang_parse_op(p, "+");
+    Ast *op = tlang_parse_op(p, Tlang_Sym_Add);
     if (!op) return lhs;
 
     Ast *rhs = tlang_parse_expr(p);
@@ -187,17 +208,16 @@ static Ast *tlang_parse_expr(Parse *p) {
     return op;
 }
 
-static Ast *tlang_parse_statement(Parse *p) {
+static Ast *tlang_parse_statement(Tlang_Parse *p) {
     Ast *label = tlang_parse_label(p);
     if (!label) return 0;
 
-    Ast *op = tlang_parse_op(p, "=");
+    Ast *op = tlang_parse_op(p, Tlang_Sym_Assign);
     if (op) {
         // [label] = [expr]
         Ast *expr = tlang_parse_expr(p);
         if (!expr) return 0;
-        Ast *end = tlang_parse_op(p, ";");
-        if (!end) return 0;
+        if (!tlang_parse_match(p, Ast_Type_Operator, Tlang_Sym_End)) return 0;
         op->child = label;
         label->next = expr;
         return op;
@@ -211,13 +231,11 @@ static Ast *tlang_parse_statement(Parse *p) {
         LIST_APPEND(label->child, last_arg, arg);
     }
 
-    Ast *end = tlang_parse_op(p, ";");
-    if (!end) return 0;
-
+    if (!tlang_parse_match(p, Ast_Type_Operator, Tlang_Sym_End)) return 0;
     return label;
 }
 
-static Ast *tlang_parse(Parse *p) {
+static Ast *tlang_parse(Tlang_Parse *p) {
     Ast *block_start = 0;
     Ast *block_end = 0;
     for (;;) {
@@ -225,7 +243,7 @@ static Ast *tlang_parse(Parse *p) {
         if (!stm) break;
         LIST_APPEND(block_start, block_end, stm);
     }
-    check(p->token == 0);
+    check(p->index == p->tokens.count);
     return block_start;
 }
 
@@ -240,33 +258,22 @@ static void tlang_fmt(Fmt *fmt, Ast *ast, u32 indent) {
     tlang_fmt(fmt, ast->next, indent);
 }
 
-static u32 u32_from_buffer(Buffer in) {
-    u32 value = 0;
-    for (u32 i = 0; i < in.size; ++i) {
-        u8 chr = in.data[i];
-        check(chr >= '0' && chr <= '9');
-        if (error) return 0;
-        value *= 10;
-        value += chr - '0';
-    }
-    return value;
-}
-
 typedef struct Stack Stack;
 
 struct Stack {
     Buffer name;
+    u32 sym;
     u32 value;
     Stack *next;
 };
 
 static u32 tlang_eval_expr(Ast *ast, Stack *stack) {
     if (ast->type == Ast_Type_Number) {
-        return u32_from_buffer(ast->text);
+        return ast->value;
     }
 
     if (ast->type == Ast_Type_Operator) {
-        if (buf_eq(ast->text, str_buf("*"))) {
+        if (ast->sym == Tlang_Sym_Mul) {
             u32 value = 1;
             Ast *child = ast->child;
             while (child) {
@@ -275,7 +282,7 @@ static u32 tlang_eval_expr(Ast *ast, Stack *stack) {
             }
             return value;
         }
-        if (buf_eq(ast->text, str_buf("+"))) {
+        if (ast->sym == Tlang_Sym_Add) {
             u32 value = 0;
             Ast *child = ast->child;
             while (child) {
@@ -288,7 +295,7 @@ static u32 tlang_eval_expr(Ast *ast, Stack *stack) {
 
     if (ast->type == Ast_Type_Label) {
         for (Stack *s = stack; s; s = s->next) {
-            if (buf_eq(s->name, ast->text)) {
+            if (s->sym == ast->sym) {
                 return s->value;
             }
         }
@@ -305,6 +312,7 @@ static Stack *tlang_eval_block(Memory *mem, Ast *ast) {
     for (; ast; ast = ast->next) {
         Stack *item = mem_struct(mem, Stack);
         item->name = ast->child->text;
+        item->sym = ast->child->sym;
         item->value = tlang_eval_expr(ast->child->next, stack);
         item->next = stack;
         stack = item;
@@ -314,17 +322,24 @@ static Stack *tlang_eval_block(Memory *mem, Ast *ast) {
 
 static void test_tlang(void) {
     Memory *mem = mem_new();
-    Ast *ast = tlang_lex(mem, str_buf("x = 1*2*3;\ny=4*5*6;z=x+y;w=x*y;"));
-    // for (Ast *tok = ast; tok; tok = tok->next_token) {
-    //     print("Tok: ", " type ", tok->type, " text ", tok->text);
+    Tlang_Intern *intern = tlang_intern_new(mem);
+    Tlang_Tokens tokens = tlang_lex(mem, intern, str_buf("x = 1*2*3;\ny=4*5*6;z=x+y;w=x*y;"));
+    // for (u32 i = 0; i < tokens.count; ++i) {
+    //     print("Tok: ", " type ", tokens.token[i].type, " text ", intern->names[tokens.token[i].sym]);
     // }
 
-    Parse p = {.token = ast};
-    ast = tlang_parse(&p);
+    // Equal text gives equal symbols
+    check(tokens.count == 28);
+    check(tokens.token[0].sym == tokens.token[18].sym);
+    check(tokens.token[1].sym == Tlang_Sym_Assign);
+
+    Tlang_Parse p = {.mem = mem, .tokens = tokens};
+    Ast *ast = tlang_parse(&p);
     Fmt *out = fmt_new(mem);
     tlang_fmt(out, ast, 0);
     io_write(io_stdout(), fmt_end(out));
     Stack *env = tlang_eval_block(mem, ast);
+    check(env->value == 6 * 120);
     // for (Stack *s = env; s; s = s->next) {
     //     print(s->name, " = ", s->value);
     // }
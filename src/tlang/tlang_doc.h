@@ -0,0 +1,441 @@
+// Copyright (c) 2026 - Tom Smeets <tom@tsmeets.nl>
+// tlang_doc.h - Incrementally re-lex and re-parse changed tlang source
+#pragma once
+#include "rand.h"
+#include "tlang.h"
+
+// Usage:
+//   Tlang_Doc *doc = tlang_doc_new(mem, intern);
+//   for (;;) {
+//       tlang_doc_update(doc, fs_read(tmp, path));
+//       if (doc->ast) run(doc->ast);
+//   }
+//
+// The new source is compared with the previous one to find the edited range.
+// Only tokens touching the edit are lexed again, lexing stops as soon as it is
+// back in sync with the old tokens. Likewise only the statements containing
+// changed tokens are parsed again, all other statements keep their Ast.
+//
+// Replaced Ast nodes stay allocated until there are more than TLANG_DOC_GARBAGE
+// of them beyond the number of live statements. Then all statements are parsed
+// again into new memory and the old memory is freed, so a long running document
+// does not grow without bound.
+
+// Replaced statements allowed before the Ast memory is compacted
+#define TLANG_DOC_GARBAGE 1024
+
+typedef struct {
+    // First token of the statement, up to the first token of the next one
+    u32 token;
+    Ast *ast;
+} Tlang_Stmt;
+
+typedef struct {
+    Memory *mem;
+    Tlang_Intern *intern;
+
+    // Copy of the current source
+    Memory *source_mem;
+    u32 source_cap;
+    Buffer source;
+
+    u32 token_cap;
+    Tlang_Tokens tokens;
+
+    u32 stmt_count;
+    u32 stmt_cap;
+    Tlang_Stmt *stmts;
+
+    // Token after the last statement, only comments follow
+    u32 stmt_end;
+
+    // All statements linked with 'next', 0 if the source contains an error
+    Ast *ast;
+
+    // Ast nodes of all statements, including replaced ones
+    Memory *ast_mem;
+
+    // Statements parsed into 'ast_mem' that were replaced since the last compaction
+    u32 garbage;
+    u32 compact_count;
+
+    // Work done by the last update
+    u32 lex_count;
+    u32 parse_count;
+} Tlang_Doc;
+
+static Tlang_Doc *tlang_doc_new(Memory *mem, Tlang_Intern *intern) {
+    Tlang_Doc *doc = mem_struct(mem, Tlang_Doc);
+    doc->mem = mem;
+    doc->intern = intern;
+    doc->source_mem = mem_new();
+    doc->ast_mem = mem_new();
+    doc->tokens.intern = intern;
+    return doc;
+}
+
+static void tlang_doc_free(Tlang_Doc *doc) {
+    mem_free(doc->source_mem);
+    mem_free(doc->ast_mem);
+}
+
+// Replace 'count' items at 'index' with 'insert_count' items, growing the array if needed
+static void *tlang_doc_splice(Memory *mem, void *data, u32 *size, u32 *cap, u32 item_size, u32 index, u32 count, u32 insert_count) {
+    u32 new_size = *size - count + insert_count;
+    if (new_size > *cap) {
+        u32 new_cap = *cap ? *cap * 2 : 256;
+        while (new_cap < new_size) new_cap *= 2;
+        data = mem_realloc(mem, data, *cap * item_size, new_cap * item_size);
+        *cap = new_cap;
+    }
+
+    u8 *bytes = data;
+    u32 tail = *size - index - count;
+    if (count != insert_count) __builtin_memmove(bytes + (index + insert_count) * item_size, bytes + (index + count) * item_size, tail * item_size);
+    *size = new_size;
+    return data;
+}
+
+// Lex the edited range again
+// - Old tokens '[first, *old_end)' are replaced by '[first, *new_end)'
+static void tlang_doc_lex(Tlang_Doc *doc, Buffer source, u32 edit_start, u32 edit_end, u32 *first, u32 *old_end, u32 *new_end) {
+    Tlang_Token *old = doc->tokens.token;
+    u32 old_count = doc->tokens.count;
+    i64 delta = (i64)source.size - (i64)doc->source.size;
+
+    // Tokens ending before the edit are unchanged, find the first one that is not
+    u32 lo = 0, hi = old_count;
+    while (lo < hi) {
+        u32 mid = lo + (hi - lo) / 2;
+        if (tlang_token_end(old + mid) < edit_start) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    // Start lexing right after the last unchanged token
+    u32 start = lo;
+    u32 offset = start ? tlang_token_end(old + start - 1) : 0;
+
+    Memory *tmp = mem_new();
+    u32 lexed_cap = 0;
+    u32 lexed_count = 0;
+    Tlang_Token *lexed = 0;
+
+    u32 sync = start;
+    for (;;) {
+        Tlang_Token tok;
+        if (!tlang_lex_token(doc->intern, source, &offset, &tok)) {
+            sync = old_count;
+            break;
+        }
+
+        // Past the edit, the old tokens are valid again once a token starts at the same place
+        u32 tok_start = tlang_token_start(&tok);
+        if (tok_start >= edit_end) {
+            while (sync < old_count && tlang_token_start(old + sync) + delta < tok_start) sync++;
+            if (sync < old_count && tlang_token_start(old + sync) + delta == tok_start) break;
+        }
+
+        if (lexed_count == lexed_cap) {
+            u32 new_cap = lexed_cap ? lexed_cap * 2 : 64;
+            lexed = (Tlang_Token *)mem_realloc(tmp, (u8 *)lexed, lexed_cap * sizeof(Tlang_Token), new_cap * sizeof(Tlang_Token));
+            lexed_cap = new_cap;
+        }
+        lexed[lexed_count++] = tok;
+    }
+
+    // Replace the changed tokens and move the ones after it
+    doc->tokens.token = tlang_doc_splice(doc->mem, doc->tokens.token, &doc->tokens.count, &doc->token_cap, sizeof(Tlang_Token), start, sync - start, lexed_count);
+    ptr_copy(doc->tokens.token + start, lexed, lexed_count * sizeof(Tlang_Token));
+    if (delta) {
+        for (u32 i = start + lexed_count; i < doc->tokens.count; ++i) doc->tokens.token[i].offset += delta;
+    }
+    mem_free(tmp);
+
+    doc->lex_count = lexed_count;
+    *first = start;
+    *old_end = sync;
+    *new_end = start + lexed_count;
+}
+
+// Check that only comments are left
+static bool tlang_doc_at_end(Tlang_Doc *doc, u32 index) {
+    for (; index < doc->tokens.count; ++index) {
+        if (doc->tokens.token[index].type != Ast_Type_Comment) return false;
+    }
+    return true;
+}
+
+// Parse the statements containing changed tokens again
+static void tlang_doc_parse(Tlang_Doc *doc, u32 first, u32 old_end, u32 new_end) {
+    i64 shift = (i64)new_end - (i64)old_end;
+    u32 old_count = doc->stmt_count;
+    Tlang_Stmt *old = doc->stmts;
+
+    // Last statement starting at or before the first changed token
+    u32 a = 0;
+    if (first >= doc->stmt_end) {
+        a = old_count;
+    } else {
+        u32 lo = 0, hi = old_count;
+        while (lo < hi) {
+            u32 mid = lo + (hi - lo) / 2;
+            if (old[mid].token <= first) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        a = lo ? lo - 1 : 0;
+    }
+
+    Memory *tmp = mem_new();
+    u32 parsed_cap = 0;
+    u32 parsed_count = 0;
+    Tlang_Stmt *parsed = 0;
+
+    Tlang_Parse p = {.mem = doc->ast_mem, .tokens = doc->tokens};
+    p.index = a < old_count ? old[a].token : doc->stmt_end;
+    u32 stmt_end = p.index;
+
+    // Parse until we arrive at the start of an unchanged statement
+    u32 b = a;
+    bool ok = true;
+    for (;;) {
+        while (b < old_count && (old[b].token < old_end || old[b].token + shift < p.index)) b++;
+        if (b < old_count && old[b].token + shift == p.index) {
+            stmt_end = doc->stmt_end + shift;
+            break;
+        }
+
+        u32 start = p.index;
+        Ast *stm = tlang_parse_statement(&p);
+        if (!stm) {
+            ok = tlang_doc_at_end(doc, start);
+            b = old_count;
+            break;
+        }
+
+        if (parsed_count == parsed_cap) {
+            u32 new_cap = parsed_cap ? parsed_cap * 2 : 16;
+            parsed = (Tlang_Stmt *)mem_realloc(tmp, (u8 *)parsed, parsed_cap * sizeof(Tlang_Stmt), new_cap * sizeof(Tlang_Stmt));
+            parsed_cap = new_cap;
+        }
+        parsed[parsed_count++] = (Tlang_Stmt){start, stm};
+        stmt_end = p.index;
+    }
+    doc->parse_count = parsed_count;
+
+    if (!ok) {
+        // Parse everything again next time
+        mem_free(tmp);
+        doc->garbage += old_count + parsed_count;
+        doc->stmt_count = 0;
+        doc->stmt_end = 0;
+        doc->ast = 0;
+        error_set("Failed to parse statement");
+        return;
+    }
+
+    // Replace the changed statements and move the ones after it
+    doc->garbage += b - a;
+    doc->stmts = tlang_doc_splice(doc->mem, doc->stmts, &doc->stmt_count, &doc->stmt_cap, sizeof(Tlang_Stmt), a, b - a, parsed_count);
+    ptr_copy(doc->stmts + a, parsed, parsed_count * sizeof(Tlang_Stmt));
+    if (shift) {
+        for (u32 i = a + parsed_count; i < doc->stmt_count; ++i) doc->stmts[i].token += shift;
+    }
+    doc->stmt_end = stmt_end;
+    mem_free(tmp);
+
+    // Link the new statements into the block, the other links are unchanged
+    u32 link_start = a ? a - 1 : 0;
+    u32 link_end = a + parsed_count + 1;
+    if (link_end > doc->stmt_count) link_end = doc->stmt_count;
+    for (u32 i = link_start; i < link_end; ++i) {
+        doc->stmts[i].ast->next = i + 1 < doc->stmt_count ? doc->stmts[i + 1].ast : 0;
+    }
+    doc->ast = doc->stmt_count ? doc->stmts[0].ast : 0;
+}
+
+// Parse all statements again into new memory and free the replaced Ast nodes
+static void tlang_doc_compact(Tlang_Doc *doc) {
+    Memory *old = doc->ast_mem;
+    doc->ast_mem = mem_new();
+    doc->garbage = 0;
+    doc->compact_count++;
+
+    // Nothing is live after a parse error
+    if (doc->ast) {
+        u32 parse_count = doc->parse_count;
+        doc->stmt_count = 0;
+        doc->stmt_end = 0;
+        tlang_doc_parse(doc, 0, 0, 0);
+        doc->parse_count = parse_count;
+    }
+    mem_free(old);
+}
+
+// Replace the source, where only the bytes '[edit_start, edit_end)' of the new source differ
+// - Everything before and after that range is equal to the previous source
+static void tlang_doc_edit(Tlang_Doc *doc, Buffer source, u32 edit_start, u32 edit_end) {
+    u32 first, old_end, new_end;
+    tlang_doc_lex(doc, source, edit_start, edit_end, &first, &old_end, &new_end);
+
+    // Keep a copy for the next update, reusing the old copy when it fits
+    if (source.size > doc->source_cap) {
+        mem_free(doc->source_mem);
+        doc->source_mem = mem_new();
+        doc->source_cap = source.size * 2;
+        doc->source.data = mem_array(doc->source_mem, u8, doc->source_cap);
+    }
+    __builtin_memcpy(doc->source.data, source.data, source.size);
+    doc->source.size = source.size;
+    doc->tokens.input = doc->source;
+
+    tlang_doc_parse(doc, first, old_end, new_end);
+    if (doc->garbage > doc->stmt_count + TLANG_DOC_GARBAGE) tlang_doc_compact(doc);
+}
+
+// Count equal bytes going forward from 'a' and 'b' or backward from just before them
+// - Compares 8 bytes at a time, so finding the edit in a large file is fast
+static u32 tlang_doc_match(u8 *a, u8 *b, u32 max, i32 dir) {
+    u32 count = 0;
+    for (; count + 8 <= max; count += 8) {
+        u64 wa, wb;
+        i64 at = dir > 0 ? (i64)count : -(i64)count - 8;
+        __builtin_memcpy(&wa, a + at, 8);
+        __builtin_memcpy(&wb, b + at, 8);
+        if (wa != wb) break;
+    }
+    for (; count < max; ++count) {
+        i64 at = dir > 0 ? (i64)count : -(i64)count - 1;
+        if (a[at] != b[at]) break;
+    }
+    return count;
+}
+
+// Replace the source, the changed range is found by comparing with the previous source
+static void tlang_doc_update(Tlang_Doc *doc, Buffer source) {
+    Buffer old = doc->source;
+    doc->lex_count = 0;
+    doc->parse_count = 0;
+
+    u32 min_size = old.size < source.size ? old.size : source.size;
+    u32 prefix = tlang_doc_match(old.data, source.data, min_size, 1);
+    if (prefix == old.size && prefix == source.size && (doc->ast || doc->stmt_count)) return;
+
+    u32 suffix = tlang_doc_match(old.data + old.size, source.data + source.size, min_size - prefix, -1);
+    tlang_doc_edit(doc, source, prefix, source.size - suffix);
+}
+
+static void test_tlang_doc(void) {
+    Memory *mem = mem_new();
+    Tlang_Intern *intern = tlang_intern_new(mem);
+    Tlang_Doc *doc = tlang_doc_new(mem, intern);
+
+    // Compare with parsing everything
+    Buffer lines[64];
+    u32 line_count = 0;
+    for (; line_count < 40; ++line_count) lines[line_count] = str_buf(fstr(mem, "v", line_count, " = ", line_count, " * 2 + x;"));
+
+    Rand rng = rand_from(1);
+    Ast *kept = 0;
+    for (u32 iter = 0; iter < 300; ++iter) {
+        u32 ix = rand_u32(&rng, 0, line_count);
+        u32 action = rand_u32(&rng, 0, 6);
+        if (action == 0 && line_count < array_count(lines)) {
+            for (u32 i = line_count; i > ix; --i) lines[i] = lines[i - 1];
+            lines[ix] = str_buf(fstr(mem, "n", iter, " = ", iter, ";"));
+            line_count++;
+        } else if (action == 1 && line_count > 1) {
+            for (u32 i = ix; i + 1 < line_count; ++i) lines[i] = lines[i + 1];
+            line_count--;
+        } else if (action == 2) {
+            lines[ix] = str_buf(fstr(mem, "// comment ", iter));
+        } else if (action == 3) {
+            lines[ix] = str_buf(fstr(mem, "v", ix, " = ", iter, "*", ix, "+y", iter, ";"));
+        } else if (action == 4) {
+            lines[ix] = str_buf(fstr(mem, "v", ix, " = ", iter, " ", ix, ";"));
+        } else {
+            lines[ix] = str_buf(fstr(mem, "p", ix, " x y;"));
+        }
+
+        Fmt *source = fmt_new(mem);
+        for (u32 i = 0; i < line_count; ++i) fmt_g(source, lines[i], "\n");
+        Buffer text = fmt_end(source);
+
+        Tlang_Parse p = {.mem = mem, .tokens = tlang_lex(mem, intern, text)};
+        Ast *expect = tlang_parse(&p);
+        bool expect_ok = !error_pop();
+
+        tlang_doc_update(doc, text);
+        bool doc_ok = !error_pop();
+        check(doc_ok == expect_ok);
+        if (!doc_ok) {
+            kept = 0;
+            continue;
+        }
+
+        // Same tokens
+        check(doc->tokens.count == p.tokens.count);
+        for (u32 i = 0; i < doc->tokens.count && i < p.tokens.count; ++i) {
+            Tlang_Token *a = doc->tokens.token + i;
+            Tlang_Token *b = p.tokens.token + i;
+            check(a->type == b->type && a->sym == b->sym && a->offset == b->offset && a->size == b->size);
+        }
+
+        // Same tree
+        Fmt *f1 = fmt_new(mem);
+        Fmt *f2 = fmt_new(mem);
+        tlang_fmt(f1, doc->ast, 0);
+        tlang_fmt(f2, expect, 0);
+        check(buf_eq(fmt_end(f1), fmt_end(f2)));
+        if (error) break;
+
+        // A single line edit only parses a few statements
+        if (kept) check(doc->parse_count <= 3);
+        kept = doc->ast;
+    }
+
+    // Editing a value keeps the other statements
+    tlang_doc_update(doc, str_buf("a = 1; b = 2; c = 3;"));
+    Ast *a = doc->stmts[0].ast;
+    Ast *c = doc->stmts[2].ast;
+    tlang_doc_update(doc, str_buf("a = 1; b = 22; c = 3;"));
+    check(doc->lex_count == 1);
+    check(doc->parse_count == 1);
+    check(doc->stmts[0].ast == a && doc->stmts[2].ast == c);
+    check(doc->stmts[1].ast->child->next->value == 22);
+
+    // Recover after an error
+    tlang_doc_update(doc, str_buf("a = 1; b = 22 c = 3;"));
+    check(error_pop());
+    check(!doc->ast);
+    tlang_doc_update(doc, str_buf("a = 1; b = 22; c = 3;"));
+    check(doc->ast && doc->stmt_count == 3);
+
+    // Replaced statements are freed eventually
+    // - Numbers and comments are not interned, so the interner does not grow
+    u32 compact_count = doc->compact_count;
+    u32 sym_count = intern->count;
+    for (u32 i = 0; i < 2 * TLANG_DOC_GARBAGE; ++i) {
+        tlang_doc_update(doc, str_buf(fstr(mem, "a = 1; b = ", i, "; c = 3; // edit ", i)));
+        check(doc->garbage <= doc->stmt_count + TLANG_DOC_GARBAGE);
+        if (error) break;
+    }
+    check(doc->compact_count > compact_count);
+    check(intern->count == sym_count);
+    check(doc->stmt_count == 3 && doc->stmts[1].ast->child->next->value == 2 * TLANG_DOC_GARBAGE - 1);
+
+    // Numbers of kept statements don't point into the previous source
+    tlang_doc_update(doc, str_buf("a = 1; b = 2; c = 3;"));
+    c = doc->stmts[2].ast;
+    tlang_doc_update(doc, str_buf("a = 1; b = 22; c = 3;"));
+    check(doc->stmts[2].ast == c);
+    check(buf_eq(c->child->next->text, str_buf("3")));
+
+    tlang_doc_free(doc);
+    mem_free(mem);
+}
@@ -0,0 +1,348 @@
+// Copyright (c) 2026 - Tom Smeets <tom@tsmeets.nl>
+// tlang_exp.h - Lambda calculus evaluation with sharing
+#pragma once
+#include "error.h"
+#include "mem.h"
+#include "type.h"
+
+// Usage:
+//   Exp *id = exp_lambda(mem, exp_ref(mem, 0));
+//   Exp *result = exp_eval(mem, exp_app(mem, id, id));
+//
+// Terms use de Bruijn indices, 'exp_ref(mem, 0)' refers to the nearest lambda.
+//
+// Evaluation uses a lazy Krivine machine. Instead of substituting arguments,
+// every argument becomes a thunk in the environment. A thunk is evaluated at
+// most once and then updated with its value, so an argument used many times
+// is only reduced once. This keeps programs like church numerals linear where
+// substitution would be exponential. The result is read back in normal form.
+
+// data Exp = L Exp | A Exp Exp | R Int deriving (Show, Eq)
+
+typedef struct Exp Exp;
+
+typedef struct {
+    Exp *body;
+} Exp_Lambda;
+
+typedef struct {
+    Exp *fun;
+    Exp *arg;
+} Exp_App;
+
+typedef struct {
+    u32 ix;
+} Exp_Ref;
+
+typedef enum {
+    Exp_Type_None,
+    Exp_Type_Lambda,
+    Exp_Type_App,
+    Exp_Type_Ref,
+} Exp_Type;
+
+struct Exp {
+    Exp_Type type;
+    union {
+        Exp_App app;
+        Exp_Lambda lambda;
+        Exp_Ref ref;
+    };
+};
+
+static Exp *exp_app(Memory *mem, Exp *fun, Exp *arg) {
+    Exp *exp = mem_struct(mem, Exp);
+    exp->type = Exp_Type_App;
+    exp->app.fun = fun;
+    exp->app.arg = arg;
+    return exp;
+}
+
+static Exp *exp_lambda(Memory *mem, Exp *body) {
+    Exp *exp = mem_struct(mem, Exp);
+    exp->type = Exp_Type_Lambda;
+    exp->lambda.body = body;
+    return exp;
+}
+
+static Exp *exp_ref(Memory *mem, u32 ix) {
+    Exp *exp = mem_struct(mem, Exp);
+    exp->type = Exp_Type_Ref;
+    exp->ref.ix = ix;
+    return exp;
+}
+
+// Church numeral 'n', '\f.\x.f (f (... x))'
+static Exp *exp_church(Memory *mem, u32 n) {
+    Exp *body = exp_ref(mem, 0);
+    for (u32 i = 0; i < n; ++i) body = exp_app(mem, exp_ref(mem, 1), body);
+    return exp_lambda(mem, exp_lambda(mem, body));
+}
+
+static bool exp_eq(Exp *a, Exp *b) {
+    for (;;) {
+        if (a->type != b->type) return false;
+        if (a->type == Exp_Type_Ref) return a->ref.ix == b->ref.ix;
+        if (a->type == Exp_Type_Lambda) {
+            a = a->lambda.body;
+            b = b->lambda.body;
+            continue;
+        }
+        if (a->type == Exp_Type_App) {
+            if (!exp_eq(a->app.fun, b->app.fun)) return false;
+            a = a->app.arg;
+            b = b->app.arg;
+            continue;
+        }
+        return true;
+    }
+}
+
+typedef struct Exp_Env Exp_Env;
+
+typedef enum {
+    Exp_Thunk_Delayed, // Not evaluated yet
+    Exp_Thunk_Busy,    // Being evaluated, entering it again would loop forever
+    Exp_Thunk_Value,   // Evaluated to a lambda
+    Exp_Thunk_Free,    // Variable of a lambda we are reading back
+} Exp_Thunk_State;
+
+// A term with its environment, updated in place once evaluated
+typedef struct {
+    Exp_Thunk_State state;
+    u32 level; // de Bruijn level of a free variable
+    Exp *exp;
+    Exp_Env *env;
+} Exp_Thunk;
+
+struct Exp_Env {
+    Exp_Thunk *thunk;
+    Exp_Env *next;
+};
+
+typedef struct {
+    Exp_Thunk *thunk;
+
+    // Update the thunk with the value, otherwise it is an argument
+    bool update;
+} Exp_Frame;
+
+typedef struct {
+    Memory *mem;
+
+    // Number of machine transitions
+    u64 steps;
+
+    // Stop with an error after this many steps, 0 means no limit
+    u64 max_steps;
+
+    u32 stack_count;
+    u32 stack_cap;
+    Exp_Frame *stack;
+} Exp_Machine;
+
+// Weak head normal form, either a lambda closure or a free variable applied to arguments
+typedef struct {
+    Exp *lambda;
+    Exp_Env *env;
+
+    u32 level;
+    u32 arg_count;
+    Exp_Thunk **args;
+} Exp_Whnf;
+
+static void exp_push(Exp_Machine *m, Exp_Thunk *thunk, bool update) {
+    if (m->stack_count == m->stack_cap) {
+        u32 new_cap = m->stack_cap ? m->stack_cap * 2 : 256;
+        size_t old_size = m->stack_cap * sizeof(Exp_Frame);
+        m->stack = (Exp_Frame *)mem_realloc(m->mem, (u8 *)m->stack, old_size, new_cap * sizeof(Exp_Frame));
+        m->stack_cap = new_cap;
+    }
+    m->stack[m->stack_count++] = (Exp_Frame){thunk, update};
+}
+
+static Exp_Env *exp_env_push(Exp_Machine *m, Exp_Thunk *thunk, Exp_Env *env) {
+    Exp_Env *cell = mem_struct(m->mem, Exp_Env);
+    cell->thunk = thunk;
+    cell->next = env;
+    return cell;
+}
+
+static Exp_Thunk *exp_env_get(Exp_Env *env, u32 ix) {
+    for (u32 i = 0; i < ix && env; ++i) env = env->next;
+    return env ? env->thunk : 0;
+}
+
+// Delay an argument, variables and lambdas need no evaluation so they are not wrapped
+static Exp_Thunk *exp_thunk(Exp_Machine *m, Exp *exp, Exp_Env *env) {
+    if (exp->type == Exp_Type_Ref) {
+        Exp_Thunk *thunk = exp_env_get(env, exp->ref.ix);
+        if (thunk) return thunk;
+    }
+
+    Exp_Thunk *thunk = mem_struct(m->mem, Exp_Thunk);
+    thunk->state = exp->type == Exp_Type_Lambda ? Exp_Thunk_Value : Exp_Thunk_Delayed;
+    thunk->exp = exp;
+    thunk->env = env;
+    return thunk;
+}
+
+// Run the machine until only the frames below 'base' are left
+static Exp_Whnf exp_whnf(Exp_Machine *m, Exp *exp, Exp_Env *env, u32 base) {
+    for (;;) {
+        m->steps++;
+        if (m->max_steps && m->steps > m->max_steps) {
+            error_set("Step limit reached");
+            break;
+        }
+
+        if (exp->type == Exp_Type_App) {
+            exp_push(m, exp_thunk(m, exp->app.arg, env), false);
+            exp = exp->app.fun;
+            continue;
+        }
+
+        if (exp->type == Exp_Type_Ref) {
+            Exp_Thunk *thunk = exp_env_get(env, exp->ref.ix);
+            check_or(thunk) break;
+            check_or(thunk->state != Exp_Thunk_Busy) break;
+
+            if (thunk->state == Exp_Thunk_Free) {
+                // Stuck on a free variable, the arguments are on the stack
+                Exp_Whnf result = {.level = thunk->level};
+                result.args = mem_array(m->mem, Exp_Thunk *, m->stack_count - base);
+                while (m->stack_count > base) {
+                    Exp_Frame frame = m->stack[--m->stack_count];
+
+                    // Thunks that were being evaluated are evaluated again when needed
+                    if (frame.update) {
+                        frame.thunk->state = Exp_Thunk_Delayed;
+                    } else {
+                        result.args[result.arg_count++] = frame.thunk;
+                    }
+                }
+                return result;
+            }
+
+            if (thunk->state == Exp_Thunk_Delayed) {
+                thunk->state = Exp_Thunk_Busy;
+                exp_push(m, thunk, true);
+            }
+            exp = thunk->exp;
+            env = thunk->env;
+            continue;
+        }
+
+        check_or(exp->type == Exp_Type_Lambda) break;
+        if (m->stack_count == base) return (Exp_Whnf){.lambda = exp, .env = env};
+
+        Exp_Frame frame = m->stack[--m->stack_count];
+        if (frame.update) {
+            // Share the value with everyone using this thunk
+            frame.thunk->state = Exp_Thunk_Value;
+            frame.thunk->exp = exp;
+            frame.thunk->env = env;
+        } else {
+            // Beta reduction, the argument is bound without copying
+            env = exp_env_push(m, frame.thunk, env);
+            exp = exp->lambda.body;
+        }
+    }
+
+    m->stack_count = base;
+    return (Exp_Whnf){};
+}
+
+static Exp_Whnf exp_force(Exp_Machine *m, Exp_Thunk *thunk) {
+    if (thunk->state == Exp_Thunk_Free) return (Exp_Whnf){.level = thunk->level};
+    if (thunk->state == Exp_Thunk_Value) return (Exp_Whnf){.lambda = thunk->exp, .env = thunk->env};
+    check_or(thunk->state == Exp_Thunk_Delayed) return (Exp_Whnf){};
+
+    u32 base = m->stack_count;
+    thunk->state = Exp_Thunk_Busy;
+    exp_push(m, thunk, true);
+    return exp_whnf(m, thunk->exp, thunk->env, base);
+}
+
+// Convert a value back to a term, evaluating under lambdas
+// - 'depth' is the number of lambdas we are under
+static Exp *exp_quote(Memory *mem, Exp_Machine *m, Exp_Whnf value, u32 depth) {
+    if (error) return 0;
+
+    if (value.lambda) {
+        // Evaluate the body with a free variable for the argument
+        Exp_Thunk *var = mem_struct(m->mem, Exp_Thunk);
+        var->state = Exp_Thunk_Free;
+        var->level = depth;
+
+        Exp_Env *env = exp_env_push(m, var, value.env);
+        Exp_Whnf body = exp_whnf(m, value.lambda->lambda.body, env, m->stack_count);
+        Exp *body_exp = exp_quote(mem, m, body, depth + 1);
+        if (error) return 0;
+        return exp_lambda(mem, body_exp);
+    }
+
+    Exp *exp = exp_ref(mem, depth - value.level - 1);
+    for (u32 i = 0; i < value.arg_count; ++i) {
+        Exp *arg = exp_quote(mem, m, exp_force(m, value.args[i]), depth);
+        if (error) return 0;
+        exp = exp_app(mem, exp, arg);
+    }
+    return exp;
+}
+
+// Evaluate a closed term to normal form, returns 0 on error
+// - The machine state is allocated in 'm->mem', the result in 'mem'
+static Exp *exp_normalize(Memory *mem, Exp_Machine *m, Exp *exp) {
+    Exp_Whnf value = exp_whnf(m, exp, 0, m->stack_count);
+    return exp_quote(mem, m, value, 0);
+}
+
+// Evaluate a closed term to normal form, returns 0 on error
+static Exp *exp_eval(Memory *mem, Exp *exp) {
+    Exp_Machine m = {.mem = mem_new()};
+    Exp *result = exp_normalize(mem, &m, exp);
+    mem_free(m.mem);
+    return result;
+}
+
+static void test_exp(void) {
+    Memory *mem = mem_new();
+
+    // (\x.x) (\x.x) = \x.x
+    Exp *id = exp_lambda(mem, exp_ref(mem, 0));
+    check(exp_eq(exp_eval(mem, exp_app(mem, id, id)), id));
+
+    // \m.\n.\f. m (n f)
+    Exp *mul = exp_lambda(mem, exp_lambda(mem, exp_lambda(mem, exp_app(mem, exp_ref(mem, 2), exp_app(mem, exp_ref(mem, 1), exp_ref(mem, 0))))));
+    Exp *six = exp_app(mem, exp_app(mem, mul, exp_church(mem, 2)), exp_church(mem, 3));
+    check(exp_eq(exp_eval(mem, six), exp_church(mem, 6)));
+
+    // \m.\n. n m
+    Exp *pow = exp_lambda(mem, exp_lambda(mem, exp_app(mem, exp_ref(mem, 0), exp_ref(mem, 1))));
+    Exp *big = exp_app(mem, exp_app(mem, pow, exp_church(mem, 2)), exp_church(mem, 6));
+    check(exp_eq(exp_eval(mem, big), exp_church(mem, 64)));
+
+    // Shared arguments are only evaluated once
+    Exp *t = exp_lambda(mem, exp_lambda(mem, exp_ref(mem, 1)));
+    Exp *f = exp_lambda(mem, exp_lambda(mem, exp_ref(mem, 0)));
+    Exp *not = exp_lambda(mem, exp_app(mem, exp_app(mem, exp_ref(mem, 0), f), t));
+    Exp *huge = exp_app(mem, exp_app(mem, pow, exp_church(mem, 2)), exp_church(mem, 16));
+    Exp_Machine m = {.mem = mem_new()};
+    Exp *even = exp_normalize(mem, &m, exp_app(mem, exp_app(mem, huge, not), t));
+    check(exp_eq(even, t));
+    check(m.steps < 16 * 65536);
+    mem_free(m.mem);
+
+    // (\x.x x) (\x.x x) never terminates
+    Exp *dup = exp_lambda(mem, exp_app(mem, exp_ref(mem, 0), exp_ref(mem, 0)));
+    m = (Exp_Machine){.mem = mem_new(), .max_steps = 1000};
+    check(!exp_normalize(mem, &m, exp_app(mem, dup, dup)));
+    check(error_pop());
+    mem_free(m.mem);
+
+    // Unbound variable
+    check(!exp_eval(mem, exp_ref(mem, 0)));
+    check(error_pop());
+    mem_free(mem);
+}
@@ -0,0 +1,130 @@
+// Copyright (c) 2026 - Tom Smeets <tom@tsmeets.nl>
+// tlang_intern.h - Map strings to small integer symbols
+#pragma once
+#include "assert.h"
+#include "fmt.h"
+#include "mem.h"
+#include "str.h"
+#include "type.h"
+
+// Usage:
+//   Tlang_Intern *intern = tlang_intern_new(mem);
+//   u32 sym = tlang_intern(intern, str_buf("hello"));
+//   Buffer name = intern->names[sym];
+//
+// Equal strings always get the same symbol, so they can be compared as integers.
+// Symbols are numbered from 0 in order of first use. The operators of the language
+// are interned first, so they always have the fixed symbols in Tlang_Sym.
+
+typedef enum {
+    Tlang_Sym_Assign, // '='
+    Tlang_Sym_Add,    // '+'
+    Tlang_Sym_Mul,    // '*'
+    Tlang_Sym_End,    // ';'
+    Tlang_Sym_Count,
+} Tlang_Sym;
+
+typedef struct {
+    Memory *mem;
+
+    // Open addressing hash table, stores 'symbol + 1' and 0 for empty slots
+    u32 slot_count;
+    u32 *slots;
+
+    // Name and hash of every symbol
+    u32 count;
+    u32 cap;
+    Buffer *names;
+    u32 *hashes;
+} Tlang_Intern;
+
+// FNV-1a, tokens are short so this is fast enough
+static u32 tlang_intern_hash(Buffer text) {
+    u32 hash = 0x811c9dc5;
+    for (size_t i = 0; i < text.size; ++i) {
+        hash ^= text.data[i];
+        hash *= 0x01000193;
+    }
+    return hash;
+}
+
+// Insert a symbol in the hash table, it should not exist yet
+static void tlang_intern_insert(Tlang_Intern *intern, u32 sym) {
+    u32 mask = intern->slot_count - 1;
+    u32 slot = intern->hashes[sym] & mask;
+    while (intern->slots[slot]) slot = (slot + 1) & mask;
+    intern->slots[slot] = sym + 1;
+}
+
+// Double the table size, keeping it at most half full
+static void tlang_intern_grow(Tlang_Intern *intern) {
+    Memory *mem = intern->mem;
+    u32 new_cap = intern->cap ? intern->cap * 2 : 64;
+    intern->names = (Buffer *)mem_realloc(mem, (u8 *)intern->names, intern->cap * sizeof(Buffer), new_cap * sizeof(Buffer));
+    intern->hashes = (u32 *)mem_realloc(mem, (u8 *)intern->hashes, intern->cap * sizeof(u32), new_cap * sizeof(u32));
+    intern->cap = new_cap;
+
+    intern->slot_count = new_cap * 2;
+    intern->slots = mem_array_zero(mem, u32, intern->slot_count);
+    for (u32 sym = 0; sym < intern->count; ++sym) tlang_intern_insert(intern, sym);
+}
+
+// Find the symbol for a string, or -1 if it was never interned
+static i32 tlang_intern_find(Tlang_Intern *intern, Buffer text) {
+    if (!intern->slot_count) return -1;
+    u32 hash = tlang_intern_hash(text);
+    u32 mask = intern->slot_count - 1;
+    for (u32 slot = hash & mask;; slot = (slot + 1) & mask) {
+        u32 entry = intern->slots[slot];
+        if (!entry) return -1;
+        u32 sym = entry - 1;
+        if (intern->hashes[sym] == hash && buf_eq(intern->names[sym], text)) return sym;
+    }
+}
+
+// Get the symbol for a string, creating a new one if needed
+// - The text is copied, so it does not have to outlive the interner
+static u32 tlang_intern(Tlang_Intern *intern, Buffer text) {
+    i32 found = tlang_intern_find(intern, text);
+    if (found >= 0) return found;
+
+    if (intern->count == intern->cap) tlang_intern_grow(intern);
+    u32 sym = intern->count++;
+    intern->names[sym] = buf_from(mem_clone(intern->mem, text.data, text.size), text.size);
+    intern->hashes[sym] = tlang_intern_hash(text);
+    tlang_intern_insert(intern, sym);
+    return sym;
+}
+
+static Tlang_Intern *tlang_intern_new(Memory *mem) {
+    Tlang_Intern *intern = mem_struct(mem, Tlang_Intern);
+    intern->mem = mem;
+
+    // Same order as Tlang_Sym
+    tlang_intern(intern, str_buf("="));
+    tlang_intern(intern, str_buf("+"));
+    tlang_intern(intern, str_buf("*"));
+    tlang_intern(intern, str_buf(";"));
+    assert(intern->count == Tlang_Sym_Count);
+    return intern;
+}
+
+static void test_tlang_intern(void) {
+    Memory *mem = mem_new();
+    Tlang_Intern *intern = tlang_intern_new(mem);
+    check(tlang_intern(intern, str_buf("*")) == Tlang_Sym_Mul);
+    check(tlang_intern_find(intern, str_buf("x")) == -1);
+
+    // Enough symbols to grow the table a few times
+    u32 syms[1000];
+    for (u32 i = 0; i < array_count(syms); ++i) {
+        syms[i] = tlang_intern(intern, str_buf(fstr(mem, "sym", i)));
+        check(syms[i] == Tlang_Sym_Count + i);
+    }
+    for (u32 i = 0; i < array_count(syms); ++i) {
+        check(tlang_intern(intern, str_buf(fstr(mem, "sym", i))) == syms[i]);
+    }
+    check(buf_eq(intern->names[syms[123]], str_buf("sym123")));
+    check(intern->count == Tlang_Sym_Count + array_count(syms));
+    mem_free(mem);
+}
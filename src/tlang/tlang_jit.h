@@ -0,0 +1,182 @@
+// Copyright (c) 2026 - Tom Smeets <tom@tsmeets.nl>
+// tlang_jit.h - Translate tlang bytecode to x86-64 machine code
+#pragma once
+#include "os_alloc.h"
+#include "tlang_vm.h"
+#include "write.h"
+
+// Usage:
+//   Tlang_Program *program = tlang_compile(mem, ast);
+//   Tlang_Jit jit = tlang_jit_compile(program);
+//   for (;;) tlang_jit_run(&jit, program, regs);
+//   tlang_jit_free(&jit);
+//
+// Every bytecode instruction becomes a few x86-64 instructions operating
+// directly on the register array. The code is written to fresh pages from
+// 'os_alloc' which are made executable afterwards. When the platform cannot
+// run generated code (WASM, other architectures) the bytecode VM is used.
+
+#if __x86_64__ && !OS_WASM
+#define TLANG_JIT 1
+#else
+#define TLANG_JIT 0
+#endif
+
+// The generated function, takes the register array as its only argument
+typedef void Tlang_Jit_Func(u32 *regs);
+
+typedef struct {
+    Tlang_Jit_Func *func;
+    void *code;
+    size_t size;
+} Tlang_Jit;
+
+// x86-64 register numbers
+#define TLANG_JIT_EAX 0
+#define TLANG_JIT_ECX 1
+#define TLANG_JIT_EDI 7
+
+// The first argument register holds 'regs'
+#if OS_WINDOWS
+#define TLANG_JIT_REGS TLANG_JIT_ECX
+#else
+#define TLANG_JIT_REGS TLANG_JIT_EDI
+#endif
+
+// Encode '[regs + 4 * index]' as memory operand with 'reg' as the other operand
+static void tlang_jit_mem(Write *code, u8 reg, u32 index) {
+    u32 offset = index * sizeof(u32);
+    if (offset < 128) {
+        write_u8(code, 0x40 | reg << 3 | TLANG_JIT_REGS);
+        write_u8(code, offset);
+    } else {
+        write_u8(code, 0x80 | reg << 3 | TLANG_JIT_REGS);
+        write_u32(code, offset);
+    }
+}
+
+// Emit the machine code for a program
+// - 'eax' is used as accumulator, we remember which register it contains to avoid reloading it
+static void tlang_jit_emit(Write *code, Tlang_Program *program) {
+    i32 cached = -1;
+    for (u32 i = 0; i < program->inst_count; ++i) {
+        Tlang_Inst inst = program->inst[i];
+        if (inst.op == Tlang_Op_Halt) {
+            // ret
+            write_u8(code, 0xc3);
+            break;
+        }
+
+        if (inst.op == Tlang_Op_Const) {
+            // mov dword [regs + dst], imm
+            write_u8(code, 0xc7);
+            tlang_jit_mem(code, 0, inst.dst);
+            write_u32(code, inst.imm);
+            if (cached == inst.dst) cached = -1;
+            continue;
+        }
+
+        // Both operations are commutative, so we can start with the value that is already loaded
+        if (inst.op != Tlang_Op_Move && cached == inst.rhs) {
+            u16 tmp = inst.lhs;
+            inst.lhs = inst.rhs;
+            inst.rhs = tmp;
+        }
+
+        if (cached != inst.lhs) {
+            // mov eax, [regs + lhs]
+            write_u8(code, 0x8b);
+            tlang_jit_mem(code, TLANG_JIT_EAX, inst.lhs);
+        }
+
+        if (inst.op == Tlang_Op_Add) {
+            // add eax, [regs + rhs]
+            write_u8(code, 0x03);
+            tlang_jit_mem(code, TLANG_JIT_EAX, inst.rhs);
+        } else if (inst.op == Tlang_Op_Mul) {
+            // imul eax, [regs + rhs]
+            write_u8(code, 0x0f);
+            write_u8(code, 0xaf);
+            tlang_jit_mem(code, TLANG_JIT_EAX, inst.rhs);
+        }
+
+        // mov [regs + dst], eax
+        write_u8(code, 0x89);
+        tlang_jit_mem(code, TLANG_JIT_EAX, inst.dst);
+        cached = inst.dst;
+    }
+}
+
+// Generate machine code for a program, 'func' is 0 when this is not supported
+static Tlang_Jit tlang_jit_compile(Tlang_Program *program) {
+    Tlang_Jit jit = {};
+    if (!TLANG_JIT) return jit;
+
+    Memory *tmp = mem_new();
+    Write *code = write_new(tmp);
+    tlang_jit_emit(code, program);
+    Buffer data = write_get_written(code);
+
+    jit.size = data.size;
+    jit.code = os_alloc(jit.size);
+    if (!jit.code) {
+        mem_free(tmp);
+        return (Tlang_Jit){};
+    }
+
+    ptr_copy(jit.code, data.data, data.size);
+    mem_free(tmp);
+
+    // Flip the pages from writable to executable
+    if (!os_protect_exec(jit.code, jit.size)) {
+        os_free(jit.code, jit.size);
+        return (Tlang_Jit){};
+    }
+
+    jit.func = (Tlang_Jit_Func *)jit.code;
+    return jit;
+}
+
+// Run the generated code, or the bytecode VM when there is none
+static void tlang_jit_run(Tlang_Jit *jit, Tlang_Program *program, u32 *regs) {
+    if (jit->func) {
+        jit->func(regs);
+    } else {
+        tlang_vm_run(program, regs);
+    }
+}
+
+static void tlang_jit_free(Tlang_Jit *jit) {
+    if (jit->code) os_free(jit->code, jit->size);
+    *jit = (Tlang_Jit){};
+}
+
+static void test_tlang_jit(void) {
+    Memory *mem = mem_new();
+
+    // Enough variables to need 32 bit offsets
+    Fmt *source = fmt_new(mem);
+    fmt_s(source, "x = 1*2*3; y = 4*5*6; z = x + y; w = x*y + z*2*x; x = x + 1; v = x*x + w;");
+    for (u32 i = 0; i < 40; ++i) fmt_g(source, "a", i, " = x*", i, " + v*z + y;");
+    fmt_s(source, "b = a39 * a38 + a0;");
+
+    Tlang_Intern *intern = tlang_intern_new(mem);
+    Tlang_Parse p = {.mem = mem, .tokens = tlang_lex(mem, intern, fmt_end(source))};
+    Tlang_Program *program = tlang_compile(mem, tlang_parse(&p));
+    check_or(program) {
+        mem_free(mem);
+        return;
+    }
+
+    u32 *expect = mem_array_zero(mem, u32, program->reg_count);
+    u32 *regs = mem_array_zero(mem, u32, program->reg_count);
+    tlang_vm_run(program, expect);
+
+    Tlang_Jit jit = tlang_jit_compile(program);
+    check(!TLANG_JIT || jit.func);
+    tlang_jit_run(&jit, program, regs);
+    for (u32 i = 0; i < program->var_count; ++i) check(regs[i] == expect[i]);
+    check(regs[tlang_program_var(program, str_buf("x"))] == 7);
+    tlang_jit_free(&jit);
+    mem_free(mem);
+}
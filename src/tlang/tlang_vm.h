@@ -0,0 +1,276 @@
+// Copyright (c) 2026 - Tom Smeets <tom@tsmeets.nl>
+// tlang_vm.h - Compile tlang to bytecode for a register machine
+#pragma once
+#include "tlang.h"
+
+// Usage:
+//   Tlang_Program *program = tlang_compile(mem, ast);
+//   u32 *regs = mem_array(mem, u32, program->reg_count);
+//   tlang_vm_run(program, regs);
+//   u32 x = regs[tlang_program_var(program, str_buf("x"))];
+//
+// Every variable gets a fixed register, the registers after those hold
+// temporary values. Assigning a variable again overwrites its register.
+// Constant expressions are folded while compiling.
+
+typedef enum {
+    Tlang_Op_Halt,
+    Tlang_Op_Const, // dst = imm
+    Tlang_Op_Move,  // dst = lhs
+    Tlang_Op_Add,   // dst = lhs + rhs
+    Tlang_Op_Mul,   // dst = lhs * rhs
+    Tlang_Op_Count,
+} Tlang_Op;
+
+typedef struct {
+    u16 op;  // Tlang_Op
+    u16 dst; // Destination register
+    union {
+        struct {
+            u16 lhs;
+            u16 rhs;
+        };
+        u32 imm;
+    };
+} Tlang_Inst;
+
+typedef struct {
+    u32 inst_count;
+    Tlang_Inst *inst;
+
+    // Variables use registers '0 .. var_count', temporaries the rest
+    u32 reg_count;
+    u32 var_count;
+    Buffer *var_names;
+} Tlang_Program;
+
+typedef struct {
+    Memory *mem;
+    Tlang_Program *program;
+    u32 inst_cap;
+
+    // Next free temporary register
+    u32 temp;
+
+    // Variables that were assigned so far
+    u32 defined;
+
+    // Register of each variable symbol plus one, zero if it is not a variable
+    u32 sym_count;
+    u32 *var_of_sym;
+} Tlang_Compile;
+
+// Find the register of a variable, or -1 if it does not exist
+static i32 tlang_program_var(Tlang_Program *program, Buffer name) {
+    for (u32 i = 0; i < program->var_count; ++i) {
+        if (buf_eq(program->var_names[i], name)) return i;
+    }
+    return -1;
+}
+
+static void tlang_emit(Tlang_Compile *c, Tlang_Inst inst) {
+    Tlang_Program *program = c->program;
+    if (program->inst_count == c->inst_cap) {
+        u32 new_cap = c->inst_cap ? c->inst_cap * 2 : 64;
+        size_t old_size = c->inst_cap * sizeof(Tlang_Inst);
+        program->inst = (Tlang_Inst *)mem_realloc(c->mem, (u8 *)program->inst, old_size, new_cap * sizeof(Tlang_Inst));
+        c->inst_cap = new_cap;
+    }
+    program->inst[program->inst_count++] = inst;
+}
+
+static u32 tlang_temp(Tlang_Compile *c) {
+    u32 reg = c->temp++;
+    check(reg <= 0xffff);
+    if (c->temp > c->program->reg_count) c->program->reg_count = c->temp;
+    return reg;
+}
+
+// Check if an expression is constant and compute its value
+static bool tlang_const(Ast *ast, u32 *value) {
+    if (ast->type == Ast_Type_Number) {
+        *value = ast->value;
+        return true;
+    }
+
+    if (ast->type != Ast_Type_Operator) return false;
+    bool is_mul = ast->sym == Tlang_Sym_Mul;
+    u32 result = is_mul ? 1 : 0;
+    for (Ast *child = ast->child; child; child = child->next) {
+        u32 child_value = 0;
+        if (!tlang_const(child, &child_value)) return false;
+        result = is_mul ? result * child_value : result + child_value;
+    }
+    *value = result;
+    return true;
+}
+
+// Compile an expression so its final instruction writes 'dst'
+static void tlang_compile_expr(Tlang_Compile *c, Ast *ast, u32 dst);
+
+// Compile an expression into any register, variables are used directly
+static u32 tlang_compile_operand(Tlang_Compile *c, Ast *ast) {
+    if (ast->type == Ast_Type_Label) {
+        // Variables can only be used after they are assigned
+        u32 var = ast->sym < c->sym_count ? c->var_of_sym[ast->sym] : 0;
+        if (var == 0 || var > c->defined) {
+            error_set("Word not found on stack");
+            return 0;
+        }
+        return var - 1;
+    }
+
+    u32 reg = tlang_temp(c);
+    tlang_compile_expr(c, ast, reg);
+    return reg;
+}
+
+static void tlang_compile_expr(Tlang_Compile *c, Ast *ast, u32 dst) {
+    u32 value = 0;
+    if (tlang_const(ast, &value)) {
+        tlang_emit(c, (Tlang_Inst){.op = Tlang_Op_Const, .dst = dst, .imm = value});
+        return;
+    }
+
+    if (ast->type == Ast_Type_Label) {
+        u32 src = tlang_compile_operand(c, ast);
+        tlang_emit(c, (Tlang_Inst){.op = Tlang_Op_Move, .dst = dst, .lhs = src});
+        return;
+    }
+
+    check_or(ast->type == Ast_Type_Operator && ast->child) return;
+    Tlang_Op op = Tlang_Op_Halt;
+    if (ast->sym == Tlang_Sym_Mul) op = Tlang_Op_Mul;
+    if (ast->sym == Tlang_Sym_Add) op = Tlang_Op_Add;
+    check_or(op != Tlang_Op_Halt) return;
+
+    // Temporaries are free again after this expression
+    u32 temp = c->temp;
+    u32 acc = tlang_compile_operand(c, ast->child);
+    for (Ast *child = ast->child->next; child; child = child->next) {
+        u32 rhs = tlang_compile_operand(c, child);
+        u32 out = child->next ? tlang_temp(c) : dst;
+        tlang_emit(c, (Tlang_Inst){.op = op, .dst = out, .lhs = acc, .rhs = rhs});
+        acc = out;
+    }
+    c->temp = temp;
+}
+
+// Compile a block of assignments
+static Tlang_Program *tlang_compile(Memory *mem, Ast *block) {
+    Tlang_Program *program = mem_struct(mem, Tlang_Program);
+    Tlang_Compile c = {.mem = mem, .program = program};
+
+    // Only assigned symbols can be variables
+    for (Ast *stm = block; stm; stm = stm->next) {
+        check_or(stm->type == Ast_Type_Operator && stm->sym == Tlang_Sym_Assign) return 0;
+        if (stm->child->sym >= c.sym_count) c.sym_count = stm->child->sym + 1;
+    }
+    c.var_of_sym = mem_array_zero(mem, u32, c.sym_count);
+
+    // Give every variable a register, so temporaries come after all variables
+    u32 var_cap = 0;
+    for (Ast *stm = block; stm; stm = stm->next) {
+        u32 sym = stm->child->sym;
+        if (c.var_of_sym[sym]) continue;
+        if (program->var_count == var_cap) {
+            u32 new_cap = var_cap ? var_cap * 2 : 16;
+            size_t old_size = var_cap * sizeof(Buffer);
+            program->var_names = (Buffer *)mem_realloc(mem, (u8 *)program->var_names, old_size, new_cap * sizeof(Buffer));
+            var_cap = new_cap;
+        }
+        program->var_names[program->var_count++] = stm->child->text;
+        c.var_of_sym[sym] = program->var_count;
+    }
+    program->reg_count = program->var_count;
+
+    for (Ast *stm = block; stm; stm = stm->next) {
+        c.temp = program->var_count;
+        u32 dst = c.var_of_sym[stm->child->sym] - 1;
+        tlang_compile_expr(&c, stm->child->next, dst);
+        if (error) return 0;
+
+        // Variables are numbered in order of their first assignment
+        if (dst == c.defined) c.defined++;
+    }
+
+    tlang_emit(&c, (Tlang_Inst){.op = Tlang_Op_Halt});
+    return program;
+}
+
+// Execute a program, 'regs' has room for 'reg_count' values
+static void tlang_vm_run(Tlang_Program *program, u32 *regs) {
+    // Jump directly from one instruction to the next, indexed by Tlang_Op
+    static void *dispatch[Tlang_Op_Count] = {
+        [Tlang_Op_Halt] = &&op_halt,
+        [Tlang_Op_Const] = &&op_const,
+        [Tlang_Op_Move] = &&op_move,
+        [Tlang_Op_Add] = &&op_add,
+        [Tlang_Op_Mul] = &&op_mul,
+    };
+
+    Tlang_Inst *ip = program->inst;
+    goto *dispatch[ip->op];
+
+op_const:
+    regs[ip->dst] = ip->imm;
+    ip++;
+    goto *dispatch[ip->op];
+
+op_move:
+    regs[ip->dst] = regs[ip->lhs];
+    ip++;
+    goto *dispatch[ip->op];
+
+op_add:
+    regs[ip->dst] = regs[ip->lhs] + regs[ip->rhs];
+    ip++;
+    goto *dispatch[ip->op];
+
+op_mul:
+    regs[ip->dst] = regs[ip->lhs] * regs[ip->rhs];
+    ip++;
+    goto *dispatch[ip->op];
+
+op_halt:
+    return;
+}
+
+static void test_tlang_vm(void) {
+    Memory *mem = mem_new();
+    char *source = "x = 1*2*3;\ny=4*5*6;z=x+y;w=x*y + z*2*x;x = x + 1; v = x*x + w;";
+
+    Tlang_Intern *intern = tlang_intern_new(mem);
+    Tlang_Parse p = {.mem = mem, .tokens = tlang_lex(mem, intern, str_buf(source))};
+    Ast *ast = tlang_parse(&p);
+    Tlang_Program *program = tlang_compile(mem, ast);
+    check_or(program) {
+        mem_free(mem);
+        return;
+    }
+
+    // The tree walker gives the same results
+    u32 *regs = mem_array_zero(mem, u32, program->reg_count);
+    tlang_vm_run(program, regs);
+    Stack *env = tlang_eval_block(mem, ast);
+    for (Stack *s = env; s; s = s->next) {
+        i32 var = tlang_program_var(program, s->name);
+        check(var >= 0);
+
+        // Only the last assignment is visible
+        bool shadowed = false;
+        for (Stack *t = env; t != s; t = t->next) shadowed |= t->sym == s->sym;
+        if (!shadowed && var >= 0) check(regs[var] == s->value);
+    }
+    check(regs[tlang_program_var(program, str_buf("x"))] == 7);
+    check(regs[tlang_program_var(program, str_buf("w"))] == 6 * 120 + 126 * 2 * 6);
+
+    // Constant expressions are folded
+    check(program->inst[0].op == Tlang_Op_Const && program->inst[0].imm == 6);
+
+    // Unknown variables are an error
+    p = (Tlang_Parse){.mem = mem, .tokens = tlang_lex(mem, intern, str_buf("a = b + 1;"))};
+    check(!tlang_compile(mem, tlang_parse(&p)));
+    check(error_pop());
+    mem_free(mem);
+}